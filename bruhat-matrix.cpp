@@ -23,6 +23,7 @@ void bruhat_matrix_all_sn_multi_threaded(int n){
     //}
 
     /* Dividing the task into smaller bits */
+    k_l_progress_begin("bruhat matrix", "rows", n_f);
     thread b_worker1(bruhat_matrix_worker_function, 0, n_f/7);
     thread b_worker2(bruhat_matrix_worker_function, (n_f/7)+1, 2*n_f/7);
     thread b_worker3(bruhat_matrix_worker_function, (2*n_f/7)+1, 3*n_f/7);
@@ -37,6 +38,7 @@ void bruhat_matrix_all_sn_multi_threaded(int n){
     b_worker5.join();
     b_worker6.join();
     b_worker7.join();
+    k_l_progress_end();
 }
 
 /*
@@ -52,7 +54,9 @@ void bruhat_matrix_all_sn(int n){
     //vector<int> all_p_len;
     int n_f = factorial(n);
 
+    k_l_progress_begin("bruhat matrix", "rows", n_f);
     bruhat_matrix_worker_function(0, n_f-1);
+    k_l_progress_end();
 }
 
 /*
@@ -60,11 +64,21 @@ void bruhat_matrix_all_sn(int n){
  * smaller parts so that multiple threads can work on it, for now that number is '6'
  */
 void bruhat_matrix_worker_function(int start_i, int end_i){
+    // the kernel of the group is taken once, instead of once for every pair by 'bruhat_compare'
+    const PermtKernels* kernels = permt_kernels_get(current_sn_group);
     for (int i = start_i; i <= end_i; i++) {
-        for(int j = 0; j < all_p.size(); j++){
-            if(bruhat_compare(all_p[i], all_p[j], all_p_len[i], all_p_len[j])) b_matrix[i][j] = 1;
-            else b_matrix[i][j] = 0;
+        if(kernels != NULL){
+            for(int j = 0; j < all_p.size(); j++){
+                b_matrix[i][j] = all_p_len[i] < all_p_len[j] && kernels->bruhat_below(all_p[i].data(), all_p[j].data());
+            }
         }
+        else{
+            for(int j = 0; j < all_p.size(); j++){
+                if(bruhat_compare(all_p[i], all_p[j], all_p_len[i], all_p_len[j])) b_matrix[i][j] = 1;
+                else b_matrix[i][j] = 0;
+            }
+        }
+        k_l_progress_add(1);
     }
 }
 
@@ -72,8 +86,11 @@ void bruhat_matrix_worker_function(int start_i, int end_i){
 void bruhat_matrix_write(string file_name){
     ostringstream s; s << file_name << current_sn_group << ".txt";
     int f_n = factorial(current_sn_group);
-    FILE* ifp = fopen(s.str().c_str(), "a");
-    if(ifp == NULL) ifp = fopen(s.str().c_str(), "w");
+    /* Processes sharing the directory may write it at the same time, each one writes its own copy and
+     * renames it over the old one, so readers never see a half written matrix */
+    string temp_name = s.str() + ".tmp" + to_string(getpid());
+    FILE* ifp = fopen(temp_name.c_str(), "w");
+    if(ifp == NULL) return;
 
     for(int i = 0; i < f_n; i++){
         for(int j = 0; j < f_n; j++){
@@ -82,19 +99,21 @@ void bruhat_matrix_write(string file_name){
         fprintf(ifp, "\n");
     }
     fclose(ifp);
+    rename(temp_name.c_str(), s.str().c_str());
 }
 
 /*  By default file_name = "bruhat-matrix"
  *  It is up to the programmer to make sure that 'b_matrix' has the space to take the data.
  *  Please do it beforehand. */
 void bruhat_matrix_initiate(string file_name){
+    K_L_STATS_PHASE(K_L_STATS_NS_MATRIX_LOAD);
     ostringstream s; s << file_name << current_sn_group << ".txt";
     int f_n = factorial(current_sn_group);
     FILE* ifp = fopen(s.str().c_str(), "r");
     if(ifp == NULL){
         printf("%s%s", "  No previous bruhat matrix data is found, generating for the entire group...\n",
                        "  This might take some time, stand still...\n");
-        bruhat_matrix_all_sn(current_sn_group);
+        bruhat_matrix_all_sn_multi_threaded(current_sn_group);
         bruhat_matrix_write();
         return;
     }
@@ -111,22 +130,59 @@ void bruhat_matrix_initiate(string file_name){
 /* Using the data stored the global variable 'b_matrix', this function returns indexes of function
  * that stay between u and v. (Endpoints are inclusive) */
 vector<int> bruhat_matrix_interval(vector<int> u, vector<int> v, int u_index, int v_index){
-    if(u_index == -1) u_index = all_p_data[u].index;
-    if(v_index == -1) v_index = all_p_data[v].index;
-    int f_n = factorial(current_sn_group);
-    vector<int> u_z /* elements z satisfying u <= z*/;
-    vector<int> z_v /* elements z satisfying z <= v*/;
-    vector<int> intersection_vec; /* The place where both of these conditions hold*/
+    if(u_index == -1) u_index = permt_rank(u);
+    if(v_index == -1) v_index = permt_rank(v);
+    vector<int> result(all_p.size());
+    result.resize(bruhat_matrix_interval_fill(u_index, v_index, result.data()));
+    return result;
+}
 
-    /* Note, the end points u and z will be added at the end, later on */
+/* The same with 'bruhat_matrix_interval' without allocating anything, indexes are written to 'result', which
+ * should have room for n! of them. Returns the amount written, the order is the same: increasing indexes of
+ * u < z < v, then u and v. */
+int bruhat_matrix_interval_fill(int u_index, int v_index, int* result){
+    int f_n = all_p.size(), size = 0;
+    const int* u_row = b_matrix[u_index];
+    /* Note, the end points u and z will be added at the end, later on. Both are 0 on the diagonal */
     for(int i = 0; i < f_n; i++){
-        if(b_matrix[u_index][i] == 1) u_z.push_back(i);
-        if(b_matrix[i][v_index] == 1) z_v.push_back(i);
+        if(u_row[i] == 1 && b_matrix[i][v_index] == 1) result[size++] = i;
     }
-    /* The algorith below uses sorted pieces of data to take their intersection. As u_z, z_v already
-     * contains sorted index data by default, we shall not perform that extra step here.*/
-    set_intersection(u_z.begin(), u_z.end(), z_v.begin(), z_v.end(), back_inserter(intersection_vec));
     /* Adding indexes of u and v itself here, at the end */
-    intersection_vec.push_back(u_index); intersection_vec.push_back(v_index);
-    return intersection_vec;
+    result[size++] = u_index; result[size++] = v_index;
+    K_L_STATS_ADD(K_L_STATS_INTERVALS, 1);
+    K_L_STATS_ADD(K_L_STATS_INTERVAL_SIZES, size);
+    K_L_STATS_MAX(K_L_STATS_INTERVAL_MAX, size);
+    return size;
+}
+
+/*
+ The part of the interval u <= z <= v where z * s_i < z, written to 'result' in increasing order, returns the amount.
+ 'result' should have room for n! indexes. Lexiographic order extends bruhat order, so only indexes from u to v
+ can be inside the interval, and only the set bits of 'all_p_descent_bits' between them are compared with u and v.
+ Without the bitsets, the whole interval is found and filtered.
+*/
+int bruhat_matrix_interval_descents(int u_index, int v_index, int i, int* result){
+    int size = 0;
+    if(i - 1 >= all_p_descent_bits.size() || all_p_descent_bits[i - 1].size() * 64 < all_p.size()){
+        int amount = bruhat_matrix_interval_fill(u_index, v_index, result);
+        sort(result, result + amount);
+        for(int k = 0; k < amount; k++){
+            if(all_p[result[k]][i - 1] > all_p[result[k]][i]) result[size++] = result[k];
+        }
+        return size;
+    }
+    const vector<uint64_t>& bits = all_p_descent_bits[i - 1];
+    const int* u_row = b_matrix[u_index];
+    int looked_at = 0;
+    for(int z_index = permt_bits_next(bits, u_index, v_index); z_index != -1; z_index = permt_bits_next(bits, z_index + 1, v_index)){
+        looked_at++;
+        if(z_index != u_index && u_row[z_index] == 0) continue;
+        if(z_index != v_index && b_matrix[z_index][v_index] == 0) continue;
+        result[size++] = z_index;
+    }
+    K_L_STATS_ADD(K_L_STATS_INTERVALS, 1);
+    K_L_STATS_ADD(K_L_STATS_Z_ITERATIONS, looked_at);
+    K_L_STATS_ADD(K_L_STATS_INTERVAL_SIZES, size);
+    K_L_STATS_MAX(K_L_STATS_INTERVAL_MAX, size);
+    return size;
 }
@@ -9,11 +9,20 @@
 #include "bruhat-order.h"
 #endif // !BRUHAT_ORDER
 /* ------------------------------ */
+#ifndef K_L_STATS
+#include "k-l-stats.h"
+#endif // !K_L_STATS
+/* ------------------------------ */
+#ifndef K_L_PROGRESS
+#include "k-l-progress.h"
+#endif // !K_L_PROGRESS
+/* ------------------------------ */
 //#ifndef POLYNOMIALS
 //#include "polynomials.h"
 //#endif // !POLYNOMIALS
 /* ------------------------------- */
 #include <thread>
+#include <unistd.h>
 #endif // !BRUHAT_MATRIX
 
 /* Global variables */
@@ -40,3 +49,7 @@ void bruhat_matrix_initiate(std::string file_name = "bruhat-matrix");
 /* Indexes '-1' are just placeholder values, they are just there to let the program know that no special index
  * output is provided. Normally, negative indexes are not used with the program. */
 std::vector<int> bruhat_matrix_interval(std::vector<int> u, std::vector<int> v, int u_index = -1, int v_index = -1);
+
+int bruhat_matrix_interval_fill(int u_index, int v_index, int* result);
+
+int bruhat_matrix_interval_descents(int u_index, int v_index, int i, int* result);
@@ -143,10 +143,17 @@ bool bruhat_compare_helper(bruhat_graph g, vector<int> permt1, vector<int> permt
  Define w[i, j] = {a in (1,2,... i) such that w(a) > j} and we say w < l in terms of bruhat order
  iff w[i, j] <= l[i, j] for any i,j in (1,2,... n) where w,l is elements of S_n
  The definition is taken directly from "Combinatorics of Coxeter Groups" textbook
+ For the groups of "permutation-kernels.h" the same criterion is checked by 'permt_kernel_bruhat_below'
 
  It is assumed that the user will provide two permutations from the same S_n group
 */
-bool bruhat_compare(vector<int> permt1, vector<int> permt2, int p_len1, int p_len2){
+bool bruhat_compare(const vector<int>& permt1, const vector<int>& permt2, int p_len1, int p_len2){
+    // a shorter element can not be above, otherwise the kernel of the group decides
+    const PermtKernels* kernels = permt_kernels_get(permt2.size());
+    if(kernels != NULL && permt1.size() == permt2.size()){
+        if(p_len1 != -1 && p_len2 != -1 && p_len1 >= p_len2) return false;
+        return kernels->bruhat_below(permt1.data(), permt2.data());
+    }
     int max_len = ((permt2.size() * (permt2.size() - 1)) / 2);
     if(p_len1 == -1) p_len1 = permt_inversion_amount(permt1);
     if(p_len2 == -1) p_len2 = permt_inversion_amount(permt2);
@@ -195,10 +202,9 @@ bool bruhat_compare(vector<int> permt1, vector<int> permt2, int p_len1, int p_le
 */
 pair<bruhat_graph, map<vector<int>, PermtData>>bruhat_graph_between_permt(vector<int> permt1, vector<int> permt2, PermtData permt1_data, PermtData permt2_data, bool use_b_matrix){
 
-    if(permt1_data.length == -1 && all_p_data[permt1].length != -1) permt1_data = all_p_data[permt1];
-    else if(permt1_data.length == -1) permt1_data = {permt_inversion_amount(permt1), all_p_data[permt1].index};
-    if(permt2_data.length == -1 && all_p_data[permt2].length != -1) permt2_data = all_p_data[permt2];
-    else if(permt1_data.length == -1) permt1_data = {permt_inversion_amount(permt2), all_p_data[permt2].index};
+    // 'permt_data' does not insert into 'all_p_data', so this is safe to call from several threads
+    if(permt1_data.length == -1) permt1_data = permt_data(permt1);
+    if(permt2_data.length == -1) permt2_data = permt_data(permt2);
     int current_length = permt1_data.length, desired_length = permt2_data.length;
 
 
@@ -230,10 +236,8 @@ pair<bruhat_graph, map<vector<int>, PermtData>>bruhat_graph_between_permt(vector
 // It does not have much meaning on its own
 pair<bruhat_graph, map<vector<int>, PermtData>> between_permt_helper(vector<int> permt1, vector<int> permt2, PermtData permt1_data, PermtData permt2_data, bruhat_graph g, map<vector<int>, PermtData> road_map, bool use_b_matrix){
 
-    if(permt1_data.length == -1 && all_p_data[permt1].length != -1) permt1_data = all_p_data[permt1];
-    else if(permt1_data.length == -1) permt1_data = {permt_inversion_amount(permt1), all_p_data[permt1].index};
-    if(permt1_data.length == -1 && all_p_data[permt1].length != -1) permt1_data = all_p_data[permt1];
-    else if(permt1_data.length == -1) permt1_data = {permt_inversion_amount(permt1), all_p_data[permt1].index};
+    if(permt1_data.length == -1) permt1_data = permt_data(permt1);
+    if(permt2_data.length == -1) permt2_data = permt_data(permt2);
     int current_length = permt1_data.length, desired_length = permt2_data.length;
 
     int total_vertices = boost::num_vertices(g);
@@ -245,9 +249,7 @@ pair<bruhat_graph, map<vector<int>, PermtData>> between_permt_helper(vector<int>
         vector<vector<int>> adjacent_vertices;
         for(auto titr = transp_necessary.begin(); titr != transp_necessary.end(); titr++){
             auto temp_vec = permt_multp_right(permt1, *titr);
-            PermtData temp_vec_data;
-            if(all_p_data[temp_vec].length != -1) temp_vec_data = all_p_data[temp_vec];
-            else temp_vec_data = {permt_inversion_amount(temp_vec), all_p_data[temp_vec].index};
+            PermtData temp_vec_data = permt_data(temp_vec);
             //if the obtained temp_vec is comparable to the target permutation
             //we investigate further, otherwise we simply do not add it
             if(use_b_matrix && b_matrix[temp_vec_data.index][permt2_data.index] == 0) continue;
@@ -278,9 +280,7 @@ pair<bruhat_graph, map<vector<int>, PermtData>> between_permt_helper(vector<int>
 
         // Now, we will run the function again on the obtained adjacent vertices
         for(auto titr = adjacent_vertices.begin(); titr != adjacent_vertices.end(); titr++){
-            PermtData titr_data;
-            if(all_p_data[*titr].length != -1) titr_data = all_p_data[*titr];
-            else titr_data = {permt_inversion_amount(*titr), all_p_data[*titr].index};
+            PermtData titr_data = permt_data(*titr);
             auto temp_data = between_permt_helper(*titr, permt2, titr_data, permt2_data, g, road_map);
             g = temp_data.first; road_map = temp_data.second;
         }
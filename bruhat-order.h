@@ -38,6 +38,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "bruhat-matrix.h"
 #endif //!BRUHAT_MATRIX
 /*--------------------------------*/
+#ifndef PERMUTATION_KERNELS
+#include "permutation-kernels.h"
+#endif //!PERMUTATION_KERNELS
+/*--------------------------------*/
 
 #include <boost/graph/adjacency_list.hpp>
 #include <boost/graph/graphviz.hpp>
@@ -65,7 +69,7 @@ bool bruhat_compare_with_graph(std::vector<int> permt1, std::vector<int> permt2,
 
 bool bruhat_compare_helper(bruhat_graph g, std::vector<int> permt1, std::vector<int> permt2, int permt1_index, int permt2_index);
 
-bool bruhat_compare(std::vector<int> permt1, std::vector<int> permt2, int p_len1 = -1, int p_len2 = -1);
+bool bruhat_compare(const std::vector<int>& permt1, const std::vector<int>& permt2, int p_len1 = -1, int p_len2 = -1);
 
 std::pair<bruhat_graph, std::map<std::vector<int>, PermtData>>bruhat_graph_between_permt(std::vector<int> permt1, std::vector<int> permt2, PermtData permt1_data = {-1,-1}, PermtData permt2_data = {-1,-1}, bool use_b_matrix = false);
 
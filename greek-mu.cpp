@@ -0,0 +1,140 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "greek-mu.h"
+
+using namespace std;
+
+/* GLOBAL VARIABLES --------------- */
+
+unique_ptr<atomic<atomic<uint64_t>*>[]> greek_mu_rows;
+
+int greek_mu_row_size = 0;
+
+GreekMuShard greek_mu_edges[GREEK_MU_SHARDS];
+
+/*--------------------------------- */
+
+#define GREEK_MU_KNOWN   1ULL
+#define GREEK_MU_NONZERO 2ULL
+
+static uint64_t edge_key(int u_index, int v_index){
+    return ((uint64_t)u_index << 32) | (uint32_t)v_index;
+}
+
+static GreekMuShard& edge_shard(uint64_t key){
+    return greek_mu_edges[(key * 0x9E3779B97F4A7C15ULL) >> 58];
+}
+
+/* Returns the row of v_index, allocating it if this is the first time it is needed.
+ * Two threads may race on the allocation, the loser frees its copy and uses the winner's. */
+static atomic<uint64_t>* greek_mu_row(int v_index, bool allocate){
+    atomic<uint64_t>* row = greek_mu_rows[v_index].load(memory_order_acquire);
+    if(row != NULL || !allocate) return row;
+
+    int word_amount = (greek_mu_row_size + 31) / 32; /* 32 pairs of bits fit in a word */
+    atomic<uint64_t>* new_row = new atomic<uint64_t>[word_amount];
+    for(int i = 0; i < word_amount; i++) new_row[i].store(0, memory_order_relaxed);
+    if(greek_mu_rows[v_index].compare_exchange_strong(row, new_row, memory_order_acq_rel)) return new_row;
+    delete[] new_row;
+    return row;
+}
+
+/* Prepares the table for the group in 'current_sn_group', 'all_p' should be initialized beforehand.
+ * Anything recorded for the previous group is thrown away. */
+void greek_mu_table_initiate(void){
+    greek_mu_table_clear();
+    greek_mu_row_size = all_p.size();
+    greek_mu_rows.reset(new atomic<atomic<uint64_t>*>[greek_mu_row_size]);
+    for(int i = 0; i < greek_mu_row_size; i++) greek_mu_rows[i].store(NULL);
+}
+
+void greek_mu_table_clear(void){
+    for(int i = 0; i < greek_mu_row_size; i++) delete[] greek_mu_rows[i].load();
+    greek_mu_rows.reset(); greek_mu_row_size = 0;
+    for(int i = 0; i < GREEK_MU_SHARDS; i++){
+        lock_guard<mutex> guard(greek_mu_edges[i].lock);
+        greek_mu_edges[i].edges.clear();
+    }
+}
+
+/*
+ Records μ(u, v) using the freshly obtained k-l polynomial P(u, v), it is called every time a polynomial
+ is computed so that the table fills up as a by-product of the recursion. μ(u, v) is the coefficient of
+ q^[(l(v) - l(u) - 1) / 2] inside P(u, v), pairs with an even length difference are skipped, as μ is
+ always zero for them and 'greek_mu_table_lookup' answers those without the table.
+*/
+void greek_mu_table_record(int u_index, int v_index, int u_len, int v_len, const PolynomialCoefficients& k_l_coefficients){
+    if(greek_mu_row_size == 0 || u_index == v_index) return;
+    if((v_len - u_len) % 2 == 0) return;
+
+    int mu = 0;
+    auto wanted_coefficient = k_l_coefficients.find((v_len - u_len - 1) / 2.0);
+    if(wanted_coefficient != k_l_coefficients.end()) mu = wanted_coefficient->second;
+
+    if(mu != 0){
+        uint64_t key = edge_key(u_index, v_index);
+        GreekMuShard& shard = edge_shard(key);
+        lock_guard<mutex> guard(shard.lock);
+        shard.edges[key] = mu;
+    }
+    // the value is published before the bits, so anybody who sees NONZERO also finds the edge
+    uint64_t bits = GREEK_MU_KNOWN | (mu != 0 ? GREEK_MU_NONZERO : 0);
+    atomic<uint64_t>* row = greek_mu_row(v_index, true);
+    row[u_index / 32].fetch_or(bits << (2 * (u_index % 32)), memory_order_release);
+}
+
+/*
+ Looks up μ(u, v), returns false if it is not known yet. Non-comparable pairs and pairs with an even
+ length difference are answered right away with 0, this relies on 'b_matrix' being initialized.
+*/
+bool greek_mu_table_lookup(int u_index, int v_index, int& mu){
+    if(b_matrix[u_index][v_index] == 0 || (all_p_len[v_index] - all_p_len[u_index]) % 2 == 0){
+        mu = 0; return true;
+    }
+    if(greek_mu_row_size == 0) return false;
+
+    atomic<uint64_t>* row = greek_mu_row(v_index, false);
+    if(row == NULL) return false;
+    uint64_t bits = (row[u_index / 32].load(memory_order_acquire) >> (2 * (u_index % 32))) & 3ULL;
+    if((bits & GREEK_MU_KNOWN) == 0) return false;
+    if((bits & GREEK_MU_NONZERO) == 0){ mu = 0; return true; }
+
+    uint64_t key = edge_key(u_index, v_index);
+    GreekMuShard& shard = edge_shard(key);
+    lock_guard<mutex> guard(shard.lock);
+    mu = shard.edges[key];
+    return true;
+}
+
+/* Every nonzero μ recorded so far, sorted by (v_index, u_index) */
+vector<GreekMuEdge> greek_mu_table_edges(void){
+    vector<GreekMuEdge> result;
+    for(int i = 0; i < GREEK_MU_SHARDS; i++){
+        lock_guard<mutex> guard(greek_mu_edges[i].lock);
+        for(auto itr = greek_mu_edges[i].edges.begin(); itr != greek_mu_edges[i].edges.end(); itr++){
+            result.push_back({(int)(itr->first >> 32), (int)(itr->first & 0xFFFFFFFF), itr->second});
+        }
+    }
+    sort(result.begin(), result.end(), [](const GreekMuEdge& a, const GreekMuEdge& b){
+        if(a.v_index != b.v_index) return a.v_index < b.v_index;
+        return a.u_index < b.u_index;
+    });
+    return result;
+}
@@ -0,0 +1,86 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GREEK_MU
+#define GREEK_MU
+/*--------------------------------*/
+#ifndef PERMUTATION_BASICS
+#include "permutation-basics.h"
+#endif // !PERMUTATION_BASICS
+/*--------------------------------*/
+#ifndef BRUHAT_MATRIX
+#include "bruhat-matrix.h"
+#endif // !BRUHAT_MATRIX
+/*--------------------------------*/
+#ifndef K_L_ARENA
+#include "k-l-arena.h"
+#endif // !K_L_ARENA
+/*--------------------------------*/
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#endif // !GREEK_MU
+
+#define GREEK_MU_SHARDS 64
+
+// type definitions
+
+/* Nonzero μ values, these are exactly the edges of the W-graph */
+struct GreekMuShard
+{
+    std::mutex lock;
+    std::unordered_map<uint64_t /* (u_index << 32) | v_index */, int /* μ(u, v) */> edges;
+};
+
+/* One directed W-graph edge, u < v with respect to bruhat order and μ(u, v) != 0 */
+struct GreekMuEdge
+{
+    int u_index;
+    int v_index;
+    int mu;
+};
+
+/*--------------------------Global variables, just their declerations-----------------------*/
+
+/* For every v_index there is a row with 2 bits for every u_index, allocated the first time something
+ * about that v is recorded. Bit 0 says μ(u, v) is known, bit 1 says it is nonzero. Most μ values are zero,
+ * so a lookup usually ends after reading one word of this, without taking any lock. */
+extern std::unique_ptr<std::atomic<std::atomic<uint64_t>*>[]> greek_mu_rows;
+
+/* The amount of permutations the rows were allocated for, 0 if 'greek_mu_table_initiate' was not called */
+extern int greek_mu_row_size;
+
+/* The actual nonzero values, see 'GreekMuShard' above */
+extern GreekMuShard greek_mu_edges[GREEK_MU_SHARDS];
+
+/*------------------------------------------------------------------------------------------*/
+
+// function declarations
+
+void greek_mu_table_initiate(void);
+
+void greek_mu_table_clear(void);
+
+void greek_mu_table_record(int u_index, int v_index, int u_len, int v_len, const PolynomialCoefficients& k_l_coefficients);
+
+bool greek_mu_table_lookup(int u_index, int v_index, int& mu);
+
+std::vector<GreekMuEdge> greek_mu_table_edges(void);
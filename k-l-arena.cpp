@@ -0,0 +1,124 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "k-l-arena.h"
+#include <algorithm>
+
+using namespace std;
+
+#define K_L_POOL_CLASSES (K_L_POOL_MAX_BYTES / K_L_POOL_GRANULARITY)
+
+// type definitions
+
+/* A free node of the pool, the first bytes of the node itself point to the next one */
+struct PoolNode
+{
+    PoolNode* next;
+};
+
+/* Free nodes of one thread for every size class, they are given back to the heap when the thread ends */
+struct PoolLists
+{
+    PoolNode* heads[K_L_POOL_CLASSES] = {};
+    size_t lengths[K_L_POOL_CLASSES] = {};
+
+    ~PoolLists();
+};
+
+/* GLOBAL VARIABLES --------------- */
+
+static thread_local KLArena arena_local;
+
+static thread_local PoolLists pool_lists;
+
+/* Set once 'pool_lists' of the thread is destroyed. Polynomials that are global are destroyed after that, their
+ * nodes go straight to the heap then. This is trivially destructible, so it can still be read at that point. */
+static thread_local bool pool_closed = false;
+
+/*--------------------------------- */
+
+KLArena::~KLArena(){
+    for(auto itr = blocks.begin(); itr != blocks.end(); itr++) ::operator delete(itr->data);
+}
+
+/* Takes 'bytes' from the current block, or from the next block that is big enough */
+void* KLArena::allocate(size_t bytes, size_t alignment){
+    while(current < blocks.size()){
+        size_t start = (offset + alignment - 1) & ~(alignment - 1);
+        if(start + bytes <= blocks[current].size){
+            offset = start + bytes;
+            return blocks[current].data + start;
+        }
+        current++; offset = 0;
+    }
+    // blocks after the current one that are too small are kept, they are used again once the arena is rewound
+    size_t size = max((size_t)K_L_ARENA_BLOCK_BYTES, bytes + alignment);
+    blocks.push_back({static_cast<char*>(::operator new(size)), size});
+    current = blocks.size() - 1; offset = 0;
+    return allocate(bytes, alignment);
+}
+
+void KLArena::shrink(size_t bytes, size_t used){
+    if(used <= bytes && offset >= bytes) offset -= bytes - used;
+}
+
+size_t KLArena::reserved_bytes(void) const{
+    size_t result = 0;
+    for(auto itr = blocks.begin(); itr != blocks.end(); itr++) result += itr->size;
+    return result;
+}
+
+KLArenaFrame::KLArenaFrame() : arena(arena_local), position(arena_local.mark()) {}
+
+KLArena& k_l_arena_local(void){
+    return arena_local;
+}
+
+PoolLists::~PoolLists(){
+    for(int k = 0; k < K_L_POOL_CLASSES; k++){
+        while(heads[k] != NULL){
+            PoolNode* next = heads[k]->next;
+            ::operator delete(heads[k]);
+            heads[k] = next;
+        }
+    }
+    pool_closed = true;
+}
+
+void* k_l_pool_allocate(size_t bytes){
+    if(bytes == 0 || bytes > K_L_POOL_MAX_BYTES || pool_closed) return ::operator new(bytes);
+    int size_class = (bytes - 1) / K_L_POOL_GRANULARITY;
+    PoolNode* node = pool_lists.heads[size_class];
+    if(node == NULL) return ::operator new((size_class + 1) * K_L_POOL_GRANULARITY);
+    pool_lists.heads[size_class] = node->next;
+    pool_lists.lengths[size_class]--;
+    return node;
+}
+
+void k_l_pool_free(void* pointer, size_t bytes) noexcept{
+    if(pointer == NULL) return;
+    if(bytes == 0 || bytes > K_L_POOL_MAX_BYTES || pool_closed){ ::operator delete(pointer); return; }
+    int size_class = (bytes - 1) / K_L_POOL_GRANULARITY;
+    if(pool_lists.lengths[size_class] >= K_L_POOL_MAX_FREE){ ::operator delete(pointer); return; }
+    PoolNode* node = static_cast<PoolNode*>(pointer);
+    node->next = pool_lists.heads[size_class];
+    pool_lists.heads[size_class] = node;
+    pool_lists.lengths[size_class]++;
+}
@@ -0,0 +1,151 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef K_L_ARENA
+#define K_L_ARENA
+/*--------------------------------*/
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <new>
+#include <vector>
+#endif // !K_L_ARENA
+
+/* Smallest block the arena asks from the heap, a bigger one is taken when a single request does not fit */
+#define K_L_ARENA_BLOCK_BYTES (1 << 20)
+
+/* Sizes of the node pool are rounded up to this, requests bigger than K_L_POOL_MAX_BYTES go to the heap */
+#define K_L_POOL_GRANULARITY 16
+#define K_L_POOL_MAX_BYTES 128
+
+/* Free nodes kept by each thread for one size, the ones after that are given back to the heap */
+#define K_L_POOL_MAX_FREE 65536
+
+/*
+ Scratch memory of the K-L recursion, so that a frame of 'polynom_k_l' does not go to the heap.
+
+ 'KLArena' is a bump allocator owned by one thread, 'k_l_arena_local' returns the one of the calling thread. A
+ frame opens a 'KLArenaFrame', takes what it needs from it, and everything is given back at once when the frame
+ is left, so the frames of a recursion use the arena like a stack. Blocks are kept once taken, after the first
+ few frames nothing is allocated any more. Memory taken from a frame must not outlive it and must not be given to
+ other threads.
+
+ 'KLPoolAllocator' is the allocator of the coefficients of 'Polynomial', every node of the map goes through it.
+ Freed nodes are kept by the thread that frees them and handed out again for the next node of the same size,
+ so the temporaries of the recursion reuse the same few nodes. A node may be freed by another thread than the one
+ that allocated it.
+*/
+
+// type definitions
+
+/* Position inside an arena, taken by 'KLArena::mark' and given back to 'KLArena::rewind' */
+struct KLArenaMark
+{
+    size_t block;
+    size_t offset;
+};
+
+class KLArena
+{
+public:
+    KLArena() = default;
+    KLArena(const KLArena&) = delete;
+    KLArena& operator=(const KLArena&) = delete;
+    ~KLArena();
+
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    /* Gives back the end of the last allocation, it had 'bytes' and only 'used' of them are needed */
+    void shrink(size_t bytes, size_t used);
+
+    KLArenaMark mark(void) const { return {current, offset}; }
+    void rewind(KLArenaMark position){ current = position.block; offset = position.offset; }
+
+    size_t reserved_bytes(void) const;
+
+private:
+    struct Block
+    {
+        char* data;
+        size_t size;
+    };
+    std::vector<Block> blocks;
+    size_t current = 0, offset = 0;
+};
+
+/* Takes a mark of the arena of the thread when it is created and rewinds to it when it is destroyed */
+class KLArenaFrame
+{
+public:
+    KLArenaFrame();
+    KLArenaFrame(const KLArenaFrame&) = delete;
+    KLArenaFrame& operator=(const KLArenaFrame&) = delete;
+    ~KLArenaFrame(){ arena.rewind(position); }
+
+    template <typename T>
+    T* allocate(size_t amount){ return static_cast<T*>(arena.allocate(amount * sizeof(T), alignof(T))); }
+
+    /* The last array taken by 'allocate' had 'amount' elements and only 'used' of them are kept */
+    template <typename T>
+    void shrink(size_t amount, size_t used){ arena.shrink(amount * sizeof(T), used * sizeof(T)); }
+
+private:
+    KLArena& arena;
+    KLArenaMark position;
+};
+
+template <typename T>
+struct KLPoolAllocator
+{
+    typedef T value_type;
+
+    KLPoolAllocator() noexcept = default;
+    template <typename U>
+    KLPoolAllocator(const KLPoolAllocator<U>&) noexcept {}
+
+    T* allocate(size_t amount);
+    void deallocate(T* pointer, size_t amount) noexcept;
+
+    template <typename U>
+    bool operator==(const KLPoolAllocator<U>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const KLPoolAllocator<U>&) const noexcept { return false; }
+};
+
+/* Power to coefficient, the coefficients of 'Polynomial' in "polynomials.h" */
+typedef std::map<float, float, std::less<float>, KLPoolAllocator<std::pair<const float, float>>> PolynomialCoefficients;
+
+// function declarations
+
+KLArena& k_l_arena_local(void);
+
+void* k_l_pool_allocate(size_t bytes);
+
+void k_l_pool_free(void* pointer, size_t bytes) noexcept;
+
+template <typename T>
+T* KLPoolAllocator<T>::allocate(size_t amount){
+    return static_cast<T*>(k_l_pool_allocate(amount * sizeof(T)));
+}
+
+template <typename T>
+void KLPoolAllocator<T>::deallocate(T* pointer, size_t amount) noexcept{
+    k_l_pool_free(pointer, amount * sizeof(T));
+}
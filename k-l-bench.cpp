@@ -0,0 +1,256 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+ Benchmarks of the hot paths, built and run by 'make bench'.
+
+     k-l-bench [--repeats <r>] [--seed <s>] [--max-n <n>] [--json <file>] [--only <name>]
+
+ Every benchmark works on a fixed workload drawn from a generator seeded with <s> (42 by default), so two runs
+ with the same arguments do the same work. It is run once to warm up and then <r> times (11 by default), the
+ median and the percentiles of those runs are printed and written to <file>, 'bench-results.json' by default.
+ Benchmarks needing 'b_matrix' (generation, intervals and K-L polynomials) go up to S_<n>, 6 by default, the
+ others always up to S_8. 'b_matrix' of S_8 takes n!^2 ints, about 6.5 GB, mind that before using --max-n 8.
+ <name> runs only the benchmarks whose name contains it.
+
+ The K-L workloads start without any database, no file is read or written by this program.
+*/
+
+#include "polynomials.h"
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+// type definitions
+
+/* One benchmark at one n, 'runs' holds the seconds of each timed run */
+struct BenchResult
+{
+    string name;
+    int n;
+    long ops;
+    vector<double> runs;
+};
+
+/* GLOBAL VARIABLES --------------- */
+
+static int bench_repeats = 11;
+static uint64_t bench_seed = 42;
+static string bench_only;
+static vector<BenchResult> bench_results;
+
+/* Results are summed into this, so the compiler can not drop the calls being measured */
+static volatile long bench_sink = 0;
+
+/*--------------------------------- */
+
+/* Nearest rank percentile of sorted values */
+static double percentile(const vector<double>& sorted, double p){
+    size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+    return sorted[min(sorted.size() - 1, rank == 0 ? 0 : rank - 1)];
+}
+
+/* Runs 'body' once to warm up and then 'bench_repeats' times, 'reset' is called before every run and not timed */
+static void bench_run(string name, int n, long ops, function<void(void)> body, function<void(void)> reset = NULL){
+    if(!bench_only.empty() && name.find(bench_only) == string::npos) return;
+    BenchResult result = {name, n, ops, {}};
+    for(int k = 0; k <= bench_repeats; k++){
+        if(reset) reset();
+        auto start = chrono::steady_clock::now();
+        body();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if(k > 0) result.runs.push_back(seconds);
+    }
+    vector<double> sorted = result.runs; sort(sorted.begin(), sorted.end());
+    printf("  %-28s S_%d %9ld ops  median %10.3f ms  p10 %10.3f ms  p90 %10.3f ms  %10.1f ns/op\n", name.c_str(), n, ops,
+           percentile(sorted, 50) * 1e3, percentile(sorted, 10) * 1e3, percentile(sorted, 90) * 1e3, percentile(sorted, 50) * 1e9 / ops);
+    fflush(stdout);
+    bench_results.push_back(result);
+}
+
+static void bench_write_json(string path){
+    FILE* ofp = fopen(path.c_str(), "w");
+    if(ofp == NULL){ printf("  Could not write %s\n", path.c_str()); return; }
+    fprintf(ofp, "{\n  \"version\": 1,\n  \"seed\": %llu,\n  \"repeats\": %d,\n  \"threads\": %u,\n  \"compiler\": \"%s\",\n  \"results\": [\n",
+            (unsigned long long)bench_seed, bench_repeats, thread::hardware_concurrency(), __VERSION__);
+    for(size_t k = 0; k < bench_results.size(); k++){
+        BenchResult& r = bench_results[k];
+        vector<double> sorted = r.runs; sort(sorted.begin(), sorted.end());
+        double mean = 0;
+        for(double s : r.runs) mean += s / r.runs.size();
+        fprintf(ofp, "    {\"name\": \"%s\", \"n\": %d, \"ops\": %ld, \"min_s\": %.9f, \"p10_s\": %.9f, \"median_s\": %.9f, "
+                     "\"p90_s\": %.9f, \"max_s\": %.9f, \"mean_s\": %.9f, \"median_ns_per_op\": %.3f, \"runs_s\": [",
+                r.name.c_str(), r.n, r.ops, sorted.front(), percentile(sorted, 10), percentile(sorted, 50),
+                percentile(sorted, 90), sorted.back(), mean, percentile(sorted, 50) * 1e9 / r.ops);
+        for(size_t i = 0; i < r.runs.size(); i++) fprintf(ofp, i ? ", %.9f" : "%.9f", r.runs[i]);
+        fprintf(ofp, "]}%s\n", k + 1 < bench_results.size() ? "," : "");
+    }
+    fprintf(ofp, "  ]\n}\n");
+    fclose(ofp);
+    printf("  Results are written to %s\n", path.c_str());
+}
+
+/* Sets up the permutation tables of S_n, 'b_matrix' is allocated but not filled */
+static void bench_group_initiate(int n, bool with_matrix){
+    if(b_matrix != NULL){
+        for(size_t i = 0; i < all_p.size(); i++) delete[] b_matrix[i];
+        delete[] b_matrix; b_matrix = NULL;
+    }
+    current_sn_group = n;
+    all_p = permt_all_sn(n);
+    all_p_len = permt_lengths(all_p);
+    all_p_data = permt_with_extra_data(all_p, all_p_len);
+    permt_index_tables_initiate();
+    greek_mu_table_initiate();
+    temp_database.clear();
+    if(!with_matrix) return;
+    b_matrix = new int*[all_p.size()];
+    for(size_t i = 0; i < all_p.size(); i++) b_matrix[i] = new int[all_p.size()];
+}
+
+// Permutations of the workloads are picked uniformly from all_p
+static vector<int> random_indexes(mt19937_64& generator, size_t amount){
+    uniform_int_distribution<int> pick(0, all_p.size() - 1);
+    vector<int> result(amount);
+    for(size_t k = 0; k < amount; k++) result[k] = pick(generator);
+    return result;
+}
+
+// Pairs u < v with respect to bruhat order, 'b_matrix' has to be filled
+static vector<pair<int, int>> random_comparable_pairs(mt19937_64& generator, size_t amount){
+    uniform_int_distribution<int> pick(0, all_p.size() - 1);
+    vector<pair<int, int>> result;
+    while(result.size() < amount){
+        int u_index = pick(generator), v_index = pick(generator);
+        if(b_matrix[u_index][v_index] == 1) result.push_back({u_index, v_index});
+    }
+    return result;
+}
+
+static Polynomial random_polynomial(mt19937_64& generator){
+    uniform_int_distribution<int> degree(0, 8), coefficient(1, 20);
+    Polynomial result;
+    int top = degree(generator);
+    for(int power = 0; power <= top; power++) result.coefficients[power] = coefficient(generator);
+    return result;
+}
+
+/* Benchmarks that only need the permutations of S_n */
+static void bench_permutations(int n){
+    bench_group_initiate(n, false);
+    mt19937_64 generator(bench_seed + n);
+    vector<int> permts = random_indexes(generator, 100000), others = random_indexes(generator, 100000);
+
+    bench_run("permt_inversion_amount", n, permts.size(), [&]{
+        long sum = 0;
+        for(int index : permts) sum += permt_inversion_amount(all_p[index]);
+        bench_sink = bench_sink + sum;
+    });
+    bench_run("transp_1length_diff", n, 10000, [&]{
+        long sum = 0;
+        for(int k = 0; k < 10000; k++) sum += transp_1length_diff(all_p[permts[k]]).size();
+        bench_sink = bench_sink + sum;
+    });
+    bench_run("bruhat_compare", n, permts.size(), [&]{
+        long sum = 0;
+        for(size_t k = 0; k < permts.size(); k++){
+            sum += bruhat_compare(all_p[permts[k]], all_p[others[k]], all_p_len[permts[k]], all_p_len[others[k]]);
+        }
+        bench_sink = bench_sink + sum;
+    });
+}
+
+/* Benchmarks that need 'b_matrix' of S_n */
+static void bench_matrix(int n){
+    bench_group_initiate(n, true);
+    long f_n = all_p.size();
+    bench_run("bruhat_matrix_all_sn", n, f_n * f_n, []{ bruhat_matrix_all_sn(current_sn_group); });
+    bench_run("bruhat_matrix_multi_threaded", n, f_n * f_n, []{ bruhat_matrix_all_sn_multi_threaded(current_sn_group); });
+    // with --only the benchmarks above may be skipped, the workloads below still need the matrix
+    if(!bench_only.empty() && string("bruhat_matrix_multi_threaded").find(bench_only) == string::npos)
+        bruhat_matrix_all_sn_multi_threaded(current_sn_group);
+
+    mt19937_64 generator(bench_seed + 100 + n);
+    vector<pair<int, int>> pairs = random_comparable_pairs(generator, 1000);
+    bench_run("bruhat_matrix_interval", n, pairs.size(), [&]{
+        long sum = 0;
+        for(auto itr = pairs.begin(); itr != pairs.end(); itr++){
+            sum += bruhat_matrix_interval(all_p[itr->first], all_p[itr->second], itr->first, itr->second).size();
+        }
+        bench_sink = bench_sink + sum;
+    });
+    // the part of the interval the z-loop of polynom_k_l takes, z with the first right descent of v
+    vector<int> z_map(all_p.size());
+    bench_run("bruhat_matrix_interval_descents", n, pairs.size(), [&]{
+        long sum = 0;
+        for(auto itr = pairs.begin(); itr != pairs.end(); itr++){
+            int i = permt_first_right_descent(all_p[itr->second]);
+            sum += bruhat_matrix_interval_descents(itr->first, itr->second, i, z_map.data());
+        }
+        bench_sink = bench_sink + sum;
+    });
+
+    // every run starts cold, without the polynomials the previous run computed
+    vector<pair<int, int>> k_l_pairs(pairs.begin(), pairs.begin() + 200);
+    bench_run("polynom_k_l", n, k_l_pairs.size(), [&]{
+        long sum = 0;
+        for(auto itr = k_l_pairs.begin(); itr != k_l_pairs.end(); itr++){
+            sum += polynom_k_l(all_p[itr->first], all_p[itr->second]).coefficients.size();
+        }
+        bench_sink = bench_sink + sum;
+    }, []{ temp_database.clear(); greek_mu_table_initiate(); });
+}
+
+int main(int argc, char** argv){
+    int max_n = 6;
+    string json_path = "bench-results.json";
+    for(int k = 1; k < argc; k++){
+        string option = argv[k];
+        if(k + 1 >= argc){ printf("  %s needs a value\n", option.c_str()); return 1; }
+        if(option == "--repeats") bench_repeats = max(1, atoi(argv[++k]));
+        else if(option == "--seed") bench_seed = strtoull(argv[++k], NULL, 10);
+        else if(option == "--max-n") max_n = atoi(argv[++k]);
+        else if(option == "--json") json_path = argv[++k];
+        else if(option == "--only") bench_only = argv[++k];
+        else{
+            printf("usage: %s [--repeats <r>] [--seed <s>] [--max-n <n>] [--json <file>] [--only <name>]\n", argv[0]);
+            return 1;
+        }
+    }
+    printf("  seed %llu, %d repeats\n", (unsigned long long)bench_seed, bench_repeats);
+
+    mt19937_64 generator(bench_seed);
+    vector<pair<Polynomial, Polynomial>> polynomials(10000);
+    for(auto itr = polynomials.begin(); itr != polynomials.end(); itr++) *itr = {random_polynomial(generator), random_polynomial(generator)};
+    bench_run("polynom_multiply", 0, polynomials.size(), [&]{
+        long sum = 0;
+        for(auto itr = polynomials.begin(); itr != polynomials.end(); itr++) sum += polynom_multiply(itr->first, itr->second).coefficients.size();
+        bench_sink = bench_sink + sum;
+    });
+
+    for(int n = 4; n <= 8; n++) bench_permutations(n);
+    for(int n = 4; n <= max_n; n++) bench_matrix(n);
+
+    bench_write_json(json_path);
+    return 0;
+}
@@ -0,0 +1,152 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "k-l-cells.h"
+
+using namespace std;
+
+/* This function does not have a meaning on its own, it runs one relation for 'k_l_cells_all_sn' */
+static void cells_worker_function(const WGraph* g, int relation, vector<int>* membership, int* cell_amount){
+    vector<int> offsets, targets;
+    k_l_cells_directed(*g, relation, offsets, targets);
+    *membership = k_l_cells_scc(offsets, targets, *cell_amount);
+}
+
+/*
+ Returns the left, right and two sided Kazhdan-Lusztig cells of S_n, using the W-graph 'g' which can be
+ obtained by 'w_graph_all_sn' or 'w_graph_read'. 'all_p' and 'all_p_len' should be initialized for S_n,
+ descent masks are initialized here if they are not already.
+
+ The three decompositions do not depend on each other, so each of them runs on its own thread.
+*/
+KLCells k_l_cells_all_sn(const WGraph& g){
+    if(all_p_right_descents.size() != all_p.size()) permt_descent_masks_initiate();
+    KLCells result; result.n = g.n;
+
+    thread left_worker(cells_worker_function, &g, K_L_CELLS_LEFT, &result.left, &result.left_amount);
+    thread right_worker(cells_worker_function, &g, K_L_CELLS_RIGHT, &result.right, &result.right_amount);
+    cells_worker_function(&g, K_L_CELLS_TWO_SIDED, &result.two_sided, &result.two_sided_amount);
+    left_worker.join();
+    right_worker.join();
+    return result;
+}
+
+/*
+ Builds the directed graph of a K-L preorder in compressed sparse row form, out of the W-graph.
+ For two permutations x, y joined in the W-graph, the left preorder has x <=(L) y when L(x) is not a subset
+ of L(y), where L is the left descent set, the right preorder uses the right descent sets in the same way.
+ The edge is stored as x -> y, the direction does not matter for the cells as they are strongly connected
+ components. The targets of x are targets[offsets[x]] ... targets[offsets[x + 1] - 1]
+*/
+void k_l_cells_directed(const WGraph& g, int relation, vector<int>& offsets, vector<int>& targets){
+    int vertex_amount = g.offsets.size() - 1;
+    offsets.assign(vertex_amount + 1, 0);
+    targets.clear(); targets.reserve(g.neighbours.size());
+
+    for(int x = 0; x < vertex_amount; x++){
+        unsigned int left_x = all_p_left_descents[x], right_x = all_p_right_descents[x];
+        for(int k = g.offsets[x]; k < g.offsets[x + 1]; k++){
+            int y = g.neighbours[k];
+            bool edge = false;
+            if((relation & K_L_CELLS_LEFT) && (left_x & ~all_p_left_descents[y]) != 0) edge = true;
+            if((relation & K_L_CELLS_RIGHT) && (right_x & ~all_p_right_descents[y]) != 0) edge = true;
+            if(edge) targets.push_back(y);
+        }
+        offsets[x + 1] = targets.size();
+    }
+    targets.shrink_to_fit();
+}
+
+/*
+ Strongly connected components of the given directed graph with Tarjan's algorithm. The recursion is
+ replaced by an explicit stack of (vertex, next edge position) pairs, so deep graphs do not overflow the
+ native stack. Returns the component of every vertex, numbered in the order of their smallest vertex,
+ and sets 'cell_amount' to the amount of components.
+*/
+vector<int> k_l_cells_scc(const vector<int>& offsets, const vector<int>& targets, int& cell_amount){
+    int vertex_amount = offsets.size() - 1;
+    vector<int> order(vertex_amount, -1), low_link(vertex_amount, 0), component(vertex_amount, -1);
+    vector<int> scc_stack; vector<bool> on_stack(vertex_amount, false);
+    vector<pair<int, int>> call_stack;
+    int counter = 0, component_counter = 0;
+
+    for(int root = 0; root < vertex_amount; root++){
+        if(order[root] != -1) continue;
+        call_stack.push_back({root, offsets[root]});
+        order[root] = low_link[root] = counter++;
+        scc_stack.push_back(root); on_stack[root] = true;
+
+        while(!call_stack.empty()){
+            int x = call_stack.back().first;
+            int& position = call_stack.back().second;
+            if(position < offsets[x + 1]){
+                int y = targets[position++];
+                if(order[y] == -1){
+                    // this is where the recursive version would call itself on y
+                    order[y] = low_link[y] = counter++;
+                    scc_stack.push_back(y); on_stack[y] = true;
+                    call_stack.push_back({y, offsets[y]});
+                }
+                else if(on_stack[y]) low_link[x] = min(low_link[x], order[y]);
+                continue;
+            }
+
+            // every edge of x is handled, x is the root of a component iff low_link[x] == order[x]
+            if(low_link[x] == order[x]){
+                int y;
+                do{
+                    y = scc_stack.back(); scc_stack.pop_back();
+                    on_stack[y] = false; component[y] = component_counter;
+                } while(y != x);
+                component_counter++;
+            }
+            call_stack.pop_back();
+            if(!call_stack.empty()){
+                int parent = call_stack.back().first;
+                low_link[parent] = min(low_link[parent], low_link[x]);
+            }
+        }
+    }
+
+    // renumbering the components in the order of their smallest vertex
+    vector<int> renumber(component_counter, -1);
+    cell_amount = 0;
+    for(int x = 0; x < vertex_amount; x++){
+        if(renumber[component[x]] == -1) renumber[component[x]] = cell_amount++;
+        component[x] = renumber[component[x]];
+    }
+    return component;
+}
+
+/* Prints the cells to the file stream, one permutation per line:
+ *         index:left_cell right_cell two_sided_cell */
+void k_l_cells_display(FILE* ifp, const KLCells& cells){
+    for(int x = 0; x < cells.left.size(); x++){
+        fprintf(ifp, "%d:%d %d %d\n", x, cells.left[x], cells.right[x], cells.two_sided[x]);
+    }
+}
+
+/* Writes the cells to 'k-l-cells<number>.txt' by default, in the format of 'k_l_cells_display'.
+ * Any file with the same name is overwritten. */
+void k_l_cells_write(const KLCells& cells, string file_name){
+    ostringstream s; s << file_name << cells.n << ".txt";
+    FILE* ifp = fopen(s.str().c_str(), "w");
+    k_l_cells_display(ifp, cells);
+    fclose(ifp);
+}
@@ -0,0 +1,61 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef K_L_CELLS
+#define K_L_CELLS
+/*--------------------------------*/
+#ifndef W_GRAPH
+#include "w-graph.h"
+#endif // !W_GRAPH
+/*--------------------------------*/
+#include <string>
+#endif // !K_L_CELLS
+
+/* Which generating relations of the K-L preorders are used, two sided uses both of them */
+#define K_L_CELLS_LEFT      1
+#define K_L_CELLS_RIGHT     2
+#define K_L_CELLS_TWO_SIDED 3
+
+// type definitions
+
+/* Cell membership for every permutation, layed out in the same order with 'all_p'. Cells are numbered
+ * 0, 1, 2 ... in the order of their smallest member, so two permutations are in the same left cell iff
+ * they have the same number inside 'left'. */
+struct KLCells
+{
+    int n;
+    std::vector<int> left;
+    std::vector<int> right;
+    std::vector<int> two_sided;
+    int left_amount;
+    int right_amount;
+    int two_sided_amount;
+};
+
+// function declarations
+
+KLCells k_l_cells_all_sn(const WGraph& g);
+
+void k_l_cells_directed(const WGraph& g, int relation, std::vector<int>& offsets, std::vector<int>& targets);
+
+std::vector<int> k_l_cells_scc(const std::vector<int>& offsets, const std::vector<int>& targets, int& cell_amount);
+
+void k_l_cells_display(FILE* ifp, const KLCells& cells);
+
+void k_l_cells_write(const KLCells& cells, std::string file_name = "k-l-cells");
@@ -0,0 +1,607 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+ Differential check of every K-L engine and database backend against golden tables, built and run by 'make check'.
+
+     k-l-check [--max-n <n>] [--threads <t>] [--standalone <pairs>] [--golden <directory>] [--regenerate] [--keep]
+
+ For S_3 up to S_<n> (6 by default) the golden table 'KL-golden<n>.txt' inside <directory> ('golden' by default)
+ holds P(u, v) of every pair u < v, one line "<u> <v> <polynomial>" each, written as in "k-l-query.h". A missing
+ table is generated by the reference recursion below. It only uses 'all_p' and tables of its own: the Bruhat order
+ from the rank criterion, lengths counted pair by pair and a memo. There is no database, no symmetry, no μ table,
+ no 'b_matrix' and no kernel of "permutation-kernels.h", so it does not share any of the code being checked. The
+ pairs u < v of the golden table are checked against the same rank criterion. Keep the golden directory between
+ releases, --regenerate writes it again.
+
+ First 'b_matrix' is compared with the rank criterion, every cell of it:
+     bruhat          bruhat_matrix_all_sn_multi_threaded
+ Every pair of the golden table is then asked from:
+     sequential      polynom_k_l, starting without any database
+     standalone      polynom_k_l_standalone, only on <pairs> pairs spread over the table (500 by default, 0 for all)
+     stack           the explicit stack of "k-l-stack.h", pairs stepped in turns, some suspended through checkpoints
+     parallel        k_l_parallel_evaluate on <t> threads (every core if 0)
+     context         k_l_context_evaluate on <t> threads, with a new context that computes its own bruhat matrix
+     log             the log written by 'sequential', replayed by a new k_l_database_initiate
+     store           KL-database<n>.bin after the log is compacted into it
+     table           KL-database<n>.bin written by the full table mode, see "k-l-table.h"
+     text            a legacy text database made from the golden table, read by 'k_l_database_read_text'
+     text->store     the same text database converted to KL-database<n>.bin
+     shards          a database with 3 shards, filled by the full table mode
+     shards-merge    the same filled by two 'main-driver --table <n>' processes at once, combined by 'k-l-merge <n> merge',
+                     which should not report any conflict. Both programs are taken from the directory of k-l-check.
+     shm             the shared memory segment, filled by 'parallel', see "k-l-shm.h"
+ Mismatches, pairs a backend does not have, and the throughput of each are printed side by side. The exit status
+ is 1 if anything does not match. Every database file is written inside a temporary directory, removed at the end
+ unless --keep is given.
+*/
+
+#include "k-l-table.h"
+#include "k-l-query.h"
+#include "k-l-context.h"
+#include "k-l-stack.h"
+#include <filesystem>
+#include <unordered_map>
+#include <map>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+// type definitions
+
+struct CheckResult
+{
+    string name;
+    size_t pairs = 0, mismatches = 0, missing = 0;
+    double seconds = 0;
+};
+
+/* GLOBAL VARIABLES --------------- */
+
+static int check_threads = 0;
+static size_t standalone_limit = 500;
+static vector<pair<int, int>> golden_pairs;
+static vector<string> golden_polynomials;
+static unordered_map<uint64_t, vector<long>> reference_memo;
+static vector<vector<char>> reference_below;   // reference_below[u][v] is 1 iff u < v, see 'reference_initiate'
+static vector<int> reference_lengths;
+static map<vector<int>, int> reference_indexes;
+static FILE* report = stdout;
+static string tool_directory = ".";             // where 'main-driver' and 'k-l-merge' are, the directory of k-l-check
+
+/*--------------------------------- */
+
+static double seconds_since(chrono::steady_clock::time_point start){
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static string permutation_text(int index){
+    string result;
+    for(int x : all_p[index]) result += char('0' + x);
+    return result;
+}
+
+static string coefficients_text(const vector<long>& coefficients){
+    string result;
+    for(size_t power = 0; power < coefficients.size(); power++){
+        if(coefficients[power] == 0) continue;
+        if(!result.empty()) result += ' ';
+        result += to_string(power) + ":" + to_string(coefficients[power]);
+    }
+    return result.empty() ? "0:0" : result;
+}
+
+/*
+ The tables of the reference recursion, for the elements of 'all_p'. The Bruhat order comes from the rank
+ criterion: with r_w(i, j) the amount of a <= i with w(a) >= j, u <= v iff r_u(i, j) <= r_v(i, j) for every i, j.
+ This is a different criterion from the tableau one of 'bruhat_compare' and the kernels.
+*/
+static void reference_initiate(void){
+    int amount = all_p.size(), n = all_p[0].size();
+    vector<vector<int>> ranks(amount, vector<int>(n * n, 0));
+    reference_lengths.assign(amount, 0);
+    reference_indexes.clear();
+    for(int w = 0; w < amount; w++){
+        const vector<int>& p = all_p[w];
+        for(int i = 0; i < n; i++){
+            for(int j = 0; j < n; j++) ranks[w][i * n + j] = (i > 0 ? ranks[w][(i - 1) * n + j] : 0) + (p[i] >= j + 1 ? 1 : 0);
+            for(int k = i + 1; k < n; k++) if(p[i] > p[k]) reference_lengths[w]++;
+        }
+        reference_indexes[p] = w;
+    }
+    reference_below.assign(amount, vector<char>(amount, 0));
+    for(int u = 0; u < amount; u++){
+        for(int v = 0; v < amount; v++){
+            if(u == v || reference_lengths[u] >= reference_lengths[v]) continue;
+            bool below = true;
+            for(int k = 0; k < n * n && below; k++) below = ranks[u][k] <= ranks[v][k];
+            reference_below[u][v] = below;
+        }
+    }
+}
+
+/*
+ The textbook recursion, for the first i with v(i) > v(i+1), s = s_i and c = 1 if u(i) > u(i+1), 0 otherwise:
+     P(u, v) = q^(1-c) P(us, vs) + q^c P(u, vs) - sum over u <= z < vs with z(i) > z(i+1) of
+               μ(z, vs) q^((l(v) - l(z)) / 2) P(u, z)
+ Note that 'reference_below' is 0 on its diagonal.
+*/
+static const vector<long>& reference_k_l(int u_index, int v_index){
+    static const vector<long> one = {1}, zero = {};
+    if(u_index == v_index) return one;
+    if(reference_below[u_index][v_index] == 0) return zero;
+    uint64_t key = ((uint64_t)u_index << 32) | (uint32_t)v_index;
+    auto fitr = reference_memo.find(key);
+    if(fitr != reference_memo.end()) return fitr->second;
+
+    const vector<int>& u = all_p[u_index];
+    vector<int> v = all_p[v_index];
+    int i = 0;
+    while(v[i] < v[i+1]) i++;
+    int c = u[i] > u[i+1] ? 1 : 0;
+    vector<int> us = u; swap(us[i], us[i+1]);
+    swap(v[i], v[i+1]);
+    int us_index = reference_indexes[us], vs_index = reference_indexes[v];
+
+    vector<long> result(reference_lengths[v_index] + 1, 0);
+    auto add_shifted = [&result](const vector<long>& poly, int shift, long factor){
+        for(size_t power = 0; power < poly.size(); power++) result[power + shift] += factor * poly[power];
+    };
+    add_shifted(reference_k_l(us_index, vs_index), 1 - c, 1);
+    add_shifted(reference_k_l(u_index, vs_index), c, 1);
+    for(int z_index = 0; z_index < (int)all_p.size(); z_index++){
+        if(z_index != u_index && reference_below[u_index][z_index] == 0) continue;
+        if(reference_below[z_index][vs_index] == 0 || all_p[z_index][i] < all_p[z_index][i+1]) continue;
+        int difference = reference_lengths[vs_index] - reference_lengths[z_index];
+        if(difference % 2 == 0) continue;
+        const vector<long>& z_poly = reference_k_l(z_index, vs_index);
+        long mu = (size_t)(difference - 1) / 2 < z_poly.size() ? z_poly[(difference - 1) / 2] : 0;
+        if(mu != 0) add_shifted(reference_k_l(u_index, z_index), (reference_lengths[v_index] - reference_lengths[z_index]) / 2, -mu);
+    }
+    while(!result.empty() && result.back() == 0) result.pop_back();
+    return reference_memo[key] = result;
+}
+
+/* Reads the golden table of the current group, generating it first if needed. Returns false if it is not usable. */
+static bool golden_load(string directory, bool regenerate){
+    string path = directory + "/KL-golden" + to_string(current_sn_group) + ".txt";
+    golden_pairs.clear(); golden_polynomials.clear();
+    vector<pair<int, int>> expected;
+    for(int v_index = 0; v_index < (int)all_p.size(); v_index++){
+        for(int u_index = 0; u_index < (int)all_p.size(); u_index++){
+            if(reference_below[u_index][v_index] == 1) expected.push_back({u_index, v_index});
+        }
+    }
+
+    FILE* ifp = regenerate ? NULL : fopen(path.c_str(), "r");
+    if(ifp == NULL){
+        auto start = chrono::steady_clock::now();
+        reference_memo.clear();
+        filesystem::create_directories(directory);
+        FILE* ofp = fopen((path + ".tmp").c_str(), "w");
+        if(ofp == NULL){ fprintf(report, "  Could not write %s\n", path.c_str()); return false; }
+        fprintf(ofp, "# KL-golden %d %zu\n", current_sn_group, expected.size());
+        for(auto itr = expected.begin(); itr != expected.end(); itr++){
+            fprintf(ofp, "%s %s %s\n", permutation_text(itr->first).c_str(), permutation_text(itr->second).c_str(),
+                    coefficients_text(reference_k_l(itr->first, itr->second)).c_str());
+        }
+        fclose(ofp);
+        rename((path + ".tmp").c_str(), path.c_str());
+        reference_memo.clear();
+        fprintf(report, "  S_%d: generated %s, %zu pairs in %.3f s\n", current_sn_group, path.c_str(), expected.size(), seconds_since(start));
+        ifp = fopen(path.c_str(), "r");
+        if(ifp == NULL) return false;
+    }
+
+    char line[1024];
+    while(fgets(line, sizeof(line), ifp) != NULL){
+        if(line[0] == '#') continue;
+        char u_text[32], v_text[32];
+        int consumed = 0;
+        if(sscanf(line, "%31s %31s %n", u_text, v_text, &consumed) != 2) continue;
+        vector<int> u, v;
+        if(!k_l_query_parse_permutation(u_text, u) || !k_l_query_parse_permutation(v_text, v) || u.size() != all_p[0].size()) continue;
+        string poly = line + consumed;
+        while(!poly.empty() && (poly.back() == '\n' || poly.back() == ' ')) poly.pop_back();
+        golden_pairs.push_back({reference_indexes[u], reference_indexes[v]});
+        golden_polynomials.push_back(poly);
+    }
+    fclose(ifp);
+
+    vector<pair<int, int>> sorted = golden_pairs;
+    sort(sorted.begin(), sorted.end(), [](auto& a, auto& b){ return make_pair(a.second, a.first) < make_pair(b.second, b.first); });
+    if(sorted != expected){
+        fprintf(report, "  S_%d: %s does not hold every pair u < v, use --regenerate\n", current_sn_group, path.c_str());
+        return false;
+    }
+    return true;
+}
+
+/* Compares the answers of one engine or backend with the golden table, 'found' is 0 for pairs it did not have
+ * and 2 for pairs that were not asked */
+static CheckResult golden_compare(string name, const vector<Polynomial>& results, const vector<char>& found, double seconds){
+    CheckResult result;
+    result.name = name; result.seconds = seconds;
+    for(size_t k = 0; k < golden_pairs.size(); k++){
+        if(found[k] == 2) continue;
+        result.pairs++;
+        if(!found[k]){ result.missing++; continue; }
+        string poly = k_l_query_format(results[k]);
+        if(poly == golden_polynomials[k]) continue;
+        if(result.mismatches++ < 5){
+            fprintf(report, "  S_%d %s: P(%s, %s) is %s, it should be %s\n", current_sn_group, name.c_str(),
+                    permutation_text(golden_pairs[k].first).c_str(), permutation_text(golden_pairs[k].second).c_str(),
+                    poly.c_str(), golden_polynomials[k].c_str());
+        }
+    }
+    return result;
+}
+
+/* Starts over inside an empty directory 'base/S<n>-<name>', with nothing inside any database or cache */
+static void fresh_state(string base, string name){
+    k_l_log_close();
+    k_l_store_close();
+    k_l_database.clear(); temp_database.clear();
+    k_l_memo_clear();
+    greek_mu_table_initiate();
+    string directory = base + "/S" + to_string(current_sn_group) + "-" + name;
+    filesystem::create_directories(directory);
+    if(chdir(directory.c_str()) != 0) fprintf(report, "  Could not enter %s\n", directory.c_str());
+}
+
+/* Asks every golden pair from the databases, pairs with v = w0 are not stored by anything so they are answered here */
+static CheckResult backend_check(string name, double extra_seconds = 0, bool initiate = true){
+    if(initiate) k_l_database_initiate();
+    auto start = chrono::steady_clock::now();
+    int max_len = (current_sn_group * (current_sn_group - 1)) / 2;
+    vector<Polynomial> results(golden_pairs.size());
+    vector<char> found(golden_pairs.size(), 0);
+    for(size_t k = 0; k < golden_pairs.size(); k++){
+        auto [u_index, v_index] = golden_pairs[k];
+        if(all_p_len[v_index] == max_len){ results[k] = {{{0,1}}}; found[k] = 1; continue; }
+        auto dummy = k_l_database_check({all_p[u_index], all_p[v_index]}, u_index, v_index);
+        results[k] = dummy.second; found[k] = dummy.first;
+    }
+    return golden_compare(name, results, found, seconds_since(start) + extra_seconds);
+}
+
+/* Starts the program arguments[0] of 'tool_directory' inside the current directory, its output goes to 'output_fd'
+ * or is dropped if that is -1. Returns the process ID, or -1 if the process could not be started. */
+static pid_t tool_start(vector<string> arguments, int output_fd){
+    // everything is prepared before the fork, other threads of this process may hold locks of the allocator
+    string program = tool_directory + "/" + arguments[0];
+    vector<char*> argv;
+    for(auto itr = arguments.begin(); itr != arguments.end(); itr++) argv.push_back(itr->data());
+    argv.push_back(NULL);
+    fflush(report);
+    pid_t pid = fork();
+    if(pid != 0) return pid;
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(output_fd == -1 ? null_fd : output_fd, STDOUT_FILENO);
+    dup2(null_fd, STDERR_FILENO);
+    execv(program.c_str(), argv.data());
+    _exit(127);
+}
+
+/* Waits for a process started by 'tool_start', returns its exit status or -1 if it did not exit normally */
+static int tool_wait(pid_t pid){
+    int status;
+    if(pid == -1 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) return -1;
+    return WEXITSTATUS(status);
+}
+
+/*
+ Two table runs fill the sharded database of the current directory at once, each one with its own run, and
+ 'k-l-merge' combines their files. Every golden pair is then asked from the merged shards, conflicts that the merge
+ reports are counted as mismatches. If any of the programs fails, every pair is counted as missing.
+*/
+static CheckResult shards_merge_check(string name){
+    string n = to_string(current_sn_group);
+    auto start = chrono::steady_clock::now();
+    if(tool_wait(tool_start({"k-l-merge", n, "init", "3"}, -1)) != 0){
+        fprintf(report, "  S_%d %s: could not run %s/k-l-merge\n", current_sn_group, name.c_str(), tool_directory.c_str());
+        return {name, golden_pairs.size(), 0, golden_pairs.size(), 0};
+    }
+    pid_t first = tool_start({"main-driver", "--table", n}, -1), second = tool_start({"main-driver", "--table", n}, -1);
+    int first_status = tool_wait(first), second_status = tool_wait(second);
+
+    int pipe_fds[2] = {-1, -1};
+    string output;
+    pid_t merge = -1;
+    if(pipe(pipe_fds) == 0){
+        merge = tool_start({"k-l-merge", n, "merge"}, pipe_fds[1]);
+        close(pipe_fds[1]);
+        char buffer[4096]; ssize_t amount;
+        while((amount = read(pipe_fds[0], buffer, sizeof(buffer))) > 0) output.append(buffer, amount);
+        close(pipe_fds[0]);
+    }
+    int merge_status = tool_wait(merge);
+    double seconds = seconds_since(start);
+
+    // the last line of the merge is "<read> pairs read, <kept> kept, <conflicts> conflicts"
+    size_t read_amount = 0, kept = 0, conflicts = 0;
+    size_t line = output.rfind('\n', output.size() >= 2 ? output.size() - 2 : 0);
+    bool parsed = sscanf(output.c_str() + (line == string::npos ? 0 : line + 1), "%zu pairs read, %zu kept, %zu conflicts",
+                         &read_amount, &kept, &conflicts) == 3;
+
+    CheckResult result = backend_check(name, seconds);
+    result.mismatches += conflicts;
+    if(first_status != 0 || second_status != 0 || !parsed || (merge_status != 0 && conflicts == 0)){
+        fprintf(report, "  S_%d %s: the table runs exited with %d and %d, the merge with %d\n", current_sn_group, name.c_str(),
+                first_status, second_status, merge_status);
+        result.missing = result.pairs;
+    }
+    return result;
+}
+
+/* Computes the golden pairs with 'engine', one pair after the other. At most 'limit' pairs spread evenly
+ * over the table are asked if it is not 0. */
+static CheckResult engine_check(string name, function<Polynomial(int, int)> engine, size_t limit = 0){
+    size_t stride = (limit == 0 || golden_pairs.size() <= limit) ? 1 : (golden_pairs.size() + limit - 1) / limit;
+    auto start = chrono::steady_clock::now();
+    vector<Polynomial> results(golden_pairs.size());
+    vector<char> found(golden_pairs.size(), 2);
+    for(size_t k = 0; k < golden_pairs.size(); k += stride){
+        results[k] = engine(golden_pairs[k].first, golden_pairs[k].second);
+        found[k] = 1;
+    }
+    return golden_compare(name, results, found, seconds_since(start));
+}
+
+static CheckResult parallel_check(string name){
+    auto start = chrono::steady_clock::now();
+    k_l_parallel_initiate(check_threads);
+    vector<Polynomial> results(golden_pairs.size());
+    k_l_parallel_for(golden_pairs.size(), [&results](size_t k){
+        results[k] = k_l_parallel_evaluate(golden_pairs[k].first, golden_pairs[k].second);
+    });
+    return golden_compare(name, results, vector<char>(golden_pairs.size(), 1), seconds_since(start));
+}
+
+/* Every thread takes the next pair and asks it from the same context, see "k-l-context.h" */
+static CheckResult context_check(string name){
+    auto start = chrono::steady_clock::now();
+    auto context = k_l_context_create(current_sn_group);
+    vector<Polynomial> results(golden_pairs.size());
+    atomic<size_t> next_pair(0);
+    auto worker = [&context, &results, &next_pair]{
+        size_t k;
+        while((k = next_pair.fetch_add(1)) < golden_pairs.size()){
+            results[k] = k_l_context_evaluate(*context, golden_pairs[k].first, golden_pairs[k].second);
+        }
+    };
+    int thread_amount = check_threads > 0 ? check_threads : max(1u, thread::hardware_concurrency());
+    vector<thread> workers;
+    for(int i = 1; i < thread_amount; i++) workers.emplace_back(worker);
+    worker();
+    for(auto itr = workers.begin(); itr != workers.end(); itr++) itr->join();
+    return golden_compare(name, results, vector<char>(golden_pairs.size(), 1), seconds_since(start));
+}
+
+/* K_L_CHECK_STACK_WIDTH pairs are stepped in turns by 'k_l_stack_interleave'. In one group of every
+ * K_L_CHECK_STACK_SUSPEND, each state is written to a checkpoint and read back after every step instead */
+#define K_L_CHECK_STACK_WIDTH 16
+#define K_L_CHECK_STACK_SUSPEND 256
+
+static CheckResult stack_check(string name){
+    auto start = chrono::steady_clock::now();
+    vector<Polynomial> results(golden_pairs.size());
+    for(size_t first = 0; first < golden_pairs.size(); first += K_L_CHECK_STACK_WIDTH){
+        size_t last = min(golden_pairs.size(), first + K_L_CHECK_STACK_WIDTH);
+        vector<KLStackState> states;
+        for(size_t k = first; k < last; k++) states.push_back(k_l_stack_begin(golden_pairs[k].first, golden_pairs[k].second));
+        if((first / K_L_CHECK_STACK_WIDTH) % K_L_CHECK_STACK_SUSPEND != 0) k_l_stack_interleave(states, 4);
+        else{
+            for(auto itr = states.begin(); itr != states.end(); itr++){
+                while(!k_l_stack_run(*itr, 1)){
+                    KLStackState resumed;
+                    if(!k_l_stack_save(*itr, "KL-stack.checkpoint") || !k_l_stack_load(resumed, "KL-stack.checkpoint")) break;
+                    *itr = std::move(resumed);
+                }
+            }
+        }
+        for(size_t k = first; k < last; k++) results[k] = states[k - first].returned;
+    }
+    return golden_compare(name, results, vector<char>(golden_pairs.size(), 1), seconds_since(start));
+}
+
+// The legacy text database, "u_index:v_index={power coefficient ...}" on each line
+static void write_text_database(void){
+    ostringstream s; s << database_name << current_sn_group << ".txt";
+    FILE* ofp = fopen(s.str().c_str(), "w");
+    if(ofp == NULL) return;
+    for(size_t k = 0; k < golden_pairs.size(); k++){
+        fprintf(ofp, "%d:%d={", golden_pairs[k].first, golden_pairs[k].second);
+        string poly = golden_polynomials[k];
+        replace(poly.begin(), poly.end(), ':', ' ');
+        fprintf(ofp, "%s}\n", poly.c_str());
+    }
+    fclose(ofp);
+}
+
+/* Compares every cell of 'b_matrix' with the rank criterion, a cell that differs is a mismatch */
+static CheckResult bruhat_check(string name){
+    auto start = chrono::steady_clock::now();
+    CheckResult result = {name, all_p.size() * all_p.size()};
+    for(size_t u_index = 0; u_index < all_p.size(); u_index++){
+        for(size_t v_index = 0; v_index < all_p.size(); v_index++){
+            if((b_matrix[u_index][v_index] == 1) != (reference_below[u_index][v_index] == 1)) result.mismatches++;
+        }
+    }
+    result.seconds = seconds_since(start);
+    return result;
+}
+
+static vector<CheckResult> check_group(string base){
+    vector<CheckResult> results;
+    int max_len = (current_sn_group * (current_sn_group - 1)) / 2;
+    results.push_back(bruhat_check("bruhat"));
+
+    fresh_state(base, "sequential");
+    k_l_database_initiate();
+    results.push_back(engine_check("sequential", [](int u_index, int v_index){ return polynom_k_l(all_p[u_index], all_p[v_index]); }));
+    k_l_log_close();
+
+    // the log of 'sequential' is replayed into temp_database by k_l_database_initiate, then compacted
+    temp_database.clear();
+    results.push_back(backend_check("log"));
+    k_l_database_append();
+    k_l_log_close(); k_l_store_close(); temp_database.clear();
+    results.push_back(backend_check("store"));
+
+    fresh_state(base, "standalone");
+    k_l_database_initiate();
+    // it compares every permutation with u and v in each frame, which is slow, so only a part of the pairs is asked
+    results.push_back(engine_check("standalone", [](int u_index, int v_index){
+        return polynom_k_l_standalone(all_p[u_index], all_p[v_index]);
+    }, standalone_limit));
+
+    fresh_state(base, "stack");
+    k_l_database_initiate();
+    results.push_back(stack_check("stack"));
+
+    // the same without the descent tables, the stack walks the whole interval then
+    fresh_state(base, "stack-scan");
+    k_l_database_initiate();
+    vector<vector<uint64_t>> descent_bits; descent_bits.swap(all_p_descent_bits);
+    results.push_back(stack_check("stack-scan"));
+    descent_bits.swap(all_p_descent_bits);
+
+    fresh_state(base, "parallel");
+    k_l_database_initiate();
+    results.push_back(parallel_check("parallel"));
+
+    // there is no matrix file or database inside the directory, the context starts from nothing
+    fresh_state(base, "context");
+    results.push_back(context_check("context"));
+
+    fresh_state(base, "table");
+    k_l_database_initiate();
+    auto start = chrono::steady_clock::now();
+    k_l_table_run(check_threads);
+    double table_seconds = seconds_since(start);
+    fresh_state(base, "table");
+    results.push_back(backend_check("table", table_seconds));
+
+    fresh_state(base, "text");
+    write_text_database();
+    start = chrono::steady_clock::now();
+    bool text_read = k_l_database_read_text(check_threads);
+    results.push_back(backend_check("text", seconds_since(start), false));
+    if(!text_read) results.back().missing = results.back().pairs;
+    // k_l_database_initiate finds the text database and converts it
+    k_l_database.clear();
+    results.push_back(backend_check("text->store"));
+
+    fresh_state(base, "shards");
+    k_l_shards_create(3);
+    k_l_database_initiate();
+    start = chrono::steady_clock::now();
+    k_l_table_run(check_threads);
+    table_seconds = seconds_since(start);
+    fresh_state(base, "shards");
+    results.push_back(backend_check("shards", table_seconds));
+
+    fresh_state(base, "shards-merge");
+    results.push_back(shards_merge_check("shards-merge"));
+
+    // the segment takes over 'b_matrix', the private one is released first
+    fresh_state(base, "shm");
+    for(size_t i = 0; i < all_p.size(); i++) delete[] b_matrix[i];
+    delete[] b_matrix; b_matrix = NULL;
+    if(k_l_shm_attach()){
+        k_l_database_initiate();
+        parallel_check("shm-fill");
+        k_l_log_close(); k_l_store_close(); temp_database.clear(); k_l_memo_clear();
+        start = chrono::steady_clock::now();
+        vector<Polynomial> shm_results(golden_pairs.size());
+        vector<char> found(golden_pairs.size(), 0);
+        for(size_t k = 0; k < golden_pairs.size(); k++){
+            auto canonical = k_l_symmetry_canonical(golden_pairs[k].first, golden_pairs[k].second);
+            if(canonical.first == canonical.second || all_p_len[canonical.second] == max_len){ shm_results[k] = {{{0,1}}}; found[k] = 1; }
+            else found[k] = k_l_shm_lookup(canonical.first, canonical.second, shm_results[k]);
+        }
+        results.push_back(golden_compare("shm", shm_results, found, seconds_since(start)));
+        k_l_shm_detach();
+    }
+    else results.push_back({"shm", golden_pairs.size(), 0, golden_pairs.size(), 0});
+    return results;
+}
+
+int main(int argc, char** argv){
+    int max_n = 6;
+    string golden_directory = "golden";
+    bool regenerate = false, keep = false;
+    for(int k = 1; k < argc; k++){
+        string option = argv[k];
+        if(option == "--regenerate") regenerate = true;
+        else if(option == "--keep") keep = true;
+        else if(option == "--max-n" && k + 1 < argc) max_n = atoi(argv[++k]);
+        else if(option == "--threads" && k + 1 < argc) check_threads = atoi(argv[++k]);
+        else if(option == "--standalone" && k + 1 < argc) standalone_limit = strtoull(argv[++k], NULL, 10);
+        else if(option == "--golden" && k + 1 < argc) golden_directory = argv[++k];
+        else{
+            printf("usage: %s [--max-n <n>] [--threads <t>] [--standalone <pairs>] [--golden <directory>] [--regenerate] [--keep]\n", argv[0]);
+            return 1;
+        }
+    }
+    golden_directory = filesystem::absolute(golden_directory).string();
+    tool_directory = filesystem::absolute(argv[0]).parent_path().string();
+    char base_template[] = "/tmp/k-l-check.XXXXXX";
+    if(mkdtemp(base_template) == NULL){ printf("  Could not create a temporary directory\n"); return 1; }
+    string base = base_template;
+
+    // the report goes to stdout, whatever the engines print is dropped
+    fflush(stdout);
+    report = fdopen(dup(fileno(stdout)), "w");
+    setvbuf(report, NULL, _IOLBF, 0);
+    if(freopen("/dev/null", "w", stdout) == NULL) return 1;
+
+    bool all_match = true;
+    for(int n = 3; n <= max_n; n++){
+        current_sn_group = n;
+        all_p = permt_all_sn(n);
+        all_p_len = permt_lengths(all_p);
+        all_p_data = permt_with_extra_data(all_p, all_p_len);
+        permt_index_tables_initiate();
+        b_matrix = new int*[all_p.size()];
+        for(size_t i = 0; i < all_p.size(); i++) b_matrix[i] = new int[all_p.size()];
+        bruhat_matrix_all_sn_multi_threaded(n);
+        reference_initiate();
+
+        if(!golden_load(golden_directory, regenerate)){ all_match = false; break; }
+        vector<CheckResult> results = check_group(base);
+        fprintf(report, "  S_%d %-12s %10s %11s %9s %10s %12s\n", n, "", "pairs", "mismatches", "missing", "seconds", "pairs/s");
+        for(auto itr = results.begin(); itr != results.end(); itr++){
+            fprintf(report, "      %-12s %10zu %11zu %9zu %10.3f %12.0f\n", itr->name.c_str(), itr->pairs, itr->mismatches,
+                    itr->missing, itr->seconds, itr->pairs / max(itr->seconds, 1e-9));
+            if(itr->mismatches != 0 || itr->missing != 0) all_match = false;
+        }
+    }
+    k_l_scheduler_stop();
+    k_l_log_close();
+    k_l_store_close();
+    if(!keep) filesystem::remove_all(base);
+    else fprintf(report, "  Database files are kept inside %s\n", base.c_str());
+    fprintf(report, "  %s\n", all_match ? "Every engine and backend matches the golden tables" : "MISMATCHES FOUND");
+    return all_match ? 0 : 1;
+}
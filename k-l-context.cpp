@@ -0,0 +1,184 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "k-l-context.h"
+
+using namespace std;
+
+/* Reads 'bruhat-matrix<n>.txt' into the matrix of the context, returns false if the file is not there or too short */
+static bool context_read_matrix(KLContext& context, string path){
+    FILE* ifp = fopen(path.c_str(), "r");
+    if(ifp == NULL) return false;
+    size_t f_n = context.permutations.size();
+    vector<char> line(f_n + 2);
+    bool complete = true;
+    for(size_t i = 0; i < f_n && complete; i++){
+        complete = fgets(line.data(), line.size(), ifp) != NULL && strlen(line.data()) >= f_n;
+        for(size_t j = 0; j < f_n && complete; j++) context.bruhat[i * f_n + j] = line[j] == '1';
+    }
+    fclose(ifp);
+    return complete;
+}
+
+/* Fills the matrix of the context with the kernel of the group, rows are split between the cores */
+static void context_compute_matrix(KLContext& context){
+    size_t f_n = context.permutations.size();
+    int thread_amount = max(1u, thread::hardware_concurrency());
+    atomic<size_t> next_row(0);
+    const PermtKernels* kernels = permt_kernels_get(context.n);
+    auto worker = [&context, &next_row, f_n, kernels]{
+        size_t i;
+        while((i = next_row.fetch_add(1)) < f_n){
+            for(size_t j = 0; j < f_n; j++){
+                if(kernels != NULL){
+                    context.bruhat[i * f_n + j] = context.lengths[i] < context.lengths[j]
+                                               && kernels->bruhat_below(context.permutations[i].data(), context.permutations[j].data());
+                }
+                else context.bruhat[i * f_n + j] = bruhat_compare(context.permutations[i], context.permutations[j],
+                                                                  context.lengths[i], context.lengths[j]);
+            }
+        }
+    };
+    vector<thread> workers;
+    for(int k = 1; k < thread_amount; k++) workers.emplace_back(worker);
+    worker();
+    for(auto itr = workers.begin(); itr != workers.end(); itr++) itr->join();
+}
+
+/*
+ Creates the context of S_n. The bruhat matrix is read from '<matrix_file><n>.txt' if that file exists, otherwise
+ it is computed, which takes very long for S_8 and above. The binary database '<file_name><n>.bin' is mapped if
+ it exists. Nothing global is read or changed, apart from 'polynom_pool' which is thread safe.
+*/
+shared_ptr<const KLContext> k_l_context_create(int n, string matrix_file, string file_name){
+    auto context = make_shared<KLContext>();
+    context->n = n;
+    context->max_length = n * (n - 1) / 2;
+    context->permutations = permt_all_sn(n);
+    context->lengths = permt_lengths(context->permutations);
+    int f_n = context->permutations.size();
+
+    // the same tables with 'permt_index_tables_initiate', for the permutations of this context
+    context->right_descents.resize(f_n); context->left_descents.resize(f_n);
+    context->inverse.resize(f_n); context->w0_conjugate.resize(f_n);
+    context->right_multp.assign(n - 1, vector<int>(f_n)); context->left_multp.assign(n - 1, vector<int>(f_n));
+    for(int k = 0; k < f_n; k++){
+        const vector<int>& w = context->permutations[k];
+        context->right_descents[k] = permt_right_descent_mask(w);
+        context->left_descents[k] = permt_left_descent_mask(w);
+        context->inverse[k] = permt_rank(permt_inverse(w));
+        vector<int> conjugate(n);
+        for(int j = 0; j < n; j++) conjugate[j] = n + 1 - w[n - 1 - j];
+        context->w0_conjugate[k] = permt_rank(conjugate);
+        for(int i = 1; i < n; i++){
+            context->right_multp[i - 1][k] = permt_rank(permt_multp_right(w, {i, i + 1}));
+            context->left_multp[i - 1][k] = permt_rank(permt_multp_left(w, {i, i + 1}));
+        }
+    }
+
+    context->descent_bits = permt_descent_bits(context->right_descents, n);
+
+    context->bruhat.assign((size_t)f_n * f_n, 0);
+    if(!context_read_matrix(*context, matrix_file + to_string(n) + ".txt")) context_compute_matrix(*context);
+    k_l_store_map_segments(context->segments, file_name + to_string(n) + ".bin", n);
+    k_l_store_map(context->store, file_name + to_string(n) + ".bin", n);
+    return context;
+}
+
+/* Index of the permutation inside the context, -1 if it is not a permutation of S_n */
+int k_l_context_index(const KLContext& context, const vector<int>& permt){
+    if(permt.size() != context.n) return -1;
+    vector<bool> seen(context.n + 1, false);
+    for(auto itr = permt.begin(); itr != permt.end(); itr++){
+        if(*itr < 1 || *itr > context.n || seen[*itr]) return -1;
+        seen[*itr] = true;
+    }
+    return permt_rank(permt);
+}
+
+/* The same with 'k_l_symmetry_canonical', on the tables of the context */
+pair<int, int> k_l_context_canonical(const KLContext& context, int u_index, int v_index){
+    while(true){
+        unsigned int missing = context.right_descents[v_index] & ~context.right_descents[u_index];
+        if(missing != 0){ u_index = context.right_multp[__builtin_ctz(missing)][u_index]; continue; }
+        missing = context.left_descents[v_index] & ~context.left_descents[u_index];
+        if(missing != 0){ u_index = context.left_multp[__builtin_ctz(missing)][u_index]; continue; }
+        break;
+    }
+    int u_inverse = context.inverse[u_index], v_inverse = context.inverse[v_index];
+    pair<int, int> images[4] = {
+        {u_index, v_index},
+        {u_inverse, v_inverse},
+        {context.w0_conjugate[u_index], context.w0_conjugate[v_index]},
+        {context.w0_conjugate[u_inverse], context.w0_conjugate[v_inverse]}
+    };
+    pair<int, int> result = images[0];
+    for(int k = 1; k < 4; k++){
+        if(images[k].second < result.second || (images[k].second == result.second && images[k].first < result.first))
+            result = images[k];
+    }
+    return result;
+}
+
+/* The pair inside the binary database of the context, 0 if it is not there. See 'k_l_store_find_id'. */
+uint32_t k_l_context_stored_id(const KLContext& context, int u_index, int v_index){
+    uint32_t id = k_l_store_find_id(context.store, u_index, v_index);
+    for(auto itr = context.segments.begin(); itr != context.segments.end() && id == 0; itr++) id = k_l_store_find_id(*itr, u_index, v_index);
+    return id;
+}
+
+/* The same with 'bruhat_matrix_interval_descents', on the tables of the context */
+int k_l_context_interval_descents(const KLContext& context, int u_index, int v_index, int i, int* result){
+    int size = 0;
+    const vector<uint64_t>& bits = context.descent_bits[i - 1];
+    for(int z_index = permt_bits_next(bits, u_index, v_index); z_index != -1; z_index = permt_bits_next(bits, z_index + 1, v_index)){
+        if(z_index != u_index && !k_l_context_below(context, u_index, z_index)) continue;
+        if(z_index != v_index && !k_l_context_below(context, z_index, v_index)) continue;
+        result[size++] = z_index;
+    }
+    return size;
+}
+
+/*
+ Returns P(u, v) for the permutations with the given indexes inside the context. The recursion is the one of
+ 'k_l_parallel_evaluate', run on the tables, the database and the memo of the context. Thread safe: a pair is
+ computed once, threads asking for a pair that another thread is computing wait for it.
+*/
+Polynomial k_l_context_evaluate(const KLContext& context, int u_index, int v_index){
+    return k_l_parallel_evaluate(u_index, v_index, &context);
+}
+
+/* P(u, v) for permutations in line notation, returns false if they are not permutations of the group of the context */
+bool k_l_context_polynomial(const KLContext& context, const vector<int>& u, const vector<int>& v, Polynomial& result){
+    int u_index = k_l_context_index(context, u), v_index = k_l_context_index(context, v);
+    if(u_index == -1 || v_index == -1) return false;
+    result = k_l_context_evaluate(context, u_index, v_index);
+    return true;
+}
+
+/* Amount of pairs inside the memo of the context, computed or still being computed */
+size_t k_l_context_memo_size(const KLContext& context){
+    size_t amount = 0;
+    for(int i = 0; i < K_L_MEMO_SHARDS; i++){
+        lock_guard<mutex> guard(context.memo[i].lock);
+        amount += context.memo[i].entries.size();
+    }
+    return amount;
+}
@@ -0,0 +1,93 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef K_L_CONTEXT
+#define K_L_CONTEXT
+/*--------------------------------*/
+#ifndef K_L_PARALLEL
+#include "k-l-parallel.h"
+#endif // !K_L_PARALLEL
+/*--------------------------------*/
+#include <cstdint>
+#include <memory>
+#include <string>
+#endif // !K_L_CONTEXT
+
+/*
+ Everything needed to compute K-L polynomials of one group S_n, without any of the global variables. A context
+ is created once by 'k_l_context_create' and never changes afterwards, except for its memo, so any number of
+ threads may share it and read its tables without a lock. Contexts of different groups are independent of each
+ other, queries on S_6, S_7 and S_8 can run at the same time inside one process.
+
+ The tables are the same with the global ones of "permutation-basics.h" and 'b_matrix', permutations are referred
+ to by their index inside 'permutations', which is 'permt_rank'. If the binary database 'KL-database<n>.bin' is
+ there when the context is created, it is mapped read only and looked at before anything is computed. New
+ polynomials only go to the memo of the context, they are not logged and not written to any database.
+
+ Polynomials are computed by 'k_l_parallel_evaluate' with the context passed to it, without a context it uses the
+ global tables of 'current_sn_group'. Inside a context no task goes to the scheduler, the threads asking for
+ polynomials do the work. 'polynom_k_l' only knows the global tables.
+*/
+
+// type definitions
+
+struct KLContext
+{
+    int n = 0;
+    int max_length = 0;                          // l(w0) = n * (n - 1) / 2
+    std::vector<std::vector<int>> permutations;  // every permutation, in lexiographic order like 'all_p'
+    std::vector<int> lengths;                    // like 'all_p_len'
+    std::vector<unsigned int> right_descents, left_descents;
+    std::vector<std::vector<uint64_t>> descent_bits;  // like 'all_p_descent_bits'
+    std::vector<int> inverse, w0_conjugate;
+    std::vector<std::vector<int>> right_multp, left_multp;
+    std::vector<uint8_t> bruhat;                 // bruhat[u * n! + v] is 1 iff u < v, like 'b_matrix' it is 0 on the diagonal
+    KLStore store;                               // read only, empty if there was no database
+    std::vector<KLStore> segments;               // the other segments of the database, see 'k_l_store_add_segment'
+    mutable KLMemoShard memo[K_L_MEMO_SHARDS];   // polynomials of representatives computed inside this context
+
+    ~KLContext(){
+        k_l_store_unmap(store);
+        for(auto itr = segments.begin(); itr != segments.end(); itr++) k_l_store_unmap(*itr);
+    }
+};
+
+// function declarations
+
+std::shared_ptr<const KLContext> k_l_context_create(int n, std::string matrix_file = "bruhat-matrix", std::string file_name = database_name);
+
+/* True iff u < v with respect to bruhat order, u and v are indexes */
+inline bool k_l_context_below(const KLContext& context, int u_index, int v_index){
+    return context.bruhat[(size_t)u_index * context.permutations.size() + v_index] != 0;
+}
+
+int k_l_context_index(const KLContext& context, const std::vector<int>& permt);
+
+std::pair<int, int> k_l_context_canonical(const KLContext& context, int u_index, int v_index);
+
+uint32_t k_l_context_stored_id(const KLContext& context, int u_index, int v_index);
+
+int k_l_context_interval_descents(const KLContext& context, int u_index, int v_index, int i, int* result);
+
+Polynomial k_l_context_evaluate(const KLContext& context, int u_index, int v_index);
+
+bool k_l_context_polynomial(const KLContext& context, const std::vector<int>& u, const std::vector<int>& v, Polynomial& result);
+
+size_t k_l_context_memo_size(const KLContext& context);
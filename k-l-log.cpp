@@ -0,0 +1,527 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "k-l-log.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <chrono>
+#include <atomic>
+#include <filesystem>
+#include <sys/file.h>
+
+using namespace std;
+
+/* GLOBAL VARIABLES --------------- */
+
+uint64_t k_l_log_records = 0;
+atomic<uint64_t> k_l_log_spills(0);
+
+static int log_fd = -1;
+static string log_path;                // the file behind 'log_fd'
+static atomic<bool> log_opened(false);
+static string log_base_name;           // the 'file_name' given to 'k_l_log_open'
+static mutex log_lock;                 // guards the file descriptor, 'k_l_log_records' and the sync time
+static chrono::steady_clock::time_point last_sync;
+static bool sync_pending = false;
+
+// the ring between 'k_l_log_append' and the writer thread, with the spill buffers of the records that did not fit into it
+static KLLogCell log_ring[K_L_LOG_QUEUE_SIZE];
+static atomic<uint64_t> ring_head(0);  // next position for the producers
+static uint64_t ring_tail = 0;         // next position for the writer, only the writer thread uses this
+static mutex spills_lock;              // guards 'spills', not the buffers inside
+static vector<shared_ptr<KLLogSpill>> spills;
+static thread_local shared_ptr<KLLogSpill> thread_spill;
+
+static thread writer_thread;
+static atomic<bool> writer_stop(false);
+static atomic<uint64_t> records_queued(0), records_written(0);
+static mutex writer_lock;
+static condition_variable writer_wake, writer_progress;
+
+static mutex compaction_lock;          // guards the variables below
+static thread compaction_thread;
+static bool compaction_running = false; // a compaction was started and its result is not mapped yet
+static atomic<bool> compaction_done(false);
+static bool compaction_result = false;  // false if any compaction since the last mapping failed
+
+/*--------------------------------- */
+
+// "KL-database" becomes "KL-database<number>.log", the number comes from 'current_sn_group'
+// In a sharded database every run has its own log, "KL-database<number>.run<run>.log"
+string k_l_log_file_name(string file_name){
+    ostringstream s; s << file_name << current_sn_group;
+    if(k_l_shard_run >= 0) s << ".run" << k_l_shard_run;
+    s << ".log";
+    return s.str();
+}
+
+/* The usual CRC-32 (the one used by zlib), pass the previous result as 'crc' to continue a checksum */
+uint32_t k_l_log_crc32(const void* data, size_t size, uint32_t crc){
+    static uint32_t table[256] = {0};
+    static once_flag table_ready;
+    call_once(table_ready, []{
+        for(uint32_t i = 0; i < 256; i++){
+            uint32_t c = i;
+            for(int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+    });
+    const unsigned char* bytes = (const unsigned char*)data;
+    crc = ~crc;
+    for(size_t i = 0; i < size; i++) crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+/*
+ Reads every valid record of the log at 'path' into 'records', keys are (u_index << 32) | v_index as in the
+ binary database. 'valid_size' is set to the size of the part that is fine, it is 0 if the header is broken.
+ Returns false if the file can not be read.
+*/
+bool k_l_log_read(string path, vector<pair<uint64_t, Polynomial>>& records, size_t& valid_size){
+    valid_size = 0;
+    FILE* ifp = fopen(path.c_str(), "rb");
+    if(ifp == NULL) return false;
+    vector<char> data; char buffer[1 << 16]; size_t amount;
+    while((amount = fread(buffer, 1, sizeof(buffer), ifp)) > 0) data.insert(data.end(), buffer, buffer + amount);
+    fclose(ifp);
+
+    size_t header_size = 8 + sizeof(uint32_t);
+    if(data.size() < header_size || memcmp(data.data(), K_L_LOG_MAGIC, 8) != 0) return true;
+    uint32_t n; memcpy(&n, data.data() + 8, sizeof(n));
+    if(n != current_sn_group) return true;
+
+    size_t position = header_size;
+    valid_size = position;
+    while(position + 3 * sizeof(uint32_t) <= data.size()){
+        uint32_t fields[3]; memcpy(fields, data.data() + position, sizeof(fields));
+        size_t record_size = (3 + 2 * (size_t)fields[2] + 1) * sizeof(uint32_t);
+        if(position + record_size > data.size()) break;
+        uint32_t crc; memcpy(&crc, data.data() + position + record_size - sizeof(uint32_t), sizeof(crc));
+        if(crc != k_l_log_crc32(data.data() + position, record_size - sizeof(uint32_t))) break;
+
+        Polynomial temp_poly;
+        const char* terms = data.data() + position + sizeof(fields);
+        for(uint32_t k = 0; k < fields[2]; k++){
+            int32_t term[2]; memcpy(term, terms + 2 * k * sizeof(int32_t), sizeof(term));
+            temp_poly.coefficients[term[0]] = term[1];
+        }
+        records.push_back({((uint64_t)fields[0] << 32) | fields[1], temp_poly});
+        position += record_size;
+        valid_size = position;
+    }
+    return true;
+}
+
+/*
+ Opens the log at 'path' for appending, creating it if there is none. Other processes may append to the same
+ log, so a new log is written with its header under a temporary name and linked to 'path' in one step.
+*/
+static int log_open_file(string path){
+    int fd = open(path.c_str(), O_WRONLY | O_APPEND);
+    if(fd != -1) return fd;
+    string temp_path = path + ".tmp" + to_string(getpid());
+    int temp_fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(temp_fd == -1) return -1;
+    uint32_t n = current_sn_group;
+    bool written = write(temp_fd, K_L_LOG_MAGIC, 8) == 8 && write(temp_fd, &n, sizeof(n)) == sizeof(n);
+    close(temp_fd);
+    if(written) link(temp_path.c_str(), path.c_str()); /* fails if another process was faster, that is fine */
+    unlink(temp_path.c_str());
+    return open(path.c_str(), O_WRONLY | O_APPEND);
+}
+
+/*
+ Writes the log at 'path' into the binary database as a new segment, or into the shard files of this run if the
+ database is sharded, without mapping the result. Only the records of the log are written, older segments are
+ rewritten only when the new one grows to their size, see 'k_l_store_add_segment'. Processes sharing an unsharded
+ database take turns with a lock on 'KL-database<number>.bin.lock', and each one adds to the segments that are on
+ the disk at that moment, so nothing written by the others is lost.
+ This does not have a meaning on its own, compaction uses it.
+*/
+static bool log_merge_file(string path){
+    int lock_fd = -1;
+    if(k_l_shard_run < 0){
+        lock_fd = open((k_l_store_file_name(log_base_name) + ".lock").c_str(), O_RDWR | O_CREAT, 0644);
+        if(lock_fd != -1) flock(lock_fd, LOCK_EX);
+    }
+    auto unlock = [lock_fd]{ if(lock_fd != -1){ flock(lock_fd, LOCK_UN); close(lock_fd); } };
+
+    vector<pair<uint64_t, Polynomial>> records; size_t valid_size;
+    // another process may have merged this file already while this one was waiting for the lock
+    if(access(path.c_str(), F_OK) != 0){ unlock(); return true; }
+    if(!k_l_log_read(path, records, valid_size)){ unlock(); return false; }
+    vector<pair<uint64_t, uint32_t>> entries;
+    for(auto itr = records.begin(); itr != records.end(); itr++){
+        entries.push_back({itr->first, polynom_pool_intern(itr->second)});
+    }
+    bool result;
+    if(k_l_shard_run >= 0) result = k_l_shards_write_run(entries, log_base_name);
+    else result = k_l_store_add_segment(k_l_store_file_name(log_base_name), entries);
+    if(result) remove(path.c_str());
+    unlock();
+    return result;
+}
+
+/* Puts every valid record of the log at 'path' into 'temp_database', so they are not computed again.
+ * A broken tail, left by a crash in the middle of a write, is cut off. Returns the amount of records.
+ * Other processes appending to the same log are waited for, they hold a shared flock while writing. */
+int k_l_log_replay(string path){
+    vector<pair<uint64_t, Polynomial>> records; size_t valid_size;
+    int fd = open(path.c_str(), O_RDWR);
+    if(fd == -1) return 0;
+    flock(fd, LOCK_EX);
+    bool readable = k_l_log_read(path, records, valid_size);
+    if(readable && ftruncate(fd, valid_size) != 0) printf("  Could not repair the K-L log %s\n", path.c_str());
+    flock(fd, LOCK_UN); close(fd);
+    if(!readable) return 0;
+    for(auto itr = records.begin(); itr != records.end(); itr++){
+        int u_index = itr->first >> 32, v_index = itr->first & 0xFFFFFFFF;
+        if(k_l_store_lookup_id(u_index, v_index) != 0) continue;
+        temp_database_append({u_index, v_index}, itr->second, false);
+    }
+    return records.size();
+}
+
+/*
+ Opens the log of the group in 'current_sn_group' for appending, the binary database should be opened before.
+ Records left by an earlier run are replayed into 'temp_database' first. If an earlier run crashed during
+ a compaction, that compaction is done here again. Several processes may use the same log at once.
+*/
+void k_l_log_open(string file_name){
+    k_l_log_close();
+    log_base_name = file_name;
+    string path = k_l_log_file_name(file_name);
+
+    // compactions are named 'KL-database<number>.log.compacting.<process ID>', see 'k_l_log_compact_start'
+    filesystem::path directory = filesystem::path(path).parent_path();
+    string compacting_prefix = filesystem::path(path).filename().string() + ".compacting";
+    error_code error;
+    bool merged = false;
+    for(auto& item : filesystem::directory_iterator(directory.empty() ? "." : directory, error)){
+        if(item.path().filename().string().rfind(compacting_prefix, 0) != 0) continue;
+        k_l_log_replay(item.path().string());
+        merged = log_merge_file(item.path().string()) || merged;
+    }
+    if(merged) k_l_store_open(file_name);
+
+    k_l_log_records = k_l_log_replay(path);
+    if(k_l_log_records > 0) printf("  Recovered %lu polynomials from %s\n", (unsigned long)k_l_log_records, path.c_str());
+
+    log_path = path;
+    log_fd = log_open_file(path);
+    if(log_fd == -1){ printf("  Could not open the K-L log %s\n", path.c_str()); return; }
+    last_sync = chrono::steady_clock::now(); sync_pending = false;
+
+    for(uint64_t k = 0; k < K_L_LOG_QUEUE_SIZE; k++) log_ring[k].sequence.store(k);
+    ring_head.store(0); ring_tail = 0;
+    records_queued.store(0); records_written.store(0);
+    writer_stop.store(false);
+    writer_thread = thread(k_l_log_writer_function);
+    log_opened.store(true);
+
+    // the writer thread has to be stopped before the program ends, otherwise queued records would be lost
+    static once_flag exit_handler;
+    call_once(exit_handler, []{ atexit(k_l_log_close); });
+}
+
+/* True between 'k_l_log_open' and 'k_l_log_close', if the log file could be opened */
+bool k_l_log_is_open(void){
+    return log_opened.load();
+}
+
+/*
+ Closes the log, every record that was appended before is written and synced to the disk first, and a
+ running compaction is waited for. No thread should be appending while this runs.
+*/
+void k_l_log_close(void){
+    if(log_opened.exchange(false)){
+        writer_stop.store(true); writer_wake.notify_one();
+        writer_thread.join();
+    }
+    k_l_log_compact_finish(true);
+    lock_guard<mutex> guard(log_lock);
+    if(log_fd == -1) return;
+    fdatasync(log_fd); close(log_fd);
+    log_fd = -1; k_l_log_records = 0; log_path.clear();
+}
+
+// Copies the record into the ring, returns false if the ring is full. Any amount of threads may call this at once.
+static bool ring_push(const uint32_t* record, uint32_t size){
+    uint64_t position = ring_head.load(memory_order_relaxed);
+    while(true){
+        KLLogCell& cell = log_ring[position % K_L_LOG_QUEUE_SIZE];
+        int64_t difference = (int64_t)cell.sequence.load(memory_order_acquire) - (int64_t)position;
+        if(difference == 0){
+            if(ring_head.compare_exchange_weak(position, position + 1, memory_order_relaxed)){
+                memcpy(cell.record, record, size * sizeof(uint32_t)); cell.size = size;
+                cell.sequence.store(position + 1, memory_order_release);
+                return true;
+            }
+        }
+        else if(difference < 0) return false; /* the writer did not take this slot out yet */
+        else position = ring_head.load(memory_order_relaxed);
+    }
+}
+
+// Appends the next record of the ring to 'batch', returns false if there is none. Only the writer thread calls this.
+static bool ring_pop(vector<uint32_t>& batch){
+    KLLogCell& cell = log_ring[ring_tail % K_L_LOG_QUEUE_SIZE];
+    if(cell.sequence.load(memory_order_acquire) != ring_tail + 1) return false;
+    batch.insert(batch.end(), cell.record, cell.record + cell.size);
+    cell.sequence.store(ring_tail + K_L_LOG_QUEUE_SIZE, memory_order_release);
+    ring_tail++;
+    return true;
+}
+
+// The spill buffer of the calling thread, registered for the writer the first time
+static KLLogSpill& spill_of_thread(void){
+    if(!thread_spill){
+        thread_spill = make_shared<KLLogSpill>();
+        lock_guard<mutex> guard(spills_lock);
+        spills.push_back(thread_spill);
+    }
+    return *thread_spill;
+}
+
+/*
+ Appends P(u, v) to the log, pairs that are already inside the binary database are not written again.
+ The record is built on the stack and copied into a slot of a ring of K_L_LOG_QUEUE_SIZE without taking any lock,
+ the writer thread writes it to the file soon after. If the ring is full, or the record does not fit into a slot,
+ it goes to the spill buffer of the calling thread, whose lock is only shared with the writer. Nothing waits for
+ the disk and nothing is dropped, see "k-l-log.h".
+ Thread safe, but should not be called while 'k_l_log_close' is running.
+*/
+void k_l_log_append(int u_index, int v_index, const Polynomial& poly){
+    if(!log_opened.load() || k_l_store_lookup_id(u_index, v_index) != 0) return;
+
+    records_queued.fetch_add(1);
+    if(poly.coefficients.size() <= K_L_LOG_SLOT_TERMS){
+        uint32_t record[K_L_LOG_SLOT_WORDS];
+        uint32_t size = 0;
+        record[size++] = u_index; record[size++] = v_index; record[size++] = poly.coefficients.size();
+        for(auto itr = poly.coefficients.begin(); itr != poly.coefficients.end(); itr++){
+            record[size++] = (int32_t)itr->first; record[size++] = (int32_t)itr->second;
+        }
+        record[size] = k_l_log_crc32(record, size * sizeof(uint32_t)); size++;
+        if(ring_push(record, size)){ writer_wake.notify_one(); return; }
+    }
+
+    KLLogSpill& spill = spill_of_thread();
+    {
+        lock_guard<mutex> guard(spill.lock);
+        size_t start = spill.words.size();
+        spill.words.push_back(u_index); spill.words.push_back(v_index); spill.words.push_back(poly.coefficients.size());
+        for(auto itr = poly.coefficients.begin(); itr != poly.coefficients.end(); itr++){
+            spill.words.push_back((int32_t)itr->first); spill.words.push_back((int32_t)itr->second);
+        }
+        spill.words.push_back(k_l_log_crc32(spill.words.data() + start, (spill.words.size() - start) * sizeof(uint32_t)));
+        spill.records++;
+    }
+    k_l_log_spills.fetch_add(1);
+    writer_wake.notify_one();
+}
+
+/*
+ Appends every spilled record to 'batch' and returns their amount, the buffers are swapped out under their own
+ lock so producers are held up only for the swap. Buffers of threads that ended are dropped once empty.
+ Only the writer thread calls this.
+*/
+static uint64_t spills_take(vector<uint32_t>& batch){
+    uint64_t amount = 0;
+    vector<uint32_t> words;
+    lock_guard<mutex> guard(spills_lock);
+    for(auto itr = spills.begin(); itr != spills.end(); itr++){
+        uint64_t records;
+        {
+            lock_guard<mutex> spill_guard((*itr)->lock);
+            words.swap((*itr)->words); records = (*itr)->records; (*itr)->records = 0;
+        }
+        batch.insert(batch.end(), words.begin(), words.end()); amount += records;
+        words.clear();
+    }
+    // nothing but this list holds the buffer of a thread that ended, it can not get new records, but it may
+    // have got some after it was swapped out above
+    erase_if(spills, [](const shared_ptr<KLLogSpill>& spill){
+        if(spill.use_count() != 1) return false;
+        lock_guard<mutex> spill_guard(spill->lock);
+        return spill->records == 0;
+    });
+    return amount;
+}
+
+/*
+ Takes a shared flock on the log, which keeps other processes from moving it aside for a compaction while
+ this one writes. If another process compacted it meanwhile, the new log is opened first. Called with
+ 'log_lock' held, the flock should be released after writing.
+*/
+static void log_lock_current(void){
+    while(log_fd != -1){
+        flock(log_fd, LOCK_SH);
+        struct stat file_info, path_info;
+        if(fstat(log_fd, &file_info) == 0 && stat(log_path.c_str(), &path_info) == 0
+           && file_info.st_ino == path_info.st_ino && file_info.st_dev == path_info.st_dev) return;
+        flock(log_fd, LOCK_UN); close(log_fd);
+        log_fd = log_open_file(log_path);
+        k_l_log_records = 0;
+    }
+}
+
+/*
+ This function does not have a meaning on its own, it is the writer thread started by 'k_l_log_open'.
+ Every round it writes whatever is waiting with a single write call, syncs the file every K_L_LOG_SYNC_INTERVAL
+ milliseconds and starts a compaction once the log is long enough. When asked to stop, it writes everything
+ that is left before returning.
+*/
+void k_l_log_writer_function(void){
+    vector<uint32_t> batch;
+    while(true){
+        bool stopping = writer_stop.load();
+        uint64_t amount = 0;
+        batch.clear();
+        while(ring_pop(batch)) amount++;
+        amount += spills_take(batch);
+
+        bool compaction_needed = false;
+        {
+            lock_guard<mutex> guard(log_lock);
+            const char* data = (const char*)batch.data(); size_t left = batch.size() * sizeof(uint32_t);
+            bool writing = left > 0;
+            if(writing) log_lock_current();
+            while(left > 0 && log_fd != -1){
+                ssize_t done = write(log_fd, data, left);
+                if(done <= 0){ printf("  Could not write the K-L log\n"); break; }
+                data += done; left -= done;
+            }
+            if(writing && log_fd != -1) flock(log_fd, LOCK_UN);
+            if(amount > 0){ k_l_log_records += amount; sync_pending = true; }
+            auto now = chrono::steady_clock::now();
+            if(sync_pending && (stopping || now - last_sync >= chrono::milliseconds(K_L_LOG_SYNC_INTERVAL))){
+                fdatasync(log_fd); last_sync = now; sync_pending = false;
+            }
+            compaction_needed = k_l_log_records >= K_L_LOG_COMPACT_RECORDS;
+        }
+        if(amount > 0){
+            records_written.fetch_add(amount);
+            writer_progress.notify_all();
+        }
+        if(compaction_needed) k_l_log_compact_start();
+
+        if(amount == 0){
+            if(stopping) return;
+            unique_lock<mutex> guard(writer_lock);
+            writer_wake.wait_for(guard, chrono::milliseconds(10));
+        }
+    }
+}
+
+/* Waits until every record appended before this call is written to the file, not necessarily synced */
+void k_l_log_flush(void){
+    if(!log_opened.load()) return;
+    uint64_t target = records_queued.load();
+    writer_wake.notify_one();
+    unique_lock<mutex> guard(writer_lock);
+    while(records_written.load() < target) writer_progress.wait_for(guard, chrono::milliseconds(10));
+}
+
+/* Writes the records appended so far to the disk, without waiting for K_L_LOG_SYNC_INTERVAL */
+void k_l_log_sync(void){
+    k_l_log_flush();
+    lock_guard<mutex> guard(log_lock);
+    if(log_fd == -1 || !sync_pending) return;
+    fdatasync(log_fd); last_sync = chrono::steady_clock::now(); sync_pending = false;
+}
+
+/*
+ Starts merging the log into the binary database on a separate thread, appending continues on a new log
+ meanwhile. Nothing happens if the log is empty or the previous compaction is still running, since the next
+ one has to start from the database that the previous one writes. A previous compaction that is finished but
+ not mapped yet is joined here, the new one merges into its result on the disk and 'k_l_log_compact_finish'
+ maps the last one. So runs that rarely reach a point to map the database still keep the log short.
+ The log is moved aside under an exclusive flock, so writes of other processes to it are either finished
+ before or go to the new log, see 'log_lock_current'.
+*/
+void k_l_log_compact_start(void){
+    lock_guard<mutex> compaction_guard(compaction_lock);
+    if(compaction_running){
+        // a failed compaction leaves its file behind, it is reported by 'k_l_log_compact_finish' first
+        if(!compaction_done.load() || !compaction_result) return;
+        if(compaction_thread.joinable()) compaction_thread.join();
+    }
+
+    string path = log_path, compacting_path = path + ".compacting." + to_string(getpid());
+    {
+        lock_guard<mutex> guard(log_lock);
+        if(log_fd == -1 || k_l_log_records == 0) return;
+        flock(log_fd, LOCK_EX);
+        struct stat file_info, path_info;
+        bool current = fstat(log_fd, &file_info) == 0 && stat(path.c_str(), &path_info) == 0
+                       && file_info.st_ino == path_info.st_ino && file_info.st_dev == path_info.st_dev;
+        // if another process moved the log aside already, its compaction takes these records as well
+        if(!current || rename(path.c_str(), compacting_path.c_str()) != 0){
+            flock(log_fd, LOCK_UN);
+            if(!current){ close(log_fd); log_fd = log_open_file(path); k_l_log_records = 0; }
+            return;
+        }
+        fdatasync(log_fd); flock(log_fd, LOCK_UN); close(log_fd);
+        log_fd = log_open_file(path);
+        if(log_fd == -1) printf("  Could not open the K-L log %s\n", path.c_str());
+        k_l_log_records = 0; last_sync = chrono::steady_clock::now(); sync_pending = false;
+    }
+
+    compaction_running = true; compaction_done.store(false);
+    compaction_thread = thread([compacting_path]{
+        compaction_result = log_merge_file(compacting_path);
+        compaction_done.store(true);
+    });
+}
+
+/*
+ Maps the binary database written by the last compaction, returns true if that was successful. If 'wait' is
+ false and the compaction is still running, this returns false right away. Call this only when no other
+ thread is reading from the binary database, the old mapping is removed.
+*/
+bool k_l_log_compact_finish(bool wait){
+    lock_guard<mutex> compaction_guard(compaction_lock);
+    if(!compaction_running) return false;
+    if(!wait && !compaction_done.load()) return false;
+    if(compaction_thread.joinable()) compaction_thread.join();
+    compaction_running = false;
+    if(compaction_result) k_l_store_open(log_base_name);
+    else printf("  Could not write the K-L database of S_%d\n", current_sn_group);
+    return compaction_result;
+}
+
+/* True if a compaction is finished and waits for 'k_l_log_compact_finish' to map its result */
+bool k_l_log_compact_ready(void){
+    lock_guard<mutex> compaction_guard(compaction_lock);
+    return compaction_running && compaction_done.load();
+}
+
+/* Merges the whole log into the binary database and maps the result, waiting until it is done.
+ * Every record appended before the call is inside the database afterwards, or inside a compaction that
+ * another process sharing the log is doing at that moment. */
+void k_l_log_compact(void){
+    k_l_log_flush();
+    k_l_log_compact_finish(true);
+    k_l_log_compact_start();
+    // other processes may have merged their records, and ours, into the database meanwhile
+    if(!k_l_log_compact_finish(true) && log_opened.load()) k_l_store_open(log_base_name);
+}
@@ -0,0 +1,143 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef K_L_LOG
+#define K_L_LOG
+/*--------------------------------*/
+#ifndef K_L_STORE
+#include "k-l-store.h"
+#endif // !K_L_STORE
+/*--------------------------------*/
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#endif // !K_L_LOG
+
+#define K_L_LOG_MAGIC "KLLOG001"
+
+/* The log is written to the disk with fsync at most this many milliseconds after a record is appended */
+#define K_L_LOG_SYNC_INTERVAL 1000
+
+/* Size of the ring between the threads computing polynomials and the writer thread, should be a power of 2 */
+#define K_L_LOG_QUEUE_SIZE 4096
+
+/* Terms that fit into a slot of the ring. P(u, v) has degree at most (l(v) - l(u) - 1) / 2, which is 22 in S_10. */
+#define K_L_LOG_SLOT_TERMS 32
+
+/* uint32_t words of a record with K_L_LOG_SLOT_TERMS terms, see the layout below */
+#define K_L_LOG_SLOT_WORDS (3 + 2 * K_L_LOG_SLOT_TERMS + 1)
+
+/* Once this many records are appended, the log is compacted into the binary database in the background */
+#define K_L_LOG_COMPACT_RECORDS 65536
+
+/*
+ Every polynomial is appended to 'KL-database<number>.log' as soon as it is computed, so a crash only loses
+ the records that were not written yet. Threads computing polynomials only copy the record into a preallocated
+ slot of a ring, the writer thread takes them out in batches and writes them, so computation does not wait on
+ the disk and nothing is allocated for a record.
+
+ When the ring is full, or a record has more than K_L_LOG_SLOT_TERMS terms, it goes to a spill buffer of the
+ calling thread instead, which the writer empties on its next round. The buffer has a lock that only the writer
+ takes besides its thread, and only to swap it with an empty one. Producers never wait for the disk: a disk that
+ is slower than the computation lets the spill buffers grow until the writer catches up, memory is the only
+ limit then, see 'k_l_log_spills'. Nothing is ever dropped.
+
+ The file starts with K_L_LOG_MAGIC and the group number as uint32_t, followed by records:
+         uint32_t u_index, uint32_t v_index, uint32_t term_amount,
+         term_amount pairs of int32_t power and int32_t coefficient, uint32_t crc32 of everything before it
+ A record that is cut short or has a wrong checksum ends the log, everything after it is ignored.
+
+ Compaction moves the log aside to 'KL-database<number>.log.compacting.<process ID>', starts a new log and
+ merges the old one into 'KL-database<number>.bin' dropping duplicates, see "k-l-store.h". The new binary
+ database is only mapped by 'k_l_log_compact_finish', because other threads may be reading from the old mapping.
+ That is done at the points where nothing is computed, see 'k_l_memory_checkpoint'. Until then the next
+ compaction starts from the finished one on the disk, so the log is compacted in runs that map rarely as well.
+
+ Processes sharing an unsharded database append to the same log. Each write is done under a shared flock of
+ the log and compaction moves it aside under an exclusive one, merges into the binary database are done one
+ process at a time, see 'log_merge_file'.
+*/
+
+// type definitions
+
+/*
+ A slot of the ring used by 'k_l_log_append', the ring is the bounded queue of Dmitry Vyukov. A producer may
+ fill the slot at position p when 'sequence' is p, the writer may take it when 'sequence' is p + 1.
+ 'size' is the amount of words of 'record' that are used.
+*/
+struct KLLogCell
+{
+    std::atomic<uint64_t> sequence;
+    uint32_t size;
+    uint32_t record[K_L_LOG_SLOT_WORDS];
+};
+
+/* Records of one thread that did not go into the ring, see 'k_l_log_append' */
+struct KLLogSpill
+{
+    std::mutex lock;
+    std::vector<uint32_t> words;
+    uint64_t records = 0;
+};
+
+/*--------------------------Global variables, just their declerations-----------------------*/
+
+/* Amount of records inside the current log file, replayed ones included */
+extern uint64_t k_l_log_records;
+
+/* Amount of records that did not go into the ring and were spilled for the writer, see 'k_l_log_append' */
+extern std::atomic<uint64_t> k_l_log_spills;
+
+/*------------------------------------------------------------------------------------------*/
+
+// function declarations
+
+std::string k_l_log_file_name(std::string file_name = database_name);
+
+uint32_t k_l_log_crc32(const void* data, size_t size, uint32_t crc = 0);
+
+void k_l_log_open(std::string file_name = database_name);
+
+void k_l_log_close(void);
+
+bool k_l_log_is_open(void);
+
+bool k_l_log_read(std::string path, std::vector<std::pair<uint64_t, Polynomial>>& records, size_t& valid_size);
+
+int k_l_log_replay(std::string path);
+
+void k_l_log_append(int u_index, int v_index, const Polynomial& poly);
+
+void k_l_log_writer_function(void);
+
+void k_l_log_flush(void);
+
+void k_l_log_sync(void);
+
+void k_l_log_compact_start(void);
+
+bool k_l_log_compact_finish(bool wait = true);
+
+bool k_l_log_compact_ready(void);
+
+void k_l_log_compact(void);
@@ -0,0 +1,221 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "k-l-memory.h"
+#include "k-l-parallel.h"
+#include <cstdlib>
+#include <cctype>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+using namespace std;
+
+/* GLOBAL VARIABLES --------------- */
+
+uint64_t k_l_memory_budget = 0;
+atomic<uint64_t> k_l_memory_evicted_entries(0);
+atomic<uint64_t> k_l_memory_evicted_bytes(0);
+
+/*--------------------------------- */
+
+/* True once the warning about a budget that can not be kept is printed, it is printed once */
+static bool budget_warned = false;
+
+static const char* cache_names[K_L_MEMORY_CACHE_AMOUNT] = {
+    "b_matrix", "permutations", "k_l_database", "temp_database", "polynom_pool", "memo", "greek_mu", "bruhat_data"
+};
+
+const char* k_l_memory_cache_name(int cache){
+    return cache_names[cache];
+}
+
+template <typename T>
+static uint64_t vector_bytes(const vector<T>& vec){
+    return vec.capacity() * sizeof(T);
+}
+
+// for a vector of rows, like 'k_l_database'
+template <typename T>
+static uint64_t table_bytes(const vector<vector<T>>& table){
+    uint64_t bytes = vector_bytes(table);
+    for(auto itr = table.begin(); itr != table.end(); itr++) bytes += vector_bytes(*itr);
+    return bytes;
+}
+
+static uint64_t permutation_map_bytes(const map<vector<int>, PermtData>& permutations){
+    return permutations.size() * (K_L_MEMORY_NODE_BYTES + sizeof(vector<int>) + sizeof(PermtData) + current_sn_group * sizeof(int));
+}
+
+/*
+ Reads a size like "6G", "512M", "64K" or "1000000" into 'bytes', the suffixes are powers of 1024 and may be
+ followed by "B" or "iB". Returns false if the text is not a size.
+*/
+bool k_l_memory_parse_size(string text, uint64_t& bytes){
+    char* end;
+    double amount = strtod(text.c_str(), &end);
+    if(end == text.c_str() || amount < 0) return false;
+    string suffix(end);
+    for(auto itr = suffix.begin(); itr != suffix.end(); itr++) *itr = toupper(*itr);
+    double unit = 1;
+    if(!suffix.empty()){
+        size_t position = string("KMGT").find(suffix[0]);
+        if(position != string::npos){
+            for(size_t k = 0; k <= position; k++) unit *= 1024;
+            suffix.erase(0, 1);
+        }
+    }
+    if(suffix != "" && suffix != "B" && suffix != "IB") return false;
+    bytes = (uint64_t)(amount * unit);
+    return true;
+}
+
+/* Takes the budget from the environment variable K_L_MEMORY_BUDGET, see "k-l-memory.h" */
+void k_l_memory_budget_initiate(void){
+    const char* text = getenv("K_L_MEMORY_BUDGET");
+    if(text == NULL) return;
+    if(!k_l_memory_parse_size(text, k_l_memory_budget)){
+        fprintf(stderr, "  K_L_MEMORY_BUDGET=%s is not a size, there is no memory budget\n", text);
+        k_l_memory_budget = 0;
+    }
+}
+
+/* Estimated bytes of every cache, indexed by KLMemoryCache. Thread safe, but sizes may change while it runs */
+void k_l_memory_usage(uint64_t bytes[K_L_MEMORY_CACHE_AMOUNT]){
+    uint64_t f_n = all_p.size();
+    bytes[K_L_MEMORY_B_MATRIX] = b_matrix != NULL ? f_n * (f_n * sizeof(int) + sizeof(int*)) : 0;
+
+    bytes[K_L_MEMORY_PERMUTATIONS] = table_bytes(all_p) + vector_bytes(all_p_len) + permutation_map_bytes(all_p_data)
+                                   + vector_bytes(all_p_right_descents) + vector_bytes(all_p_left_descents) + table_bytes(all_p_descent_bits)
+                                   + vector_bytes(all_p_inverse) + vector_bytes(all_p_w0_conjugate)
+                                   + table_bytes(all_p_right_multp) + table_bytes(all_p_left_multp);
+
+    bytes[K_L_MEMORY_DATABASE] = table_bytes(k_l_database);
+    bytes[K_L_MEMORY_TEMP_DATABASE] = table_bytes(temp_database);
+
+    // every polynomial is kept twice, once in the pool and once as the key of its ID
+    uint64_t pool_bytes = 0;
+    uint32_t pool_size = polynom_pool_size();
+    for(uint32_t id = 1; id < pool_size; id++){
+        pool_bytes += 2 * (sizeof(Polynomial) + k_l_memory_polynomial_bytes(polynom_pool_at(id))) + K_L_MEMORY_NODE_BYTES;
+    }
+    bytes[K_L_MEMORY_POOL] = pool_bytes;
+
+    bytes[K_L_MEMORY_MEMO] = k_l_memo_bytes.load();
+
+    // a row of 'greek_mu_rows' has 2 bits for every u, see "greek-mu.h"
+    uint64_t mu_bytes = (uint64_t)greek_mu_row_size * sizeof(greek_mu_rows[0]);
+    for(int v_index = 0; v_index < greek_mu_row_size; v_index++){
+        if(greek_mu_rows[v_index].load(memory_order_relaxed) != NULL) mu_bytes += (greek_mu_row_size + 31) / 32 * sizeof(uint64_t);
+    }
+    for(int i = 0; i < GREEK_MU_SHARDS; i++){
+        lock_guard<mutex> guard(greek_mu_edges[i].lock);
+        mu_bytes += greek_mu_edges[i].edges.size() * (K_L_MEMORY_NODE_BYTES + sizeof(uint64_t) + sizeof(int));
+    }
+    bytes[K_L_MEMORY_GREEK_MU] = mu_bytes;
+
+    uint64_t vertices = boost::num_vertices(bruhat_data.first);
+    bytes[K_L_MEMORY_BRUHAT_DATA] = permutation_map_bytes(bruhat_data.second)
+                                  + vertices * (sizeof(PermtVertex) + current_sn_group * sizeof(int) + sizeof(vector<int>))
+                                  + boost::num_edges(bruhat_data.first) * 2 * sizeof(uint64_t);
+}
+
+uint64_t k_l_memory_total(void){
+    uint64_t bytes[K_L_MEMORY_CACHE_AMOUNT], total = 0;
+    k_l_memory_usage(bytes);
+    for(int k = 0; k < K_L_MEMORY_CACHE_AMOUNT; k++) total += bytes[k];
+    return total;
+}
+
+/*
+ True if the caches take more than the budget and enough of it can be evicted. At least 1 / K_L_MEMORY_MIN_EVICTION
+ of the budget has to be evictable, otherwise tables that are never evicted could keep the total over the budget
+ and every checkpoint would compact the log for a few bytes.
+*/
+bool k_l_memory_over_budget(void){
+    if(k_l_memory_budget == 0) return false;
+    uint64_t bytes[K_L_MEMORY_CACHE_AMOUNT], total = 0;
+    k_l_memory_usage(bytes);
+    for(int k = 0; k < K_L_MEMORY_CACHE_AMOUNT; k++) total += bytes[k];
+    uint64_t evictable = bytes[K_L_MEMORY_TEMP_DATABASE] + bytes[K_L_MEMORY_MEMO];
+    return total > k_l_memory_budget && evictable >= k_l_memory_budget / K_L_MEMORY_MIN_EVICTION;
+}
+
+/*
+ Evicts 'temp_database' and the memo until the total is K_L_MEMORY_LOW_WATERMARK percent of the budget, in the
+ order given in "k-l-memory.h". Returns the bytes freed. Only call this when no computation is running.
+*/
+uint64_t k_l_memory_enforce(void){
+    if(k_l_memory_budget == 0) return 0;
+    uint64_t total = k_l_memory_total(), target = k_l_memory_budget / 100 * K_L_MEMORY_LOW_WATERMARK;
+    if(total <= k_l_memory_budget) return 0;
+
+    // spilling to the disk, what is evicted from now on is found in the binary database
+    uint64_t freed = 0;
+    if(k_l_log_is_open() && k_l_log_records > 0){
+        k_l_database_append();
+        uint64_t spilled = k_l_memory_total();
+        freed += total > spilled ? total - spilled : 0;
+        total = spilled;
+    }
+    if(total > target){
+        uint64_t evicted = k_l_memo_evict(total - target);
+        freed += evicted; total -= min(evicted, total);
+    }
+#ifdef __GLIBC__
+    // freed nodes are given back to the system, otherwise the process would not get any smaller
+    malloc_trim(0);
+#endif
+
+    if(total > k_l_memory_budget && !budget_warned){
+        budget_warned = true;
+        fprintf(stderr, "  The memory budget of %.1f MiB can not be kept, %.1f MiB is taken by tables that are not evicted\n",
+                k_l_memory_budget / 1048576.0, total / 1048576.0);
+    }
+    return freed;
+}
+
+/*
+ Enforces the budget if the caches are over it, call it at points where nothing is being computed and no
+ other thread submits tasks. Tasks of the scheduler that are left from finished computations are run first.
+ A compaction of the log that finished in the background is mapped here too, since this is such a point.
+ Returns true if anything was evicted.
+*/
+bool k_l_memory_checkpoint(void){
+    bool over_budget = k_l_memory_over_budget();
+    if(!over_budget && !k_l_log_compact_ready()) return false;
+    k_l_scheduler_drain();
+    k_l_log_compact_finish(false);
+    return over_budget && k_l_memory_enforce() > 0;
+}
+
+/* Writes the bytes of every cache, the total, the budget and the evictions so far */
+void k_l_memory_report(FILE* ofp){
+    uint64_t bytes[K_L_MEMORY_CACHE_AMOUNT], total = 0;
+    k_l_memory_usage(bytes);
+    for(int k = 0; k < K_L_MEMORY_CACHE_AMOUNT; k++){
+        total += bytes[k];
+        fprintf(ofp, "  %-14s %10.1f MiB\n", cache_names[k], bytes[k] / 1048576.0);
+    }
+    fprintf(ofp, "  %-14s %10.1f MiB", "total", total / 1048576.0);
+    if(k_l_memory_budget > 0) fprintf(ofp, " of a budget of %.1f MiB", k_l_memory_budget / 1048576.0);
+    fprintf(ofp, ", %llu memo entries (%.1f MiB) evicted\n", (unsigned long long)k_l_memory_evicted_entries.load(),
+            k_l_memory_evicted_bytes.load() / 1048576.0);
+}
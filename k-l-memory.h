@@ -0,0 +1,112 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef K_L_MEMORY
+#define K_L_MEMORY
+/*--------------------------------*/
+#ifndef POLYNOMIALS
+#include "polynomials.h"
+#endif // !POLYNOMIALS
+/*--------------------------------*/
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+#include <string>
+#endif // !K_L_MEMORY
+
+/* Estimated bytes of one node of std::map or std::unordered_map next to the value it holds, for glibc on 64 bits */
+#define K_L_MEMORY_NODE_BYTES 48
+
+/* Once over the budget, caches are evicted until they take at most this percent of it */
+#define K_L_MEMORY_LOW_WATERMARK 75
+
+/* The budget is only enforced when at least this part of it can be evicted, 16 is 1/16 of it */
+#define K_L_MEMORY_MIN_EVICTION 16
+
+/* Columns (or pairs of a batch) for each thread between two checks of the budget */
+#define K_L_MEMORY_CHECK_COLUMNS 16
+
+/*
+ Accounting of the large structures of a group, with a budget for them. The budget is taken from the
+ environment variable K_L_MEMORY_BUDGET when 'k_l_memory_budget_initiate' is called, in bytes or with one of
+ the suffixes K, M, G ("6G" for example), and 0 or no variable means there is no budget.
+
+ Bytes are estimated from the sizes of the structures, not measured, so they are a little lower than what the
+ process really takes. 'b_matrix', the permutation tables and 'greek_mu_rows' are needed as long as the group is
+ loaded and are never evicted, they only count towards the budget. The memo of 'polynom_k_l_parallel' and
+ 'temp_database' are evicted once the total is over the budget, see 'k_l_memory_enforce':
+   1-) if the log is open, it is compacted into the binary database first, see "k-l-log.h". 'temp_database' is
+       emptied by that, and every polynomial of the memo can be found on the disk afterwards.
+   2-) entries of the memo are dropped, the ones with the shortest interval l(v) - l(u) first. Those have the
+       cheapest recursion, so they are the ones to compute again if they were not on the disk.
+ Eviction only happens at points where nothing is being computed, 'k_l_memory_checkpoint' is called for that by
+ the table and batch modes between groups of columns or pairs, and by the server between queries.
+*/
+
+// type definitions
+
+enum KLMemoryCache
+{
+    K_L_MEMORY_B_MATRIX,        // b_matrix, shared with other processes if "k-l-shm.h" is used
+    K_L_MEMORY_PERMUTATIONS,    // all_p, all_p_len, all_p_data and the index tables of "k-l-symmetry.h"
+    K_L_MEMORY_DATABASE,        // k_l_database
+    K_L_MEMORY_TEMP_DATABASE,   // temp_database
+    K_L_MEMORY_POOL,            // polynom_pool
+    K_L_MEMORY_MEMO,            // k_l_memo, only the entries that are computed
+    K_L_MEMORY_GREEK_MU,        // greek_mu_rows and greek_mu_edges
+    K_L_MEMORY_BRUHAT_DATA,     // bruhat_data
+    K_L_MEMORY_CACHE_AMOUNT
+};
+
+/*--------------------------Global variables, just their declerations-----------------------*/
+
+/* Bytes the caches may take together, 0 if there is no limit */
+extern uint64_t k_l_memory_budget;
+
+/* Amount of memo entries and bytes evicted so far */
+extern std::atomic<uint64_t> k_l_memory_evicted_entries;
+extern std::atomic<uint64_t> k_l_memory_evicted_bytes;
+
+/*------------------------------------------------------------------------------------------*/
+
+// function declarations
+
+/* Estimated bytes of a polynomial, without the Polynomial object itself */
+inline uint64_t k_l_memory_polynomial_bytes(const Polynomial& poly){
+    return poly.coefficients.size() * K_L_MEMORY_NODE_BYTES;
+}
+
+const char* k_l_memory_cache_name(int cache);
+
+bool k_l_memory_parse_size(std::string text, uint64_t& bytes);
+
+void k_l_memory_budget_initiate(void);
+
+void k_l_memory_usage(uint64_t bytes[K_L_MEMORY_CACHE_AMOUNT]);
+
+uint64_t k_l_memory_total(void);
+
+bool k_l_memory_over_budget(void);
+
+uint64_t k_l_memory_enforce(void);
+
+bool k_l_memory_checkpoint(void);
+
+void k_l_memory_report(FILE* ofp);
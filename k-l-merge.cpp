@@ -0,0 +1,190 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ Sharded K-L database tool, see "k-l-store.h" for the files it works on.
+
+     k-l-merge <n> init <shard_amount> [hash|range]
+         makes the database of S_n in the current directory a sharded one, an existing 'KL-database<n>.bin'
+         is split into the shards right away
+
+     k-l-merge <n> merge [directory ...]
+         combines every shard file, log and unsharded database of the current directory and of the given
+         directories into one file per shard 'KL-database<n>.shard<shard>.bin' in the current directory.
+         Pairs found more than once are kept once, pairs with different polynomials are reported.
+         Files of the current directory that were merged are removed, other directories are left as they are.
+         Processes using the current directory should be stopped first.
+*/
+
+#include "k-l-log.h"
+#include <filesystem>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <set>
+#include <numeric>
+
+using namespace std;
+
+// Every file of the database of the current group inside 'directory' that holds polynomials
+static void merge_sources(string directory, vector<string>& stores, vector<string>& logs){
+    string prefix = database_name + to_string(current_sn_group) + ".";
+    auto full_path = [&directory](string file){ return directory == "." ? file : directory + "/" + file; };
+
+    KLShardManifest manifest;
+    if(k_l_shards_read_manifest(manifest, full_path(k_l_shards_manifest_name()))){
+        for(auto itr = manifest.files.begin(); itr != manifest.files.end(); itr++) stores.push_back(full_path(itr->second));
+    }
+    vector<string> segments = k_l_store_segment_names(full_path(k_l_store_file_name()));
+    stores.insert(stores.end(), segments.begin(), segments.end());
+
+    error_code error;
+    for(auto& item : filesystem::directory_iterator(directory, error)){
+        string file = item.path().filename().string();
+        if(file.rfind(prefix, 0) != 0) continue;
+        if(file.ends_with(".log") || file.find(".log.compacting") != string::npos) logs.push_back(full_path(file));
+    }
+}
+
+// Polynomials are compared without their zero coefficients, engines do not agree on keeping those
+static bool same_polynomial(uint32_t id1, uint32_t id2){
+    if(id1 == id2) return true;
+    Polynomial poly1 = polynom_pool_get(id1), poly2 = polynom_pool_get(id2);
+    erase_if(poly1.coefficients, [](const pair<const float, float>& term){ return term.second == 0; });
+    erase_if(poly2.coefficients, [](const pair<const float, float>& term){ return term.second == 0; });
+    return poly1.coefficients == poly2.coefficients;
+}
+
+static int merge(vector<string> directories){
+    KLShardManifest manifest;
+    if(!k_l_shards_read_manifest(manifest, k_l_shards_manifest_name())){
+        printf("There is no manifest for S_%d here, use 'init' first\n", current_sn_group); return 1;
+    }
+
+    // every run of this directory should be stopped, their locks are held until the end so none starts meanwhile
+    vector<int> run_locks;
+    string prefix = database_name + to_string(current_sn_group) + ".run";
+    for(auto& item : filesystem::directory_iterator(".")){
+        string file = item.path().filename().string();
+        if(file.rfind(prefix, 0) != 0 || !file.ends_with(".lock")) continue;
+        int fd = open(file.c_str(), O_RDWR);
+        if(fd == -1) continue;
+        if(flock(fd, LOCK_EX | LOCK_NB) != 0){ printf("%s is held by a running process, stop it first\n", file.c_str()); return 1; }
+        run_locks.push_back(fd);
+    }
+
+    vector<string> stores, logs;
+    merge_sources(".", stores, logs);
+    int local_stores = stores.size(), local_logs = logs.size();
+    for(auto ditr = directories.begin(); ditr != directories.end(); ditr++) merge_sources(*ditr, stores, logs);
+
+    vector<pair<uint64_t, uint32_t>> entries;
+    for(auto itr = stores.begin(); itr != stores.end(); itr++){
+        KLStore store;
+        if(!k_l_store_map(store, *itr)) continue;
+        vector<pair<uint64_t, uint32_t>> temp = k_l_store_all_entries(store);
+        entries.insert(entries.end(), temp.begin(), temp.end());
+        k_l_store_unmap(store);
+        printf("  %-40s %zu pairs\n", itr->c_str(), temp.size());
+    }
+    for(auto itr = logs.begin(); itr != logs.end(); itr++){
+        vector<pair<uint64_t, Polynomial>> records; size_t valid_size;
+        if(!k_l_log_read(*itr, records, valid_size)) continue;
+        for(auto ritr = records.begin(); ritr != records.end(); ritr++) entries.push_back({ritr->first, polynom_pool_intern(ritr->second)});
+        printf("  %-40s %zu pairs\n", itr->c_str(), records.size());
+    }
+
+    // dropping duplicates, the first source wins
+    stable_sort(entries.begin(), entries.end(), [](const pair<uint64_t, uint32_t>& a, const pair<uint64_t, uint32_t>& b){
+        return a.first < b.first;
+    });
+    vector<vector<pair<uint64_t, uint32_t>>> per_shard(manifest.shard_amount);
+    size_t read_amount = entries.size(), conflicts = 0;
+    for(size_t k = 0; k < entries.size(); k++){
+        if(k > 0 && entries[k].first == entries[k - 1].first){
+            if(!same_polynomial(entries[k].second, entries[k - 1].second) && conflicts++ < 10){
+                printf("  conflict at %d:%d\n", (int)(entries[k].first >> 32), (int)(entries[k].first & 0xFFFFFFFF));
+            }
+            continue;
+        }
+        per_shard[k_l_shard_of(entries[k].first & 0xFFFFFFFF, manifest)].push_back(entries[k]);
+    }
+    entries.clear();
+
+    set<string> written;
+    for(int shard = 0; shard < manifest.shard_amount; shard++){
+        if(per_shard[shard].empty()) continue;
+        if(!k_l_store_write(k_l_shard_file_name(shard), per_shard[shard])){
+            printf("Could not write %s, nothing is removed\n", k_l_shard_file_name(shard).c_str()); return 1;
+        }
+        written.insert(k_l_shard_file_name(shard));
+        printf("  shard %d: %zu pairs\n", shard, per_shard[shard].size());
+    }
+
+    // files that other processes added to the manifest while merging are kept
+    set<string> merged(stores.begin(), stores.begin() + local_stores);
+    int lock_fd = open((k_l_shards_manifest_name() + ".lock").c_str(), O_RDWR | O_CREAT, 0644);
+    flock(lock_fd, LOCK_EX);
+    KLShardManifest current;
+    k_l_shards_read_manifest(current, k_l_shards_manifest_name());
+    manifest.files.clear();
+    for(auto itr = written.begin(); itr != written.end(); itr++){
+        int shard = 0; sscanf(itr->c_str() + itr->rfind(".shard") + 6, "%d", &shard);
+        manifest.files.push_back({shard, *itr});
+    }
+    for(auto itr = current.files.begin(); itr != current.files.end(); itr++){
+        if(!merged.count(itr->second) && !written.count(itr->second)) manifest.files.push_back(*itr);
+    }
+    bool manifest_written = k_l_shards_write_manifest(manifest, k_l_shards_manifest_name());
+    flock(lock_fd, LOCK_UN); close(lock_fd);
+    if(!manifest_written){ printf("Could not write the manifest, nothing is removed\n"); return 1; }
+
+    // only the files of the current directory are removed
+    for(int k = 0; k < local_stores; k++) if(!written.count(stores[k])) remove(stores[k].c_str());
+    for(int k = 0; k < local_logs; k++) remove(logs[k].c_str());
+    for(auto itr = run_locks.begin(); itr != run_locks.end(); itr++) close(*itr);
+
+    printf("%zu pairs read, %zu kept, %zu conflicts\n", read_amount,
+           accumulate(per_shard.begin(), per_shard.end(), (size_t)0, [](size_t sum, const vector<pair<uint64_t, uint32_t>>& shard){ return sum + shard.size(); }),
+           conflicts);
+    return conflicts == 0 ? 0 : 2;
+}
+
+int main(int argc, char** argv){
+    if(argc < 3){
+        printf("usage: %s <n> init <shard_amount> [hash|range]\n       %s <n> merge [directory ...]\n", argv[0], argv[0]);
+        return 1;
+    }
+    current_sn_group = atoi(argv[1]);
+    string command = argv[2];
+
+    if(command == "init" && argc >= 4){
+        KLShardManifest manifest;
+        if(k_l_shards_read_manifest(manifest, k_l_shards_manifest_name())){
+            printf("S_%d is already sharded into %d shards\n", current_sn_group, manifest.shard_amount); return 1;
+        }
+        int scheme = (argc >= 5 && string(argv[4]) == "range") ? K_L_SHARDS_RANGE : K_L_SHARDS_HASH;
+        if(atoi(argv[3]) <= 0 || !k_l_shards_create(atoi(argv[3]), scheme)){ printf("Could not write the manifest\n"); return 1; }
+        return merge({});
+    }
+    if(command == "merge") return merge(vector<string>(argv + 3, argv + argc));
+
+    printf("unknown command %s\n", command.c_str());
+    return 1;
+}
@@ -0,0 +1,350 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "k-l-parallel.h"
+#include "k-l-context.h"
+#include <new>
+
+using namespace std;
+
+/* GLOBAL VARIABLES --------------- */
+
+KLMemoShard k_l_memo[K_L_MEMO_SHARDS];
+atomic<uint64_t> k_l_memo_bytes(0);
+
+/*--------------------------------- */
+
+/* The group the memo was filled for, the memo is cleared when 'current_sn_group' changes */
+static int memo_group = -1;
+
+/* Length of v for the frame the current thread is working on, waiting threads only pick up
+ * tasks below this rank, see 'k_l_scheduler_run_one' for the reason */
+static thread_local int frame_rank = INT_MAX;
+
+static uint64_t memo_key(int u_index, int v_index){
+    return ((uint64_t)u_index << 32) | (uint32_t)v_index;
+}
+
+/* Estimated bytes of one computed entry of the memo, together with its node and key */
+static uint64_t memo_entry_bytes(const KLMemoEntry* entry){
+    return sizeof(KLMemoEntry) + K_L_MEMORY_NODE_BYTES + k_l_memory_polynomial_bytes(entry->poly);
+}
+
+/*
+ Returns the memo entry for (u, v) together with a boolean. If the boolean is true, the entry was just
+ created and the calling thread is now responsible for computing it, otherwise somebody else already did
+ (or is doing) the work and the caller should wait until 'ready' is set.
+*/
+pair<KLMemoEntry*, bool> k_l_memo_acquire(int u_index, int v_index){
+    return k_l_memo_acquire(k_l_memo, u_index, v_index);
+}
+
+/* The same for any memo split into K_L_MEMO_SHARDS shards, like the one of a context, see "k-l-context.h" */
+pair<KLMemoEntry*, bool> k_l_memo_acquire(KLMemoShard* memo, int u_index, int v_index){
+    uint64_t key = memo_key(u_index, v_index);
+    KLMemoShard& shard = memo[(key * 0x9E3779B97F4A7C15ULL) >> 58];
+    lock_guard<mutex> guard(shard.lock);
+    auto fitr = shard.entries.find(key);
+    if(fitr != shard.entries.end()) return {fitr->second.get(), false};
+
+    auto entry = make_unique<KLMemoEntry>();
+    entry->ready.store(false); entry->persisted = false;
+    KLMemoEntry* result = entry.get();
+    shard.entries[key] = move(entry);
+    return {result, true};
+}
+
+void k_l_memo_clear(void){
+    for(int i = 0; i < K_L_MEMO_SHARDS; i++){
+        lock_guard<mutex> guard(k_l_memo[i].lock);
+        k_l_memo[i].entries.clear();
+    }
+    k_l_memo_bytes.store(0);
+}
+
+/* Amount of pairs inside the memo, computed or still being computed */
+size_t k_l_memo_size(void){
+    size_t amount = 0;
+    for(int i = 0; i < K_L_MEMO_SHARDS; i++){
+        lock_guard<mutex> guard(k_l_memo[i].lock);
+        amount += k_l_memo[i].entries.size();
+    }
+    return amount;
+}
+
+/*
+ Drops computed entries of the memo until at least 'bytes' are freed, or every computed entry is dropped. Entries
+ with the shortest interval l(v) - l(u) go first, their recursion is the cheapest to do again. Returns the bytes
+ freed, only call this when no computation is running, see 'k_l_memory_checkpoint'.
+*/
+uint64_t k_l_memo_evict(uint64_t bytes){
+    // bytes of the entries for every interval length, then the longest interval that has to go
+    vector<uint64_t> interval_bytes(current_sn_group * (current_sn_group - 1) / 2 + 1, 0);
+    for(int i = 0; i < K_L_MEMO_SHARDS; i++){
+        lock_guard<mutex> guard(k_l_memo[i].lock);
+        for(auto itr = k_l_memo[i].entries.begin(); itr != k_l_memo[i].entries.end(); itr++){
+            if(!itr->second->ready.load()) continue;
+            int interval = all_p_len[itr->first & 0xFFFFFFFF] - all_p_len[itr->first >> 32];
+            interval_bytes[interval] += memo_entry_bytes(itr->second.get());
+        }
+    }
+    int last_interval = 0;
+    uint64_t below = 0;
+    while(last_interval + 1 < interval_bytes.size() && below + interval_bytes[last_interval] < bytes){
+        below += interval_bytes[last_interval++];
+    }
+
+    uint64_t freed = 0, entries = 0;
+    for(int i = 0; i < K_L_MEMO_SHARDS; i++){
+        lock_guard<mutex> guard(k_l_memo[i].lock);
+        for(auto itr = k_l_memo[i].entries.begin(); itr != k_l_memo[i].entries.end();){
+            int interval = all_p_len[itr->first & 0xFFFFFFFF] - all_p_len[itr->first >> 32];
+            // only a part of the last interval is needed, whatever comes first
+            bool evict = itr->second->ready.load() && (interval < last_interval || (interval == last_interval && freed < bytes));
+            if(!evict){ itr++; continue; }
+            freed += memo_entry_bytes(itr->second.get()); entries++;
+            itr = k_l_memo[i].entries.erase(itr);
+        }
+    }
+    k_l_memo_bytes.fetch_sub(min(freed, k_l_memo_bytes.load()));
+    k_l_memory_evicted_entries.fetch_add(entries);
+    k_l_memory_evicted_bytes.fetch_add(freed);
+    return freed;
+}
+
+/* Copies every polynomial computed since the last flush to temp_database, so that 'k_l_database_append'
+ * writes them to the database file. Only call this when no computation is running. */
+void k_l_memo_flush(void){
+    for(int i = 0; i < K_L_MEMO_SHARDS; i++){
+        lock_guard<mutex> guard(k_l_memo[i].lock);
+        for(auto itr = k_l_memo[i].entries.begin(); itr != k_l_memo[i].entries.end(); itr++){
+            KLMemoEntry* entry = itr->second.get();
+            if(!entry->ready.load() || entry->persisted) continue;
+            temp_database_append({(int)(itr->first >> 32), (int)(itr->first & 0xFFFFFFFF)}, entry->poly, false);
+            entry->persisted = true;
+        }
+    }
+}
+
+/* Gets the memo, 'greek_mu_rows' and the index tables ready for the group in 'current_sn_group' and starts the scheduler.
+ * Call this from a single thread before using 'k_l_parallel_evaluate' directly. */
+void k_l_parallel_initiate(int thread_amount){
+    if(memo_group != current_sn_group){
+        k_l_memo_clear(); memo_group = current_sn_group;
+    }
+    if(greek_mu_row_size != all_p.size()) greek_mu_table_initiate();
+    if(!k_l_symmetry_ready()) permt_index_tables_initiate();
+    k_l_scheduler_start(thread_amount);
+}
+
+// l(w) for the index of w, inside the context if there is one and inside 'all_p_len' otherwise
+static inline int length_of(const KLContext* context, int index){
+    return context == NULL ? all_p_len[index] : context->lengths[index];
+}
+
+/* Handles the cases that do not need any recursion: u = v, u and v not comparable, v being the
+ * reverse identity and polynomials that are already inside the database. Returns false otherwise.
+ * The tables and the database are those of 'context', or the global ones if it is NULL. */
+bool k_l_parallel_trivial(int u_index, int v_index, Polynomial& result, const KLContext* context){
+    if(u_index == v_index){ result = {{{0,1}}}; return true; }
+    bool below = context == NULL ? b_matrix[u_index][v_index] != 0 : k_l_context_below(*context, u_index, v_index);
+    if(!below){ result = {{{0,0}}}; return true; }
+    int max_len = context == NULL ? (current_sn_group * (current_sn_group - 1)) / 2 : context->max_length;
+    if(length_of(context, v_index) == max_len){ result = {{{0,1}}}; return true; }
+
+    uint32_t found_id = context == NULL ? k_l_database_check_id(u_index, v_index) : k_l_context_stored_id(*context, u_index, v_index);
+    if(found_id != 0){ result = polynom_pool_at(found_id); return true; }
+    return false;
+}
+
+/*
+ Returns P(u, v) for the permutations with the given indexes. If nobody asked for this pair before, it is
+ computed right here on the calling thread, if another thread is computing it at the moment the calling
+ thread helps with other tasks until the result is published.
+ If 'context' is not NULL, the indexes, the tables, the database and the memo are those of the context,
+ see "k-l-context.h", otherwise the global ones of 'current_sn_group'.
+*/
+Polynomial k_l_parallel_evaluate(int u_index, int v_index, const KLContext* context){
+    Polynomial result;
+    if(k_l_parallel_trivial(u_index, v_index, result, context)) return result;
+
+    // the memo only holds representatives of pairs, see "k-l-symmetry.h"
+    auto canonical = context == NULL ? k_l_symmetry_canonical(u_index, v_index) : k_l_context_canonical(*context, u_index, v_index);
+    if(canonical != make_pair(u_index, v_index)){
+        u_index = canonical.first; v_index = canonical.second;
+        if(k_l_parallel_trivial(u_index, v_index, result, context)) return result;
+    }
+
+    auto acquired = context == NULL ? k_l_memo_acquire(u_index, v_index) : k_l_memo_acquire(context->memo, u_index, v_index);
+    KLMemoEntry* entry = acquired.first;
+    if(acquired.second) k_l_parallel_compute(u_index, v_index, entry, context);
+    else if(!entry->ready.load(memory_order_acquire)){
+        k_l_scheduler_help_until([entry]{ return entry->ready.load(memory_order_acquire); }, frame_rank);
+    }
+    return entry->poly;
+}
+
+/*
+ The same recursion as 'polynom_k_l', but the independent sub-problems of a frame are handed to the
+ scheduler as tasks. This happens in two rounds:
+   1-) P(u*s_i, v*s_i), P(u, v*s_i) and P(z, v*s_i) for every candidate z, the last ones give μ(z, v*s_i)
+   2-) P(u, z) for every z with a nonzero μ(z, v*s_i)
+ After the tasks are submitted the calling thread evaluates the same pairs in order, picking up whatever
+ is not started yet and waiting on the rest. The result is published to 'entry' at the end.
+ Inside a context nothing is handed to the scheduler, which belongs to 'current_sn_group' and may outlive the
+ context, and nothing is logged or shared: the threads of the caller do the work, see "k-l-context.h".
+*/
+void k_l_parallel_compute(int u_index, int v_index, KLMemoEntry* entry, const KLContext* context){
+    int saved_rank = frame_rank;
+    int v_len = length_of(context, v_index);
+    frame_rank = v_len;
+    K_L_STATS_ADD(K_L_STATS_PARALLEL_FRAMES, 1);
+    if(context == NULL) k_l_progress_pair();
+
+    int i, c, us_index, vs_index;
+    if(context == NULL){
+        const vector<int>& u = all_p[u_index];
+        const vector<int>& v = all_p[v_index];
+        // finding the first 'i' where v(i) > v(i + 1)
+        i = permt_first_right_descent(v) - 1; /* -1 is for index*/
+        // the variable 'c' in the definition is set up here
+        if(u[i] > u[i+1]) c = 1;
+        else              c = 0;
+        us_index = permt_right_multp_index(u, u_index, i+1);
+        vs_index = permt_right_multp_index(v, v_index, i+1);
+    }
+    else{
+        i = __builtin_ctz(context->right_descents[v_index]);
+        c = (context->right_descents[u_index] >> i) & 1;
+        us_index = context->right_multp[i][u_index];
+        vs_index = context->right_multp[i][v_index];
+    }
+    int vs_len = length_of(context, vs_index);
+
+    // elements u <= z <= v with a descent at i, that are comparable to v*s_i with an odd length difference
+    // every other z has μ(z, v*s_i) = 0, so they do not contribute anything. If μ(z, v*s_i) is already in
+    // 'greek_mu_rows' it is used directly, the rest become candidates and P(z, v*s_i) is computed for them
+    // the arrays of this frame are scratch memory of the thread, see "k-l-arena.h". Tasks run by this thread
+    // while it waits below open their frames on top of it and close them before returning here
+    KLArenaFrame frame;
+    size_t group_size = context == NULL ? all_p.size() : context->permutations.size();
+    int* z_map = frame.allocate<int>(group_size);
+    int z_amount = context == NULL ? bruhat_matrix_interval_descents(u_index, v_index, i+1, z_map)
+                                   : k_l_context_interval_descents(*context, u_index, v_index, i+1, z_map);
+    frame.shrink<int>(group_size, z_amount);
+    // sub_pairs[0] and sub_pairs[1] are the first two pairs, then P(z, v*s_i) of every candidate z
+    pair<int, int>* sub_pairs = frame.allocate<pair<int, int>>(z_amount + 2);
+    pair<int, float>* mu_nonzero = frame.allocate<pair<int, float>>(z_amount);
+    int candidate_amount = 0, mu_amount = 0;
+    sub_pairs[0] = {us_index, vs_index}; sub_pairs[1] = {u_index, vs_index};
+    K_L_STATS_ADD(K_L_STATS_Z_DESCENTS, z_amount);
+    for(int k = 0; k < z_amount; k++){
+        int z_index = z_map[k];
+        int mu;
+        if(context == NULL && greek_mu_table_lookup(z_index, vs_index, mu)){
+            if(mu != 0) mu_nonzero[mu_amount++] = {z_index, (float)mu};
+        }
+        else sub_pairs[2 + candidate_amount++] = {z_index, vs_index};
+    }
+
+    /* First round of sub-problems */
+    int sub_amount = candidate_amount + 2;
+    for(int k = sub_amount - 1; k > 0 && context == NULL; k--){
+        pair<int, int> p = sub_pairs[k];
+        k_l_scheduler_submit([p]{ k_l_parallel_evaluate(p.first, p.second); }, all_p_len[p.second]);
+    }
+    // the results are constructed in place inside the arena, and destroyed once they are added up below
+    Polynomial* sub_results = frame.allocate<Polynomial>(sub_amount);
+    for(int k = 0; k < sub_amount; k++) new (&sub_results[k]) Polynomial(k_l_parallel_evaluate(sub_pairs[k].first, sub_pairs[k].second, context));
+
+    // μ(z, v*s_i) is the coefficient of q^[(l(v*s_i) - l(z) - 1) / 2] inside P(z, v*s_i)
+    for(int k = 0; k < candidate_amount; k++){
+        int z_index = sub_pairs[k+2].first, z_len = length_of(context, z_index);
+        if(context == NULL) greek_mu_table_record(z_index, vs_index, z_len, vs_len, sub_results[k+2].coefficients);
+        auto wanted_coefficient = sub_results[k+2].coefficients.find((vs_len - z_len - 1) / 2.0);
+        if(wanted_coefficient != sub_results[k+2].coefficients.end() && wanted_coefficient->second != 0)
+            mu_nonzero[mu_amount++] = {z_index, wanted_coefficient->second};
+    }
+
+    /* Second round of sub-problems */
+    for(int k = mu_amount - 1; k > 0 && context == NULL; k--){
+        int z_index = mu_nonzero[k].first;
+        k_l_scheduler_submit([u_index, z_index]{ k_l_parallel_evaluate(u_index, z_index); }, all_p_len[z_index]);
+    }
+
+    // adding q^(1-c) * P(u*s_i , v*s_i) and q^c * P(u, v*s_i)
+    Polynomial result, poly_temp;
+    poly_temp = polynom_multiply({{{1-c, 1}}}, sub_results[0]);
+    result = polynom_add(result, poly_temp);
+    poly_temp = polynom_multiply({{{c, 1}}}, sub_results[1]);
+    result = polynom_add(result, poly_temp);
+    for(int k = 0; k < sub_amount; k++) sub_results[k].~Polynomial();
+
+    // subtracting μ(z, v*s_i) * q^[(l_v - l_z)/2] * P(u,z)
+    for(auto mitr = mu_nonzero; mitr != mu_nonzero + mu_amount; mitr++){
+        int z_len = length_of(context, mitr->first);
+        poly_temp = polynom_multiply({{{0, mitr->second}}}, {{{(v_len - z_len)/2, 1}}});
+        poly_temp = polynom_multiply(poly_temp, k_l_parallel_evaluate(u_index, mitr->first, context));
+        result = polynom_subtract(result, poly_temp);
+    }
+
+    if(context == NULL){
+        greek_mu_table_record(u_index, v_index, all_p_len[u_index], v_len, result.coefficients);
+        k_l_log_append(u_index, v_index, result);
+        k_l_shm_publish(u_index, v_index, result);
+    }
+    entry->poly = result;
+    if(context == NULL) k_l_memo_bytes.fetch_add(memo_entry_bytes(entry), memory_order_relaxed);
+    entry->ready.store(true, memory_order_release);
+    frame_rank = saved_rank;
+}
+
+/*
+ Multi threaded version of 'polynom_k_l'. Requires the same global variables to be initialized beforehand:
+ 'all_p', 'all_p_len', 'b_matrix' and the K-L database. The scheduler is started if it is not running yet,
+ stopping it is left to the caller. Every new polynomial is copied to temp_database before returning, so
+ 'k_l_database_append' can be used afterwards just like with 'polynom_k_l'.
+*/
+Polynomial polynom_k_l_parallel(vector<int> u, vector<int> v, int thread_amount){
+    k_l_parallel_initiate(thread_amount);
+
+    K_L_STATS_PHASE(K_L_STATS_NS_RECURSION);
+    Polynomial result = k_l_parallel_evaluate(permt_rank(u), permt_rank(v));
+    k_l_memo_flush();
+    return result;
+}
+
+/*
+ Calls 'body' for 0, 1, ..., amount - 1 on every thread of the scheduler and the calling thread, each thread
+ takes the next number when it is done with the previous one, so the calls start in increasing order. Bodies
+ may use 'k_l_parallel_evaluate'. Returns once every call is finished, the scheduler should be started before.
+*/
+void k_l_parallel_for(size_t amount, function<void(size_t)> body){
+    atomic<size_t> next(0);
+    atomic<int> pullers_left(k_l_scheduler_thread_amount + 1);
+    auto pull = [&]{
+        size_t k;
+        while((k = next.fetch_add(1)) < amount) body(k);
+        pullers_left.fetch_sub(1);
+    };
+    // the pulling tasks have the highest rank, so threads waiting inside a frame never pick them up
+    for(int i = 0; i < k_l_scheduler_thread_amount; i++) k_l_scheduler_submit(pull, INT_MAX - 1);
+    pull();
+    k_l_scheduler_help_until([&pullers_left]{ return pullers_left.load() == 0; });
+}
@@ -0,0 +1,107 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef K_L_PARALLEL
+#define K_L_PARALLEL
+/*--------------------------------*/
+#ifndef POLYNOMIALS
+#include "polynomials.h"
+#endif // !POLYNOMIALS
+/*--------------------------------*/
+#ifndef K_L_SCHEDULER
+#include "k-l-scheduler.h"
+#endif // !K_L_SCHEDULER
+/*--------------------------------*/
+#ifndef K_L_LOG
+#include "k-l-log.h"
+#endif // !K_L_LOG
+/*--------------------------------*/
+#ifndef K_L_SHM
+#include "k-l-shm.h"
+#endif // !K_L_SHM
+/*--------------------------------*/
+#ifndef K_L_MEMORY
+#include "k-l-memory.h"
+#endif // !K_L_MEMORY
+/*--------------------------------*/
+#include <unordered_map>
+#include <cstdint>
+#endif // !K_L_PARALLEL
+
+#define K_L_MEMO_SHARDS 64
+
+// type definitions
+
+/* One K-L polynomial inside the memo. An entry is created by the first thread that asks for the pair,
+ * that thread computes it and sets 'ready', everybody else asking for the same pair in the meantime waits
+ * for that single computation instead of starting their own. */
+struct KLMemoEntry
+{
+    std::atomic<bool> ready;
+    bool persisted; // true once the polynomial is copied to temp_database, it is logged as soon as it is computed
+    Polynomial poly;
+};
+
+struct KLMemoShard
+{
+    std::mutex lock;
+    std::unordered_map<uint64_t, std::unique_ptr<KLMemoEntry>> entries;
+};
+
+/* The tables of one group without the global variables, see "k-l-context.h" */
+struct KLContext;
+
+/*--------------------------Global variables, just their declerations-----------------------*/
+
+/* The memo used by 'polynom_k_l_parallel', keyed by the index pair (u_index, v_index) of permutations
+ * and split into shards so that threads working on different pairs rarely wait on the same lock.
+ * It is kept between queries as long as 'current_sn_group' stays the same. */
+extern KLMemoShard k_l_memo[K_L_MEMO_SHARDS];
+
+/* Estimated bytes of the entries of 'k_l_memo' that are computed, see "k-l-memory.h" */
+extern std::atomic<uint64_t> k_l_memo_bytes;
+
+/*------------------------------------------------------------------------------------------*/
+
+// function declarations
+
+std::pair<KLMemoEntry*, bool> k_l_memo_acquire(int u_index, int v_index);
+
+std::pair<KLMemoEntry*, bool> k_l_memo_acquire(KLMemoShard* memo, int u_index, int v_index);
+
+void k_l_memo_clear(void);
+
+size_t k_l_memo_size(void);
+
+uint64_t k_l_memo_evict(uint64_t bytes);
+
+void k_l_memo_flush(void);
+
+void k_l_parallel_initiate(int thread_amount = 0);
+
+bool k_l_parallel_trivial(int u_index, int v_index, Polynomial& result, const KLContext* context = NULL);
+
+Polynomial k_l_parallel_evaluate(int u_index, int v_index, const KLContext* context = NULL);
+
+void k_l_parallel_compute(int u_index, int v_index, KLMemoEntry* entry, const KLContext* context = NULL);
+
+/* thread_amount = 0 uses every core on the machine */
+Polynomial polynom_k_l_parallel(std::vector<int> u, std::vector<int> v, int thread_amount = 0);
+
+void k_l_parallel_for(size_t amount, std::function<void(size_t)> body);
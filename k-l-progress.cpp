@@ -0,0 +1,177 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "k-l-progress.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/resource.h>
+
+using namespace std;
+
+/* GLOBAL VARIABLES --------------- */
+
+atomic<uint64_t> k_l_progress_done(0);
+atomic<bool> k_l_progress_recursion(false);
+
+static mutex progress_lock;
+static condition_variable progress_wake;
+static thread progress_reporter;
+static bool progress_stop = false;
+static int progress_depth = 0;     // phases started and not ended yet, only the outermost one is reported
+static bool progress_reported = false;
+static string progress_phase, progress_unit, progress_file;
+static uint64_t progress_total = 0;
+static double progress_interval = 0;
+static chrono::steady_clock::time_point progress_start;
+
+/*--------------------------------- */
+
+/* Resident memory of this process in bytes, the peak of it if /proc is not there */
+uint64_t k_l_progress_rss(void){
+    FILE* ifp = fopen("/proc/self/statm", "r");
+    if(ifp != NULL){
+        unsigned long long pages_total, pages_resident;
+        bool found = fscanf(ifp, "%llu %llu", &pages_total, &pages_resident) == 2;
+        fclose(ifp);
+        if(found) return pages_resident * sysconf(_SC_PAGESIZE);
+    }
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0) return (uint64_t)usage.ru_maxrss * 1024;
+    return 0;
+}
+
+static string format_seconds(double seconds){
+    char text[64];
+    long s = (long)seconds;
+    if(seconds < 60) snprintf(text, sizeof(text), "%.1fs", seconds);
+    else if(s < 3600) snprintf(text, sizeof(text), "%ldm %02lds", s / 60, s % 60);
+    else if(s < 86400) snprintf(text, sizeof(text), "%ldh %02ldm", s / 3600, (s / 60) % 60);
+    else snprintf(text, sizeof(text), "%ldd %02ldh", s / 86400, (s / 3600) % 24);
+    return text;
+}
+
+static string format_bytes(uint64_t bytes){
+    char text[64];
+    if(bytes < (1ULL << 30)) snprintf(text, sizeof(text), "%.1f MiB", bytes / 1048576.0);
+    else snprintf(text, sizeof(text), "%.2f GiB", bytes / 1073741824.0);
+    return text;
+}
+
+// The status file is replaced at once, readers never see half of it
+static void write_status_file(uint64_t done, double rate, double eta, double elapsed, uint64_t rss, bool finished){
+    string temp_path = progress_file + ".tmp" + to_string(getpid());
+    FILE* ofp = fopen(temp_path.c_str(), "w");
+    if(ofp == NULL) return;
+    fprintf(ofp, "phase %s\nunit %s\ndone %llu\ntotal %llu\nrate %.3f\neta_seconds %.0f\nelapsed_seconds %.3f\nrss_bytes %llu\nfinished %d\n",
+            progress_phase.c_str(), progress_unit.c_str(), (unsigned long long)done, (unsigned long long)progress_total,
+            rate, eta, elapsed, (unsigned long long)rss, finished ? 1 : 0);
+    if(fclose(ofp) != 0 || rename(temp_path.c_str(), progress_file.c_str()) != 0) remove(temp_path.c_str());
+}
+
+/* Prints one line, 'rate' is the smoothed one while running and the average once finished */
+static void progress_report(uint64_t done, double rate, bool finished){
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - progress_start).count();
+    double eta = (!finished && progress_total > 0 && rate > 0 && done < progress_total) ? (progress_total - done) / rate : -1;
+    if(finished) eta = 0;
+    uint64_t rss = k_l_progress_rss();
+    if(!progress_file.empty()){
+        write_status_file(done, rate, eta, elapsed, rss, finished);
+        return;
+    }
+
+    string line = "  [" + progress_phase + "] ";
+    char text[128];
+    if(progress_total > 0){
+        snprintf(text, sizeof(text), "%llu/%llu %s (%.1f%%)", (unsigned long long)done, (unsigned long long)progress_total,
+                 progress_unit.c_str(), 100.0 * done / progress_total);
+    }
+    else snprintf(text, sizeof(text), "%llu %s", (unsigned long long)done, progress_unit.c_str());
+    line += text;
+    snprintf(text, sizeof(text), ", %.1f %s/s", rate, progress_unit.c_str()); line += text;
+    if(finished) line += ", done";
+    else if(eta >= 0) line += ", ETA " + format_seconds(eta);
+    line += ", RSS " + format_bytes(rss) + ", " + format_seconds(elapsed) + "\n";
+    fputs(line.c_str(), stderr);
+    fflush(stderr);
+}
+
+/* The thread reporting the current phase, this does not have a meaning on its own */
+static void progress_reporter_function(void){
+    uint64_t last_done = 0;
+    auto last_time = progress_start;
+    double smoothed = -1;
+    unique_lock<mutex> guard(progress_lock);
+    auto interval = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(progress_interval));
+    while(!progress_wake.wait_for(guard, interval, []{ return progress_stop; })){
+        guard.unlock();
+        uint64_t done = k_l_progress_done.load(memory_order_relaxed);
+        auto now = chrono::steady_clock::now();
+        double recent = (done - last_done) / max(chrono::duration<double>(now - last_time).count(), 1e-9);
+        // levels of the table get slower as v gets longer, old rates are forgotten quickly
+        smoothed = smoothed < 0 ? recent : 0.5 * smoothed + 0.5 * recent;
+        last_done = done; last_time = now;
+        progress_report(done, smoothed, false);
+        guard.lock();
+        progress_reported = true;
+    }
+}
+
+/*
+ Starts a phase with 'total' units to do, 0 if that is not known. If 'recursion' is true the pairs computed by
+ the recursion engines are counted, otherwise the caller counts with 'k_l_progress_add'.
+*/
+void k_l_progress_begin(string phase, string unit, uint64_t total, bool recursion){
+    lock_guard<mutex> guard(progress_lock);
+    if(progress_depth++ > 0) return;
+    const char* interval = getenv("K_L_PROGRESS_INTERVAL");
+    const char* file = getenv("K_L_PROGRESS_FILE");
+    progress_interval = interval != NULL ? atof(interval) : K_L_PROGRESS_DEFAULT_INTERVAL;
+    progress_file = file != NULL ? file : "";
+    progress_phase = phase; progress_unit = unit; progress_total = total;
+    progress_start = chrono::steady_clock::now();
+    k_l_progress_done.store(0);
+    k_l_progress_recursion.store(recursion);
+    if(progress_interval <= 0) return;
+    progress_stop = false; progress_reported = false;
+    progress_reporter = thread(progress_reporter_function);
+}
+
+/* Ends the phase, a last line with the average rate is printed if the phase was reported at all, the status file is always written */
+void k_l_progress_end(void){
+    unique_lock<mutex> guard(progress_lock);
+    if(progress_depth == 0 || --progress_depth > 0) return;
+    k_l_progress_recursion.store(false);
+    if(!progress_reporter.joinable()) return;
+    progress_stop = true;
+    guard.unlock();
+    progress_wake.notify_all();
+    progress_reporter.join();
+    guard.lock();
+    if(progress_reported || !progress_file.empty()){
+        uint64_t done = k_l_progress_done.load();
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - progress_start).count();
+        progress_report(done, done / max(elapsed, 1e-9), true);
+    }
+}
@@ -0,0 +1,79 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef K_L_PROGRESS
+#define K_L_PROGRESS
+/*--------------------------------*/
+#include <cstdint>
+#include <atomic>
+#include <string>
+#endif // !K_L_PROGRESS
+
+/* Seconds between two reports when K_L_PROGRESS_INTERVAL is not set */
+#define K_L_PROGRESS_DEFAULT_INTERVAL 10
+
+/*
+ Reports of long phases: the Bruhat matrix, the full table, batches and single recursions. Workers only add to
+ 'k_l_progress_done' with a relaxed atomic, once for each row or pair, and a separate thread reads it every
+ K_L_PROGRESS_INTERVAL seconds (the environment variable, 0 turns the reports off) and prints
+         [<phase>] <done>/<total> <unit> (<percent>), <rate> <unit>/s, ETA <time>, RSS <memory>, <elapsed>
+ to stderr. The rate is the one since the previous report, smoothed, and the ETA is computed from it. When the
+ total is not known (a single recursion, where it is not known how many pairs are below v) only the amount done
+ and the rate are printed. Phases shorter than one interval print nothing at all.
+
+ If K_L_PROGRESS_FILE is set the report goes to that file instead, it is replaced at every interval:
+         phase <phase>
+         unit <unit>
+         done <amount>
+         total <amount, 0 if not known>
+         rate <per second>
+         eta_seconds <seconds, -1 if not known>
+         elapsed_seconds <seconds>
+         rss_bytes <bytes>
+         finished <0 or 1>
+ Phases do not nest, a phase started while another one is running is not reported and counts into the outer one.
+*/
+
+/*--------------------------Global variables, just their declerations-----------------------*/
+
+/* Rows or pairs done in the current phase */
+extern std::atomic<uint64_t> k_l_progress_done;
+
+/* True while the current phase counts the pairs computed by 'polynom_k_l' and 'k_l_parallel_compute' */
+extern std::atomic<bool> k_l_progress_recursion;
+
+/*------------------------------------------------------------------------------------------*/
+
+// function declarations
+
+void k_l_progress_begin(std::string phase, std::string unit, uint64_t total = 0, bool recursion = false);
+
+void k_l_progress_end(void);
+
+uint64_t k_l_progress_rss(void);
+
+inline void k_l_progress_add(uint64_t amount){
+    k_l_progress_done.fetch_add(amount, std::memory_order_relaxed);
+}
+
+/* Called by the recursion engines once for each pair they compute */
+inline void k_l_progress_pair(void){
+    if(k_l_progress_recursion.load(std::memory_order_relaxed)) k_l_progress_done.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,350 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "k-l-query.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <csignal>
+#include <cstring>
+#include <semaphore>
+#include <set>
+
+using namespace std;
+
+/* GLOBAL VARIABLES --------------- */
+
+atomic<uint64_t> k_l_query_amount(0);
+shared_mutex k_l_query_lock;
+
+static atomic<bool> server_stop(false);
+static unique_ptr<counting_semaphore<>> query_slots; // one for every query that may be computed at once
+
+static mutex clients_lock;                // guards the variables below
+static set<int> client_fds;
+static condition_variable clients_done;
+
+static mutex persist_lock;
+static condition_variable persist_wake;
+
+/*--------------------------------- */
+
+/* Reads "1324" or "1,3,2,4" into 'result', returns false unless it is a permutation inside 'current_sn_group' */
+bool k_l_query_parse_permutation(string text, vector<int>& result){
+    result.clear();
+    if(text.find(',') != string::npos){
+        stringstream s(text); string item;
+        while(getline(s, item, ',')){
+            if(item.empty() || item.find_first_not_of("0123456789") != string::npos || item.size() > 3) return false;
+            result.push_back(stoi(item));
+        }
+    }
+    else{
+        for(auto itr = text.begin(); itr != text.end(); itr++){
+            if(*itr < '0' || *itr > '9') return false;
+            result.push_back(*itr - 48);
+        }
+    }
+    if(result.size() != current_sn_group) return false;
+    vector<bool> seen(current_sn_group + 1, false);
+    for(auto itr = result.begin(); itr != result.end(); itr++){
+        if(*itr < 1 || *itr > current_sn_group || seen[*itr]) return false;
+        seen[*itr] = true;
+    }
+    return true;
+}
+
+/* "0:1 1:1" for 1 + q, terms with a zero coefficient are left out */
+string k_l_query_format(const Polynomial& poly){
+    string result;
+    for(auto itr = poly.coefficients.begin(); itr != poly.coefficients.end(); itr++){
+        if(itr->second == 0) continue;
+        if(!result.empty()) result += ' ';
+        result += to_string((long long)itr->first) + ":" + to_string((long long)itr->second);
+    }
+    return result.empty() ? "0:0" : result;
+}
+
+/*
+ Answers P(u, v) with the permutations written as text, the reply is "OK <polynomial>" or "ERR <reason>".
+ The tables of 'current_sn_group' and 'k_l_parallel_initiate' should be ready. Thread safe.
+*/
+string k_l_query_answer(string u_text, string v_text){
+    vector<int> u, v;
+    if(!k_l_query_parse_permutation(u_text, u) || !k_l_query_parse_permutation(v_text, v)){
+        return "ERR expected two permutations of S_" + to_string(current_sn_group);
+    }
+    Polynomial result;
+    {
+        shared_lock<shared_mutex> guard(k_l_query_lock);
+        result = k_l_parallel_evaluate(permt_rank(u), permt_rank(v));
+    }
+    k_l_query_amount.fetch_add(1, memory_order_relaxed);
+    return "OK " + k_l_query_format(result);
+}
+
+/* The n of S_n that the permutation written as text belongs to, the text is not checked any further */
+int k_l_query_group_of(const string& text){
+    if(text.find(',') != string::npos) return count(text.begin(), text.end(), ',') + 1;
+    return text.size();
+}
+
+/* Reads every pair of a batch, see "k-l-query.h" for the format */
+void k_l_query_read_pairs(FILE* input, vector<KLQueryPair>& pairs){
+    char buffer[K_L_SERVER_MAX_LINE];
+    long line = 0;
+    while(fgets(buffer, sizeof(buffer), input) != NULL){
+        line++;
+        istringstream words(buffer); KLQueryPair pair; pair.line = line;
+        if(!(words >> pair.u_text) || pair.u_text[0] == '#') continue;
+        words >> pair.v_text;
+        pairs.push_back(pair);
+    }
+}
+
+/*
+ Computes every pair of a batch that belongs to 'current_sn_group', the group tables should be initialized
+ before. Pairs are sorted by the length of v, v, then the length of u, so the sub-problems of short pairs are
+ already inside the memo when longer ones need them. 'thread_amount' threads (every core if 0) take the
+ next pair in that order one by one, see 'k_l_parallel_for', and each pair is split further by 'k_l_parallel_evaluate'.
+ Answers are written to 'output' as they are found. Returns the amount of pairs answered without an error.
+*/
+size_t k_l_query_batch(vector<KLQueryPair> pairs, FILE* output, int thread_amount){
+    k_l_parallel_initiate(thread_amount);
+    vector<KLQueryPair*> valid;
+    mutex output_lock;
+    for(auto itr = pairs.begin(); itr != pairs.end(); itr++){
+        vector<int> u, v;
+        if(!k_l_query_parse_permutation(itr->u_text, u) || !k_l_query_parse_permutation(itr->v_text, v)){
+            fprintf(output, "%ld ERR expected two permutations of S_%d\n", itr->line, current_sn_group);
+            continue;
+        }
+        itr->u_index = permt_rank(u); itr->v_index = permt_rank(v);
+        valid.push_back(&(*itr));
+    }
+    sort(valid.begin(), valid.end(), [](const KLQueryPair* a, const KLQueryPair* b){
+        return make_tuple(all_p_len[a->v_index], a->v_index, all_p_len[a->u_index], a->u_index)
+             < make_tuple(all_p_len[b->v_index], b->v_index, all_p_len[b->u_index], b->u_index);
+    });
+
+    K_L_STATS_PHASE(K_L_STATS_NS_RECURSION);
+    k_l_progress_begin("batch S_" + to_string(current_sn_group), "pairs", valid.size());
+    // with a memory budget the pairs are done in parts, the budget is enforced between them
+    size_t part = valid.size();
+    if(k_l_memory_budget > 0) part = (size_t)(k_l_scheduler_thread_amount + 1) * K_L_MEMORY_CHECK_COLUMNS;
+    for(size_t first = 0; first < valid.size(); first += part){
+        k_l_parallel_for(min(part, valid.size() - first), [&](size_t k){
+            KLQueryPair* pair = valid[first + k];
+            string answer = to_string(pair->line) + " " + pair->u_text + " " + pair->v_text + " "
+                            + k_l_query_format(k_l_parallel_evaluate(pair->u_index, pair->v_index)) + "\n";
+            lock_guard<mutex> guard(output_lock);
+            fputs(answer.c_str(), output);
+            k_l_progress_add(1);
+        });
+        k_l_memory_checkpoint();
+    }
+    k_l_progress_end();
+    fflush(output);
+    k_l_query_amount.fetch_add(valid.size());
+    return valid.size();
+}
+
+// "KL-server<number>.sock" in the current directory
+string k_l_server_socket_name(void){
+    ostringstream s; s << "KL-server" << current_sn_group << ".sock";
+    return s.str();
+}
+
+static void server_signal_handler(int signal_number){
+    server_stop.store(true);
+}
+
+// Writes the whole text to the client, returns false if the client is gone
+static bool client_send(int fd, const string& text){
+    const char* data = text.data(); size_t left = text.size();
+    while(left > 0){
+        ssize_t done = send(fd, data, left, MSG_NOSIGNAL);
+        if(done <= 0) return false;
+        data += done; left -= done;
+    }
+    return true;
+}
+
+/* Serves a single connection until the client leaves, this does not have a meaning on its own */
+static void server_client_function(int fd){
+    string buffer; char chunk[4096];
+    auto next_line = [&](string& line){
+        while(true){
+            size_t end = buffer.find('\n');
+            if(end != string::npos){
+                line = buffer.substr(0, end); buffer.erase(0, end + 1);
+                if(!line.empty() && line.back() == '\r') line.pop_back();
+                return true;
+            }
+            if(buffer.size() > K_L_SERVER_MAX_LINE) return false;
+            ssize_t amount = read(fd, chunk, sizeof(chunk));
+            if(amount <= 0) return false;
+            buffer.append(chunk, amount);
+        }
+    };
+
+    string line;
+    while(!server_stop.load() && next_line(line)){
+        istringstream words(line); string command, u_text, v_text;
+        words >> command;
+        if(command.empty()) continue;
+
+        if(command == "P"){
+            words >> u_text >> v_text;
+            query_slots->acquire();
+            string answer = k_l_query_answer(u_text, v_text);
+            query_slots->release();
+            if(!client_send(fd, answer + "\n")) break;
+        }
+        else if(command == "B"){
+            long amount = -1; words >> amount;
+            if(amount < 0){ if(!client_send(fd, "ERR expected the amount of pairs\n")) break; continue; }
+            // the lines of a larger batch can not be told apart from requests, so the connection ends here
+            if(amount > K_L_SERVER_MAX_BATCH){
+                client_send(fd, "ERR at most " + to_string(K_L_SERVER_MAX_BATCH) + " pairs in a batch\n");
+                break;
+            }
+            // every line is received before the batch takes a slot, the whole batch takes a single one
+            vector<pair<string, string>> pairs; bool complete = true;
+            for(long k = 0; k < amount; k++){
+                if(!next_line(line)){ complete = false; break; }
+                istringstream pair_words(line); pair_words >> u_text >> v_text;
+                pairs.push_back({u_text, v_text});
+            }
+            if(!complete) break;
+            string answers;
+            query_slots->acquire();
+            for(auto itr = pairs.begin(); itr != pairs.end(); itr++) answers += k_l_query_answer(itr->first, itr->second) + "\n";
+            query_slots->release();
+            if(!client_send(fd, answers)) break;
+        }
+        else if(command == "STATS"){
+            ostringstream s;
+            s << "OK queries " << k_l_query_amount.load() << " memo " << k_l_memo_size() << " log " << k_l_log_records
+              << " memory " << k_l_memory_total() << " budget " << k_l_memory_budget << "\n";
+            if(!client_send(fd, s.str())) break;
+        }
+        else if(command == "QUIT") break;
+        else if(command == "SHUTDOWN"){
+            client_send(fd, "OK\n");
+            server_stop.store(true); persist_wake.notify_all();
+            break;
+        }
+        else if(!client_send(fd, "ERR unknown request " + command + "\n")) break;
+    }
+
+    lock_guard<mutex> guard(clients_lock);
+    client_fds.erase(fd); close(fd);
+    if(client_fds.empty()) clients_done.notify_all();
+}
+
+/*
+ The persistence thread of the server. Polynomials are already logged and synced by the log writer, see
+ "k-l-log.h", this only maps the binary database once a background compaction of the log is finished.
+ That needs every query and every leftover task of the scheduler to be out of the databases, so it is done at
+ most every K_L_SERVER_PERSIST_INTERVAL milliseconds instead of after each query. The memory budget is enforced
+ at the same time, see "k-l-memory.h".
+*/
+void k_l_server_persist_function(void){
+    while(!server_stop.load()){
+        {
+            unique_lock<mutex> guard(persist_lock);
+            persist_wake.wait_for(guard, chrono::milliseconds(K_L_SERVER_PERSIST_INTERVAL), []{ return server_stop.load(); });
+        }
+        if(k_l_log_compact_ready()){
+            unique_lock<shared_mutex> guard(k_l_query_lock);
+            k_l_scheduler_drain();
+            k_l_log_compact_finish(false);
+        }
+        if(k_l_memory_over_budget()){
+            unique_lock<shared_mutex> guard(k_l_query_lock);
+            k_l_memory_checkpoint();
+        }
+    }
+}
+
+/*
+ Serves queries on the Unix socket at 'socket_path' (by default 'k_l_server_socket_name') until SHUTDOWN
+ is requested or the process gets SIGINT or SIGTERM. Every group table and the K-L database of the group in
+ 'current_sn_group' should be initialized before. 'max_queries' = 0 allows as many queries as there are cores.
+ Returns 0 on a normal exit.
+*/
+int k_l_server_run(string socket_path, int max_queries){
+    if(socket_path.empty()) socket_path = k_l_server_socket_name();
+    if(max_queries <= 0) max_queries = max(1u, thread::hardware_concurrency());
+
+    sockaddr_un address; memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(socket_path.size() >= sizeof(address.sun_path)){ printf("  The socket path %s is too long\n", socket_path.c_str()); return 1; }
+    strcpy(address.sun_path, socket_path.c_str());
+
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(server_fd == -1){ printf("  Could not create a socket\n"); return 1; }
+    // a socket file is left behind by a server that did not exit normally, it is only removed if nobody answers
+    if(connect(server_fd, (sockaddr*)&address, sizeof(address)) == 0){
+        printf("  Another server is listening on %s\n", socket_path.c_str()); close(server_fd); return 1;
+    }
+    close(server_fd);
+    unlink(socket_path.c_str());
+    server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(server_fd == -1 || bind(server_fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(server_fd, 64) != 0){
+        printf("  Could not listen on %s\n", socket_path.c_str()); if(server_fd != -1) close(server_fd); return 1;
+    }
+
+    struct sigaction action; memset(&action, 0, sizeof(action));
+    action.sa_handler = server_signal_handler;
+    sigaction(SIGINT, &action, NULL); sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    server_stop.store(false);
+    k_l_parallel_initiate();
+    query_slots = make_unique<counting_semaphore<>>(max_queries);
+    thread persister(k_l_server_persist_function);
+    printf("  Serving S_%d on %s, at most %d queries at once\n", current_sn_group, socket_path.c_str(), max_queries);
+    fflush(stdout);
+
+    while(!server_stop.load()){
+        pollfd request = {server_fd, POLLIN, 0};
+        if(poll(&request, 1, 200) <= 0) continue;
+        int fd = accept(server_fd, NULL, NULL);
+        if(fd == -1) continue;
+        lock_guard<mutex> guard(clients_lock);
+        client_fds.insert(fd);
+        thread(server_client_function, fd).detach();
+    }
+    close(server_fd); unlink(socket_path.c_str());
+
+    // connections that are waiting for a request are woken up, running queries are finished first
+    {
+        unique_lock<mutex> guard(clients_lock);
+        for(auto itr = client_fds.begin(); itr != client_fds.end(); itr++) shutdown(*itr, SHUT_RDWR);
+        clients_done.wait(guard, []{ return client_fds.empty(); });
+    }
+    persist_wake.notify_all(); persister.join();
+    k_l_scheduler_stop();
+    printf("  Answered %lu queries, writing the database ...\n", (unsigned long)k_l_query_amount.load());
+    k_l_database_append();
+    return 0;
+}
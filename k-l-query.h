@@ -0,0 +1,106 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef K_L_QUERY
+#define K_L_QUERY
+/*--------------------------------*/
+#ifndef K_L_PARALLEL
+#include "k-l-parallel.h"
+#endif // !K_L_PARALLEL
+/*--------------------------------*/
+#include <string>
+#include <atomic>
+#include <shared_mutex>
+#include <cstdio>
+#endif // !K_L_QUERY
+
+/* Milliseconds between two rounds of persistence of the server, see 'k_l_server_persist_function' */
+#define K_L_SERVER_PERSIST_INTERVAL 2000
+
+/* Longest request line the server accepts */
+#define K_L_SERVER_MAX_LINE 4096
+
+/* Most pairs a single "B <amount>" request of the server may have */
+#define K_L_SERVER_MAX_BATCH 65536
+
+/*
+ Queries of already loaded groups, without any prompt. Permutations are written in line notation either as
+ digits "1324" or separated by commas "1,3,2,4", and polynomials as "power:coefficient" terms in increasing
+ order of power, "0:1 1:1" is 1 + q. The zero polynomial is written as "0:0".
+
+ The server listens on the Unix socket 'KL-server<number>.sock' and keeps the tables of one group, its
+ b_matrix and the memo of 'polynom_k_l_parallel' in memory between queries. Requests are lines:
+         P <u> <v>       answered with "OK <polynomial>" or "ERR <reason>"
+         B <amount>      followed by <amount> lines "<u> <v>", answered with one line for each of them. At most
+                         K_L_SERVER_MAX_BATCH pairs, the connection is closed after an "ERR" for a larger amount
+         STATS           "OK queries <answered> memo <pairs inside the memo> log <records waiting for compaction>
+                         memory <bytes of the caches> budget <bytes, 0 if there is none>" on one line
+         QUIT            closes the connection
+         SHUTDOWN        stops the server, the database is compacted before it exits
+ At most 'max_queries' queries are computed at the same time, the others wait. A batch takes its place only once
+ all of its lines are received, so a slow client does not keep others waiting. New polynomials are logged as
+ soon as they are computed, the server syncs the log and maps finished compactions of it every
+ K_L_SERVER_PERSIST_INTERVAL milliseconds instead of after each query.
+
+ Batches are files with one pair "<u> <v>" on each line, empty lines and lines starting with '#' are skipped.
+ Answers are written as soon as they are computed, so not in the order of the input, one line for each pair:
+         <line> <u> <v> <polynomial>
+         <line> ERR <reason>
+ where <line> is the line of the pair inside the input, starting from 1.
+*/
+
+// type definitions
+
+/* One pair of a batch, the indexes are set once the group of the pair is loaded */
+struct KLQueryPair
+{
+    long line;
+    std::string u_text, v_text;
+    int u_index = -1, v_index = -1;
+};
+
+/*--------------------------Global variables, just their declerations-----------------------*/
+
+/* Amount of pairs answered by 'k_l_query_answer' and 'k_l_query_batch' */
+extern std::atomic<uint64_t> k_l_query_amount;
+
+/* Queries hold this shared while they read the databases, persistence holds it exclusively */
+extern std::shared_mutex k_l_query_lock;
+
+/*------------------------------------------------------------------------------------------*/
+
+// function declarations
+
+bool k_l_query_parse_permutation(std::string text, std::vector<int>& result);
+
+std::string k_l_query_format(const Polynomial& poly);
+
+std::string k_l_query_answer(std::string u_text, std::string v_text);
+
+int k_l_query_group_of(const std::string& text);
+
+void k_l_query_read_pairs(FILE* input, std::vector<KLQueryPair>& pairs);
+
+size_t k_l_query_batch(std::vector<KLQueryPair> pairs, FILE* output, int thread_amount = 0);
+
+std::string k_l_server_socket_name(void);
+
+void k_l_server_persist_function(void);
+
+int k_l_server_run(std::string socket_path = "", int max_queries = 0);
@@ -0,0 +1,155 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "k-l-scheduler.h"
+
+using namespace std;
+
+/* GLOBAL VARIABLES --------------- */
+
+int k_l_scheduler_thread_amount = 0;
+
+/*--------------------------------- */
+
+/* One queue per worker, plus one extra queue at the end for tasks submitted by threads that are
+ * not workers (the main thread for example) */
+static vector<unique_ptr<KLTaskQueue>> task_queues;
+static vector<thread> workers;
+static atomic<bool> scheduler_running(false);
+static atomic<int> pending_tasks(0);
+static atomic<int> running_tasks(0);
+static mutex sleep_lock;
+static condition_variable sleep_cv;
+
+/* -1 for any thread that is not a worker of the scheduler */
+static thread_local int worker_index = -1;
+
+/*
+ Starts the worker threads, by default one for each core on the machine.
+ Calling this while the scheduler is already running does nothing.
+*/
+void k_l_scheduler_start(int thread_amount){
+    if(scheduler_running.load()) return;
+    if(thread_amount <= 0) thread_amount = thread::hardware_concurrency();
+    if(thread_amount <= 0) thread_amount = 1;
+
+    task_queues.clear();
+    for(int i = 0; i <= thread_amount; i++) task_queues.push_back(make_unique<KLTaskQueue>());
+    k_l_scheduler_thread_amount = thread_amount;
+    scheduler_running.store(true);
+    for(int i = 0; i < thread_amount; i++) workers.push_back(thread(k_l_scheduler_worker_function, i));
+}
+
+/* Stops and joins every worker, tasks that are still queued are dropped. Only call this when
+ * nobody is waiting on a result anymore. */
+void k_l_scheduler_stop(void){
+    if(!scheduler_running.load()) return;
+    scheduler_running.store(false);
+    sleep_cv.notify_all();
+    for(auto itr = workers.begin(); itr != workers.end(); itr++) itr->join();
+    workers.clear(); task_queues.clear();
+    pending_tasks.store(0);
+    k_l_scheduler_thread_amount = 0;
+}
+
+/* Pushes a task to the back of the queue of the calling thread, so the owner will pick it up first (LIFO)
+ * while idle threads steal the oldest tasks from the front (FIFO). */
+void k_l_scheduler_submit(function<void()> run, int rank){
+    int queue_index = (worker_index == -1) ? k_l_scheduler_thread_amount : worker_index;
+    {
+        lock_guard<mutex> guard(task_queues[queue_index]->lock);
+        task_queues[queue_index]->tasks.push_back({run, rank});
+    }
+    pending_tasks.fetch_add(1);
+    sleep_cv.notify_one();
+}
+
+/*
+ Runs exactly one task if any task with rank < max_rank is available, returns false otherwise.
+ The own queue is searched from the back, other queues are searched from the front.
+
+ The rank limit is what keeps the scheduler deadlock free: a thread that waits inside a frame of rank r
+ only runs tasks of a smaller rank on top of it, so ranks on every thread's stack strictly decrease and
+ no thread can end up waiting on a computation that sits below it on its own stack.
+*/
+bool k_l_scheduler_run_one(int max_rank){
+    if(pending_tasks.load() == 0) return false;
+    int queue_amount = task_queues.size();
+    int own_index = (worker_index == -1) ? k_l_scheduler_thread_amount : worker_index;
+
+    for(int k = 0; k < queue_amount; k++){
+        int q = (own_index + k) % queue_amount;
+        KLTask task; bool found = false;
+        {
+            lock_guard<mutex> guard(task_queues[q]->lock);
+            auto& tasks = task_queues[q]->tasks;
+            if(k == 0){
+                for(auto itr = tasks.rbegin(); itr != tasks.rend(); itr++){
+                    if(itr->rank < max_rank){
+                        task = move(*itr); tasks.erase(next(itr).base()); found = true; break;
+                    }
+                }
+            }
+            else{
+                for(auto itr = tasks.begin(); itr != tasks.end(); itr++){
+                    if(itr->rank < max_rank){
+                        task = move(*itr); tasks.erase(itr); found = true; break;
+                    }
+                }
+            }
+        }
+        if(found){
+            // counted as running before it stops being pending, so 'k_l_scheduler_drain' never sees neither
+            running_tasks.fetch_add(1);
+            pending_tasks.fetch_sub(1);
+            task.run();
+            running_tasks.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Keeps the calling thread busy with other tasks until 'done' returns true, instead of blocking it */
+void k_l_scheduler_help_until(function<bool()> done, int max_rank){
+    while(!done()){
+        if(!k_l_scheduler_run_one(max_rank)) this_thread::yield();
+    }
+}
+
+/*
+ Returns once no task is queued or running anymore, the calling thread runs tasks meanwhile. Tasks whose pair
+ was computed by somebody else may still be queued after a computation is finished, this waits for them too.
+ Only call this from a thread that is not running a task itself, while nobody submits new tasks.
+*/
+void k_l_scheduler_drain(void){
+    k_l_scheduler_help_until([]{ return pending_tasks.load() == 0 && running_tasks.load() == 0; });
+}
+
+/* This function does not have a meaning on its own, every worker thread runs it until the scheduler stops */
+void k_l_scheduler_worker_function(int worker_id){
+    worker_index = worker_id;
+    while(scheduler_running.load()){
+        if(k_l_scheduler_run_one(INT_MAX)) continue;
+        unique_lock<mutex> guard(sleep_lock);
+        sleep_cv.wait_for(guard, chrono::milliseconds(1),
+                          []{ return pending_tasks.load() > 0 || !scheduler_running.load(); });
+    }
+    worker_index = -1;
+}
@@ -0,0 +1,73 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef K_L_SCHEDULER
+#define K_L_SCHEDULER
+/*--------------------------------*/
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <climits>
+#include <memory>
+#endif // !K_L_SCHEDULER
+
+// type definitions
+
+/* A unit of work for the scheduler. 'rank' is used to decide which tasks a waiting thread may pick up,
+ * for K-L polynomials it is the length of v in P(u, v), every sub-problem has a strictly smaller rank. */
+struct KLTask
+{
+    std::function<void()> run;
+    int rank;
+};
+
+/* Every worker owns one of these, the owner pushes and pops from the back, other threads steal from the front */
+struct KLTaskQueue
+{
+    std::mutex lock;
+    std::deque<KLTask> tasks;
+};
+
+/*--------------------------Global variables, just their declerations-----------------------*/
+
+/* The amount of worker threads that are running, 0 when the scheduler is not started.
+ * The thread that calls 'k_l_scheduler_help_until' also works, but it is not counted here. */
+extern int k_l_scheduler_thread_amount;
+
+/*------------------------------------------------------------------------------------------*/
+
+// function declarations
+
+void k_l_scheduler_start(int thread_amount = 0);
+
+void k_l_scheduler_stop(void);
+
+void k_l_scheduler_submit(std::function<void()> run, int rank);
+
+bool k_l_scheduler_run_one(int max_rank);
+
+void k_l_scheduler_help_until(std::function<bool()> done, int max_rank = INT_MAX);
+
+void k_l_scheduler_drain(void);
+
+void k_l_scheduler_worker_function(int worker_id);
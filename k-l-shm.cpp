@@ -0,0 +1,247 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "k-l-shm.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+
+using namespace std;
+
+/* GLOBAL VARIABLES --------------- */
+
+KLShmHeader* k_l_shm = NULL;
+
+static int shm_fd = -1;
+static string shm_attached_name; // the name of the attached segment, it depends on the group
+
+/*--------------------------------- */
+
+// "/KL-cache<number>-<user ID>", the user ID is added so that users of the same machine do not share a segment
+string k_l_shm_name(void){
+    ostringstream s; s << "/KL-cache" << current_sn_group << "-" << getuid();
+    return s.str();
+}
+
+static uint64_t round_up(uint64_t size){
+    return (size + 63) / 64 * 64;
+}
+
+// the usual 64 bit mixer of splitmix64, keys of neighbouring pairs end up far away from each other
+static uint64_t mix(uint64_t key){
+    key += 0x9E3779B97F4A7C15ULL;
+    key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+    return key ^ (key >> 31);
+}
+
+static KLShmSlot* shm_slots(uint64_t offset){
+    return (KLShmSlot*)((char*)k_l_shm + offset);
+}
+
+static const int32_t* shm_terms(uint64_t value){
+    return (const int32_t*)((char*)k_l_shm + k_l_shm->pool_offset + value - 1);
+}
+
+/*
+ Attaches to the segment of the group in 'current_sn_group', creating it if there is none, and points the rows
+ of 'b_matrix' into it. The matrix is filled by 'bruhat_matrix_initiate' only by the first process, the others
+ wait until that is done. Returns false if shared memory is not available, nothing is changed then and the
+ caller should allocate 'b_matrix' by itself.
+*/
+bool k_l_shm_attach(void){
+    k_l_shm_detach();
+    uint64_t f_n = factorial(current_sn_group);
+    uint64_t slot_amount = 1024;
+    while(slot_amount < f_n * f_n / 2 && slot_amount < K_L_SHM_MAX_SLOTS) slot_amount *= 2;
+
+    KLShmHeader layout;
+    layout.slot_amount = slot_amount;
+    layout.matrix_offset = round_up(sizeof(KLShmHeader));
+    layout.polynomials_offset = round_up(layout.matrix_offset + f_n * f_n * sizeof(int));
+    layout.slots_offset = layout.polynomials_offset + K_L_SHM_POLYNOMIALS * sizeof(KLShmSlot);
+    layout.pool_offset = layout.slots_offset + slot_amount * sizeof(KLShmSlot);
+    layout.total_size = layout.pool_offset + K_L_SHM_POOL_SIZE;
+
+    string name = k_l_shm_name();
+    int fd;
+    while(true){
+        fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+        if(fd == -1) return false;
+        flock(fd, LOCK_SH);
+        // the last process of the segment may have removed it while this one was waiting for the lock
+        int check_fd = shm_open(name.c_str(), O_RDWR, 0600);
+        struct stat info, check_info;
+        bool same = check_fd != -1 && fstat(fd, &info) == 0 && fstat(check_fd, &check_info) == 0
+                    && info.st_ino == check_info.st_ino && info.st_dev == check_info.st_dev;
+        if(check_fd != -1) close(check_fd);
+        if(same) break;
+        close(fd);
+    }
+
+    // the first process fills the segment under an exclusive lock, the others wait until it is ready
+    KLShmHeader* header = NULL;
+    bool usable = true;
+    auto map_segment = [&]{
+        struct stat info;
+        if(fstat(fd, &info) != 0 || info.st_size != layout.total_size){ usable = false; return; }
+        void* map = mmap(NULL, layout.total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(map == MAP_FAILED){ usable = false; return; }
+        header = (KLShmHeader*)map;
+        b_matrix = new int*[f_n];
+        for(uint64_t i = 0; i < f_n; i++) b_matrix[i] = (int*)((char*)map + layout.matrix_offset) + i * f_n;
+    };
+    while(usable){
+        struct stat info;
+        if(header == NULL && fstat(fd, &info) == 0 && info.st_size != 0) map_segment();
+        if(header != NULL && header->ready.load(memory_order_acquire) == 1) break;
+        flock(fd, LOCK_UN);
+        if(flock(fd, LOCK_EX | LOCK_NB) == 0){
+            if(fstat(fd, &info) != 0 || (info.st_size == 0 && ftruncate(fd, layout.total_size) != 0)) usable = false;
+            if(usable && header == NULL) map_segment();
+            // a new segment, or the process that was filling it died before finishing
+            if(usable && header->ready.load(memory_order_acquire) == 0){
+                memcpy(header->magic, K_L_SHM_MAGIC, 8);
+                header->n = current_sn_group;
+                header->slot_amount = layout.slot_amount;
+                header->matrix_offset = layout.matrix_offset; header->polynomials_offset = layout.polynomials_offset;
+                header->slots_offset = layout.slots_offset; header->pool_offset = layout.pool_offset;
+                header->total_size = layout.total_size;
+                header->entry_amount.store(0); header->pool_used.store(0);
+                bruhat_matrix_initiate();
+                header->ready.store(1, memory_order_release);
+            }
+            // the shared lock tells the others that this process still uses the segment
+            flock(fd, LOCK_SH);
+            break;
+        }
+        usleep(10000);
+        flock(fd, LOCK_SH);
+    }
+    if(usable && (memcmp(header->magic, K_L_SHM_MAGIC, 8) != 0 || header->n != current_sn_group || header->slot_amount != slot_amount)){
+        usable = false;
+    }
+    if(!usable){
+        printf("  Shared memory segment %s can not be used, every process keeps its own tables\n", name.c_str());
+        if(header != NULL){ delete[] b_matrix; b_matrix = NULL; munmap(header, layout.total_size); }
+        close(fd);
+        return false;
+    }
+
+    k_l_shm = header; shm_fd = fd; shm_attached_name = name;
+
+    static once_flag exit_handler;
+    call_once(exit_handler, []{ atexit(k_l_shm_detach); });
+    return true;
+}
+
+/* Detaches from the segment, 'b_matrix' is NULL afterwards. The segment is removed if no other process uses it. */
+void k_l_shm_detach(void){
+    if(k_l_shm == NULL) return;
+    delete[] b_matrix; b_matrix = NULL;
+    munmap(k_l_shm, k_l_shm->total_size); k_l_shm = NULL;
+
+    if(flock(shm_fd, LOCK_EX | LOCK_NB) == 0) shm_unlink(shm_attached_name.c_str());
+    close(shm_fd); shm_fd = -1;
+}
+
+/* Looks for P(u, v) inside the segment, pairs that another process is still writing are not found yet */
+bool k_l_shm_lookup(int u_index, int v_index, Polynomial& result){
+    if(k_l_shm == NULL) return false;
+    uint64_t key = (((uint64_t)u_index << 32) | (uint32_t)v_index) + 1;
+    KLShmSlot* slots = shm_slots(k_l_shm->slots_offset);
+    uint64_t mask = k_l_shm->slot_amount - 1;
+
+    for(uint64_t position = mix(key) & mask; ; position = (position + 1) & mask){
+        uint64_t slot_key = slots[position].key.load(memory_order_acquire);
+        if(slot_key == 0) return false;
+        if(slot_key != key) continue;
+        uint64_t value = slots[position].value.load(memory_order_acquire);
+        if(value == 0) return false;
+        const int32_t* terms = shm_terms(value);
+        result.coefficients.clear();
+        for(int k = 0; k < terms[0]; k++) result.coefficients[terms[1 + 2*k]] = terms[2 + 2*k];
+        return true;
+    }
+}
+
+/* Writes the terms of 'poly' into the pool once and returns its value for the slots, 0 if there is no room */
+static uint64_t shm_intern(const Polynomial& poly){
+    vector<int32_t> terms = {(int32_t)poly.coefficients.size()};
+    for(auto itr = poly.coefficients.begin(); itr != poly.coefficients.end(); itr++){
+        terms.push_back((int32_t)itr->first); terms.push_back((int32_t)itr->second);
+    }
+    size_t size = terms.size() * sizeof(int32_t);
+    uint64_t hash = 1469598103934665603ULL; /* FNV-1a */
+    for(size_t k = 0; k < size; k++) hash = (hash ^ ((const unsigned char*)terms.data())[k]) * 1099511628211ULL;
+    if(hash == 0) hash = 1;
+
+    KLShmSlot* slots = shm_slots(k_l_shm->polynomials_offset);
+    uint64_t mask = K_L_SHM_POLYNOMIALS - 1;
+    for(uint64_t position = mix(hash) & mask, probes = 0; probes < K_L_SHM_POLYNOMIALS; position = (position + 1) & mask, probes++){
+        uint64_t slot_hash = slots[position].key.load(memory_order_acquire);
+        if(slot_hash == 0){
+            // the pool space is reserved and written before the slot is claimed, so a claimed slot always gets its
+            // value right after, and a full pool leaves the slot empty for good. If another process claims the
+            // slot first, the reserved bytes are left unused, that only happens when both publish at once.
+            uint64_t offset = k_l_shm->pool_used.load();
+            do{
+                if(offset + size > K_L_SHM_POOL_SIZE) return 0;
+            } while(!k_l_shm->pool_used.compare_exchange_weak(offset, offset + size));
+            memcpy((char*)k_l_shm + k_l_shm->pool_offset + offset, terms.data(), size);
+            if(slots[position].key.compare_exchange_strong(slot_hash, hash)){
+                slots[position].value.store(offset + 1, memory_order_release);
+                return offset + 1;
+            }
+            if(slot_hash != hash) continue;
+        }
+        if(slot_hash != hash) continue;
+        // the same hash, the value is stored right after the slot is claimed, the terms are compared then
+        uint64_t value;
+        for(int spins = 0; (value = slots[position].value.load(memory_order_acquire)) == 0 && spins < 100000; spins++) sched_yield();
+        if(value != 0 && memcmp(shm_terms(value), terms.data(), size) == 0) return value;
+    }
+    return 0;
+}
+
+/* Shares P(u, v) with the other processes, nothing happens if the table is full. Any amount of threads may call this. */
+void k_l_shm_publish(int u_index, int v_index, const Polynomial& poly){
+    if(k_l_shm == NULL || k_l_shm->entry_amount.load(memory_order_relaxed) >= k_l_shm->slot_amount / 4 * 3) return;
+    if(k_l_shm->pool_used.load(memory_order_relaxed) >= K_L_SHM_POOL_SIZE) return;
+    uint64_t value = shm_intern(poly);
+    if(value == 0) return;
+
+    uint64_t key = (((uint64_t)u_index << 32) | (uint32_t)v_index) + 1;
+    KLShmSlot* slots = shm_slots(k_l_shm->slots_offset);
+    uint64_t mask = k_l_shm->slot_amount - 1;
+    for(uint64_t position = mix(key) & mask; ; position = (position + 1) & mask){
+        uint64_t slot_key = slots[position].key.load(memory_order_acquire);
+        if(slot_key == key) return; /* somebody else computed it as well */
+        if(slot_key != 0) continue;
+        if(slots[position].key.compare_exchange_strong(slot_key, key)){
+            slots[position].value.store(value, memory_order_release);
+            k_l_shm->entry_amount.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        if(slot_key == key) return;
+    }
+}
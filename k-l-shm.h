@@ -0,0 +1,97 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef K_L_SHM
+#define K_L_SHM
+/*--------------------------------*/
+#ifndef POLYNOMIALS
+#include "polynomials.h"
+#endif // !POLYNOMIALS
+/*--------------------------------*/
+#include <cstdint>
+#include <atomic>
+#include <string>
+#endif // !K_L_SHM
+
+#define K_L_SHM_MAGIC "KLSHM001"
+
+/* Upper limit for the amount of slots of the shared K-L table, it is sized by the group up to this */
+#define K_L_SHM_MAX_SLOTS (1 << 24)
+
+/* Slots for distinct polynomials and the bytes for their terms, there are only a few thousand even for S_8 */
+#define K_L_SHM_POLYNOMIALS (1 << 16)
+#define K_L_SHM_POOL_SIZE (64 << 20)
+
+/*
+ Every driver process of one user working on the same group on one machine shares a POSIX shared memory segment
+ '/KL-cache<number>-<user ID>', so the data that grows with the square of n! is kept once for the whole machine:
+   KLShmHeader
+   int b_matrix[n! * n!]                    rows of 'b_matrix' point in here, see "bruhat-matrix.h"
+   KLShmSlot polynomials[K_L_SHM_POLYNOMIALS] distinct polynomials, by the hash of their terms
+   KLShmSlot slots[slot_amount]             P(u, v) of every pair that some process computed, by the key of the pair
+   pool                                     for each distinct polynomial: int32_t term_amount, then term_amount
+                                            pairs of int32_t power and int32_t coefficient
+ The first process to attach fills 'b_matrix' while holding an exclusive flock on the segment, the others wait
+ for that and keep a shared flock as long as they are attached. The last one to leave removes the segment.
+
+ Slots are only ever filled, never changed or removed, so they are written with a compare and swap and read
+ without any lock. A polynomial published by one process is found by 'k_l_database_check' of every other one
+ right away. The disk database is still written by each process through its log, see "k-l-log.h", the segment
+ is only a cache and is lost when the last process leaves. When the table or the pool is full, new polynomials
+ are simply not shared anymore.
+*/
+
+// type definitions
+
+struct KLShmHeader
+{
+    char magic[8];
+    uint32_t n;
+    std::atomic<uint32_t> ready;      // 1 once 'b_matrix' is filled
+    uint64_t slot_amount;             // a power of 2
+    uint64_t matrix_offset, polynomials_offset, slots_offset, pool_offset, total_size;
+    std::atomic<uint64_t> entry_amount;
+    std::atomic<uint64_t> pool_used;  // bytes of the pool that are taken
+};
+
+/* 'key' is 0 while the slot is empty, 'value' is 0 until the slot is completely written */
+struct KLShmSlot
+{
+    std::atomic<uint64_t> key;    // (u_index << 32 | v_index) + 1 for pairs, the hash of the terms for polynomials
+    std::atomic<uint64_t> value;  // position inside the pool + 1
+};
+
+/*--------------------------Global variables, just their declerations-----------------------*/
+
+/* The header of the attached segment, NULL if this process is not attached to one */
+extern KLShmHeader* k_l_shm;
+
+/*------------------------------------------------------------------------------------------*/
+
+// function declarations
+
+std::string k_l_shm_name(void);
+
+bool k_l_shm_attach(void);
+
+void k_l_shm_detach(void);
+
+bool k_l_shm_lookup(int u_index, int v_index, Polynomial& result);
+
+void k_l_shm_publish(int u_index, int v_index, const Polynomial& poly);
@@ -0,0 +1,286 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "k-l-stack.h"
+#include <unistd.h>
+
+using namespace std;
+
+KLStackState k_l_stack_begin(int u_index, int v_index, bool check_database){
+    KLStackState state;
+    state.n = current_sn_group;
+    state.u_index = u_index; state.v_index = v_index;
+    state.check_database = check_database;
+    state.frames.push_back({u_index, v_index});
+    return state;
+}
+
+/* Pops the top frame and leaves its answer to the frame below, polynomials that needed the recursion are
+ * stored like 'polynom_k_l' does */
+static void frame_return(KLStackState& state){
+    KLStackFrame& frame = state.frames.back();
+    if(!frame.trivial){
+        temp_database_append({frame.u_index, frame.v_index}, frame.result);
+        greek_mu_table_record(frame.u_index, frame.v_index, all_p_len[frame.u_index], all_p_len[frame.v_index], frame.result.coefficients);
+    }
+    state.returned = std::move(frame.result);
+    state.has_returned = true;
+    state.frames.pop_back();
+}
+
+/* P(x, y) for the top frame, true if 'answer' is set. Otherwise (x, y) is pushed, the top frame is continued
+ * once it is popped again, with the answer inside 'returned'. References to frames are invalid after that. */
+static bool frame_ask(KLStackState& state, int x_index, int y_index, Polynomial& answer){
+    if(state.has_returned){
+        answer = std::move(state.returned);
+        state.has_returned = false;
+        return true;
+    }
+    uint32_t found_id = k_l_database_check_id(x_index, y_index);
+    if(found_id != 0){ answer = polynom_pool_at(found_id); return true; }
+    state.frames.push_back({x_index, y_index});
+    return false;
+}
+
+/* The first stage, the cases that are answered without the recursion are the same with 'polynom_k_l'.
+ * Returns false if the frame is answered already. */
+static bool frame_start(KLStackState& state, KLStackFrame& frame){
+    int max_len = (state.n * (state.n - 1)) / 2;
+    frame.trivial = true;
+    if(frame.u_index == frame.v_index){ frame.result = {{{0,1}}}; return false; }
+    if(b_matrix[frame.u_index][frame.v_index] == 0){ frame.result = {{{0,0}}}; return false; }
+    if(all_p_len[frame.v_index] == max_len){ frame.result = {{{0,1}}}; return false; }
+
+    // the representative is computed in place of the pair, it has the same polynomial, see "k-l-symmetry.h"
+    if(k_l_symmetry_ready()){
+        auto canonical = k_l_symmetry_canonical(frame.u_index, frame.v_index);
+        if(canonical != make_pair(frame.u_index, frame.v_index)){
+            frame.u_index = canonical.first; frame.v_index = canonical.second;
+            return frame_start(state, frame);
+        }
+    }
+    // frames above the first one are only pushed after the database did not have them
+    if(state.frames.size() == 1 && state.check_database){
+        uint32_t found_id = k_l_database_check_id(frame.u_index, frame.v_index);
+        if(found_id != 0){ frame.result = polynom_pool_at(found_id); return false; }
+    }
+    frame.trivial = false;
+    K_L_STATS_ADD(K_L_STATS_FRAMES, 1);
+    K_L_STATS_MAX(K_L_STATS_MAX_DEPTH, state.frames.size());
+    k_l_progress_pair();
+
+    const vector<int>& u = all_p[frame.u_index];
+    frame.i = permt_first_right_descent(all_p[frame.v_index]) - 1; /* -1 is for index*/
+    frame.c = u[frame.i] > u[frame.i + 1] ? 1 : 0;
+    frame.z_index = 0;
+    frame.stage = K_L_STACK_SHIFTED;
+    return true;
+}
+
+/*
+ Runs the frame on top of the stack, and the ones below it as they get their answers, until a pair has to be
+ computed first or the stack is empty. Returns true when the stack is empty, P(u, v) is in 'returned' then.
+*/
+bool k_l_stack_step(KLStackState& state){
+    if(state.frames.empty()) return true;
+    state.steps++;
+    Polynomial answer;
+    while(!state.frames.empty()){
+        KLStackFrame& frame = state.frames.back();
+        if(frame.stage == K_L_STACK_START && !frame_start(state, frame)){
+            frame_return(state);
+            continue;
+        }
+        int u_index = frame.u_index, v_index = frame.v_index, i = frame.i;
+        // v*s_i, the frame does not keep it
+        int vs_index = permt_right_multp_index(all_p[v_index], v_index, i + 1);
+
+        switch(frame.stage){
+        case K_L_STACK_SHIFTED:
+            // adding q^(1-c) * P(u*s_i , v*s_i)
+            if(!frame_ask(state, permt_right_multp_index(all_p[u_index], u_index, i + 1), vs_index, answer)) return false;
+            frame.result = polynom_add(frame.result, polynom_multiply({{{1 - frame.c, 1}}}, answer));
+            frame.stage = K_L_STACK_LOWER;
+            break;
+
+        case K_L_STACK_LOWER:
+            // adding q^c * P(u, v*s_i)
+            if(!frame_ask(state, u_index, vs_index, answer)) return false;
+            frame.result = polynom_add(frame.result, polynom_multiply({{{frame.c, 1}}}, answer));
+            frame.stage = K_L_STACK_Z_NEXT;
+            break;
+
+        case K_L_STACK_Z_NEXT: {
+            // the next u <= z <= v with z(i) > z(i+1), 'b_matrix' is 0 on its diagonal. Only indexes from u to v
+            // with the descent are looked at, see 'bruhat_matrix_interval_descents'. Without the descent tables of
+            // the group every index from u to v is tried instead, like that function does.
+            const vector<uint64_t>* bits = NULL;
+            if(i < all_p_descent_bits.size() && all_p_descent_bits[i].size() * 64 >= all_p.size()) bits = &all_p_descent_bits[i];
+            auto next_z = [&](int from){
+                if(bits != NULL) return permt_bits_next(*bits, from, v_index);
+                for(int z_index = from; z_index <= v_index; z_index++){
+                    if(all_p[z_index][i] > all_p[z_index][i + 1]) return z_index;
+                }
+                return -1;
+            };
+            int z_index = next_z(max(frame.z_index, u_index));
+            for(; z_index != -1; z_index = next_z(z_index + 1)){
+                K_L_STATS_ADD(K_L_STATS_Z_ITERATIONS, 1);
+                if(z_index != u_index && b_matrix[u_index][z_index] == 0) continue;
+                if(z_index != v_index && b_matrix[z_index][v_index] == 0) continue;
+                break;
+            }
+            if(z_index == -1){ frame_return(state); break; }
+            K_L_STATS_ADD(K_L_STATS_Z_DESCENTS, 1);
+            frame.z_index = z_index;
+            frame.stage = K_L_STACK_Z_MU;
+            break;
+        }
+
+        case K_L_STACK_Z_MU: {
+            // μ(z, v*s_i) is the coefficient of q^[(l(v*s_i) - l(z) - 1) / 2] inside P(z, v*s_i), see 'polynom_greek_mu'
+            int z_index = frame.z_index, z_len = all_p_len[z_index], vs_len = all_p_len[vs_index], mu = 0;
+            if(!state.has_returned) K_L_STATS_ADD(K_L_STATS_MU_CALLS, 1);
+            if(b_matrix[z_index][vs_index] == 0 || (vs_len - z_len) % 2 == 0) frame.mu = 0;
+            else if(!state.has_returned && greek_mu_table_lookup(z_index, vs_index, mu)){
+                K_L_STATS_ADD(K_L_STATS_MU_TABLE_HITS, 1);
+                frame.mu = mu;
+            }
+            else{
+                if(!frame_ask(state, z_index, vs_index, answer)) return false;
+                greek_mu_table_record(z_index, vs_index, z_len, vs_len, answer.coefficients);
+                auto wanted_coefficient = answer.coefficients.find((vs_len - z_len - 1) / 2.0);
+                frame.mu = wanted_coefficient != answer.coefficients.end() ? wanted_coefficient->second : 0;
+            }
+            if(frame.mu == 0){ frame.z_index++; frame.stage = K_L_STACK_Z_NEXT; }
+            else frame.stage = K_L_STACK_Z_POLY;
+            break;
+        }
+
+        case K_L_STACK_Z_POLY: {
+            // subtracting μ(z, v*s_i) * q^[(l_v - l_z)/2] * P(u,z)
+            int z_index = frame.z_index;
+            if(!frame_ask(state, u_index, z_index, answer)) return false;
+            int power = (all_p_len[v_index] - all_p_len[z_index]) / 2;
+            frame.result = polynom_subtract(frame.result, polynom_multiply({{{(float)power, frame.mu}}}, answer));
+            frame.z_index++;
+            frame.stage = K_L_STACK_Z_NEXT;
+            break;
+        }
+        }
+    }
+    return true;
+}
+
+/* Steps the state until it is done, or at most 'step_limit' times if it is not 0. True iff it is done. */
+bool k_l_stack_run(KLStackState& state, uint64_t step_limit){
+    for(uint64_t k = 0; !k_l_stack_done(state) && (step_limit == 0 || k < step_limit); k++) k_l_stack_step(state);
+    return k_l_stack_done(state);
+}
+
+/* Gives every state that is not done 'slice' steps in turns, until all of them are done */
+void k_l_stack_interleave(vector<KLStackState>& states, uint64_t slice){
+    bool remaining = true;
+    while(remaining){
+        remaining = false;
+        for(auto itr = states.begin(); itr != states.end(); itr++){
+            if(!k_l_stack_run(*itr, slice)) remaining = true;
+        }
+    }
+}
+
+// Every term, zero coefficients included, so a loaded polynomial is the same map: "<amount> power:coefficient ..."
+static void write_polynomial(FILE* file, const Polynomial& poly){
+    fprintf(file, "%zu", poly.coefficients.size());
+    for(auto itr = poly.coefficients.begin(); itr != poly.coefficients.end(); itr++) fprintf(file, " %.9g:%.9g", itr->first, itr->second);
+}
+
+static bool read_polynomial(FILE* file, Polynomial& poly){
+    size_t amount;
+    poly.coefficients.clear();
+    if(fscanf(file, "%zu", &amount) != 1) return false;
+    for(size_t k = 0; k < amount; k++){
+        float power, coefficient;
+        if(fscanf(file, " %f:%f", &power, &coefficient) != 2) return false;
+        poly.coefficients[power] = coefficient;
+    }
+    return true;
+}
+
+/* The checkpoint is replaced at once, an interrupted write leaves the previous one, see "k-l-stack.h" for the format */
+bool k_l_stack_save(const KLStackState& state, string file_name){
+    string temp_path = file_name + ".tmp" + to_string(getpid());
+    FILE* file = fopen(temp_path.c_str(), "w");
+    if(file == NULL) return false;
+    fprintf(file, "KL-stack 1\nn %d\npair %d %d %d\nsteps %llu\nreturned %d ", state.n, state.u_index, state.v_index,
+            (int)state.check_database, (unsigned long long)state.steps, (int)state.has_returned);
+    write_polynomial(file, state.returned);
+    fprintf(file, "\nframes %zu\n", state.frames.size());
+    for(auto itr = state.frames.begin(); itr != state.frames.end(); itr++){
+        fprintf(file, "%d %d %d %d %d %d %.9g %d ", itr->u_index, itr->v_index, itr->stage, itr->i, itr->c, itr->z_index,
+                itr->mu, (int)itr->trivial);
+        write_polynomial(file, itr->result);
+        fprintf(file, "\n");
+    }
+    bool written = fflush(file) == 0 && fsync(fileno(file)) == 0;
+    written = (fclose(file) == 0) && written;
+    if(!written || rename(temp_path.c_str(), file_name.c_str()) != 0){ remove(temp_path.c_str()); return false; }
+    return true;
+}
+
+/* Reads a checkpoint of the group in 'current_sn_group', false if there is none or it is not usable */
+bool k_l_stack_load(KLStackState& state, string file_name){
+    FILE* file = fopen(file_name.c_str(), "r");
+    if(file == NULL) return false;
+    KLStackState loaded;
+    int version = 0, check_database = 0, has_returned = 0;
+    unsigned long long steps = 0;
+    size_t frame_amount = 0;
+    bool valid = fscanf(file, "KL-stack %d n %d pair %d %d %d steps %llu returned %d ", &version, &loaded.n,
+                        &loaded.u_index, &loaded.v_index, &check_database, &steps, &has_returned) == 7;
+    valid = valid && version == 1 && loaded.n == current_sn_group && read_polynomial(file, loaded.returned);
+    valid = valid && fscanf(file, " frames %zu", &frame_amount) == 1;
+    int f_n = all_p.size();
+    for(size_t k = 0; valid && k < frame_amount; k++){
+        KLStackFrame frame;
+        int trivial = 0;
+        valid = fscanf(file, "%d %d %d %d %d %d %f %d ", &frame.u_index, &frame.v_index, &frame.stage, &frame.i, &frame.c,
+                       &frame.z_index, &frame.mu, &trivial) == 8 && read_polynomial(file, frame.result);
+        valid = valid && frame.u_index >= 0 && frame.u_index < f_n && frame.v_index >= 0 && frame.v_index < f_n;
+        valid = valid && frame.stage >= K_L_STACK_START && frame.stage <= K_L_STACK_Z_POLY;
+        valid = valid && frame.i >= 0 && frame.i < loaded.n - 1;
+        valid = valid && frame.z_index >= 0 && frame.z_index <= f_n;
+        frame.trivial = trivial != 0;
+        loaded.frames.push_back(std::move(frame));
+    }
+    fclose(file);
+    if(!valid) return false;
+    loaded.check_database = check_database != 0;
+    loaded.steps = steps;
+    loaded.has_returned = has_returned != 0;
+    state = std::move(loaded);
+    return true;
+}
+
+/* P(u, v) by the explicit stack, the same with 'polynom_k_l' without its depth limit */
+Polynomial polynom_k_l_stack(const vector<int>& u, const vector<int>& v){
+    KLStackState state = k_l_stack_begin(permt_rank(u), permt_rank(v));
+    k_l_stack_run(state);
+    return state.returned;
+}
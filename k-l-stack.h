@@ -0,0 +1,113 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef K_L_STACK
+#define K_L_STACK
+/*--------------------------------*/
+#ifndef K_L_QUERY
+#include "k-l-query.h"
+#endif // !K_L_QUERY
+/*--------------------------------*/
+#include <cstdint>
+#include <string>
+#include <vector>
+#endif // !K_L_STACK
+
+/* Steps between two checkpoints of the driver, see '--stack' inside "main-driver.cpp" */
+#define K_L_STACK_CHECKPOINT_STEPS 100000
+
+/*
+ The same recursion with 'polynom_k_l', on an explicit stack of frames instead of the native one, so the depth
+ is only limited by the memory. A frame is the pair (u, v) and where its computation is: which of P(u*s, v*s),
+ P(u, v*s) it waits for, or the z it has reached inside the sum over u <= z <= v. Nothing else is kept, the
+ interval is walked again from the z a frame stopped at, so the whole state is a few integers and the partial
+ result of every frame.
+
+ 'k_l_stack_step' runs the top frame until it finishes or needs a pair that is not inside any database, that
+ pair is pushed and the step ends. Computations can be stopped after any step, written to a checkpoint file by
+ 'k_l_stack_save' and continued later, in another process, after 'k_l_stack_load'. Many states can be stepped
+ in turns on one thread, see 'k_l_stack_interleave', they share the databases like successive 'polynom_k_l'
+ calls do. The global tables of 'current_sn_group' are used, 'permt_index_tables_initiate' included, so only one
+ thread may step states at a time.
+
+ The checkpoint is a text file:
+         KL-stack 1
+         n <number>
+         pair <u_index> <v_index> <check_database>
+         steps <steps done so far>
+         returned <0 or 1> <polynomial>
+         frames <amount>
+ followed by one line for each frame, from the bottom of the stack to its top:
+         <u_index> <v_index> <stage> <i> <c> <z_index> <mu> <trivial> <partial result>
+ Polynomials are "power:coefficient" terms as in "k-l-query.h". Finished pairs are inside the log already, they
+ do not need to be in the checkpoint.
+*/
+
+// type definitions
+
+enum KLStackStage
+{
+    K_L_STACK_START,     // nothing is done yet
+    K_L_STACK_SHIFTED,   // waits for P(u*s_i, v*s_i)
+    K_L_STACK_LOWER,     // waits for P(u, v*s_i)
+    K_L_STACK_Z_NEXT,    // looks for the next z from 'z_index' on
+    K_L_STACK_Z_MU,      // waits for P(z, v*s_i), to find μ(z, v*s_i)
+    K_L_STACK_Z_POLY     // waits for P(u, z), μ(z, v*s_i) is in 'mu'
+};
+
+struct KLStackFrame
+{
+    int u_index, v_index;
+    int stage = K_L_STACK_START;
+    int i = 0, c = 0;              // the first right descent of v and whether u has it, as in 'polynom_k_l'
+    int z_index = 0;
+    float mu = 0;
+    bool trivial = false;          // the answer did not need the recursion, it is not stored anywhere
+    Polynomial result;
+};
+
+struct KLStackState
+{
+    int n = 0;
+    int u_index = -1, v_index = -1;
+    bool check_database = true;
+    uint64_t steps = 0;
+    std::vector<KLStackFrame> frames;
+    bool has_returned = false;     // the last popped frame left its answer in 'returned' for the one below
+    Polynomial returned;
+};
+
+// function declarations
+
+KLStackState k_l_stack_begin(int u_index, int v_index, bool check_database = true);
+
+inline bool k_l_stack_done(const KLStackState& state){ return state.frames.empty(); }
+
+bool k_l_stack_step(KLStackState& state);
+
+bool k_l_stack_run(KLStackState& state, uint64_t step_limit = 0);
+
+void k_l_stack_interleave(std::vector<KLStackState>& states, uint64_t slice);
+
+bool k_l_stack_save(const KLStackState& state, std::string file_name);
+
+bool k_l_stack_load(KLStackState& state, std::string file_name);
+
+Polynomial polynom_k_l_stack(const std::vector<int>& u, const std::vector<int>& v);
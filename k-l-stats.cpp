@@ -0,0 +1,118 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "k-l-stats.h"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+/* GLOBAL VARIABLES --------------- */
+
+thread_local KLStatsCounters* k_l_stats_thread = NULL;
+
+// counters of every thread that counted something, they outlive their threads so the report sees them
+static mutex stats_lock;
+static vector<unique_ptr<KLStatsCounters>> stats_threads;
+
+/*--------------------------------- */
+
+static const char* counter_names[K_L_STATS_COUNTER_AMOUNT] = {
+    "frames", "parallel_frames", "max_depth",
+    "hits_k_l_database", "hits_temp_database", "hits_store", "hits_shm", "misses",
+    "mu_calls", "mu_table_hits",
+    "intervals", "interval_sizes", "interval_max",
+    "z_iterations", "z_descents",
+    "polynom_add", "polynom_subtract", "polynom_multiply",
+    "group_init_ns", "matrix_load_ns", "recursion_ns", "persistence_ns"
+};
+
+KLStatsCounters* k_l_stats_register(void){
+    lock_guard<mutex> guard(stats_lock);
+    stats_threads.push_back(make_unique<KLStatsCounters>());
+    k_l_stats_thread = stats_threads.back().get();
+    return k_l_stats_thread;
+}
+
+const char* k_l_stats_counter_name(int counter){
+    return counter_names[counter];
+}
+
+// maxima are not added up when the threads are merged
+static bool is_maximum(int counter){
+    return counter == K_L_STATS_MAX_DEPTH || counter == K_L_STATS_INTERVAL_MAX;
+}
+
+/* Sum of the counters of every thread, call it while nothing is counting */
+KLStatsCounters k_l_stats_merge(int& thread_amount){
+    KLStatsCounters total;
+    lock_guard<mutex> guard(stats_lock);
+    thread_amount = stats_threads.size();
+    for(auto itr = stats_threads.begin(); itr != stats_threads.end(); itr++){
+        for(int k = 0; k < K_L_STATS_COUNTER_AMOUNT; k++){
+            if(is_maximum(k)) total.values[k] = max(total.values[k], (*itr)->values[k]);
+            else total.values[k] += (*itr)->values[k];
+        }
+    }
+    return total;
+}
+
+/* Writes the merged counters and those of each thread as JSON */
+bool k_l_stats_write(string path){
+    FILE* ofp = fopen(path.c_str(), "w");
+    if(ofp == NULL) return false;
+    int thread_amount;
+    KLStatsCounters total = k_l_stats_merge(thread_amount);
+    auto write_counters = [ofp](const KLStatsCounters& counters){
+        fprintf(ofp, "{");
+        for(int k = 0; k < K_L_STATS_COUNTER_AMOUNT; k++){
+            fprintf(ofp, "%s\"%s\": %llu", k ? ", " : "", counter_names[k], (unsigned long long)counters.values[k]);
+        }
+        fprintf(ofp, "}");
+    };
+    fprintf(ofp, "{\n  \"version\": 1,\n  \"threads\": %d,\n  \"total\": ", thread_amount);
+    write_counters(total);
+    fprintf(ofp, ",\n  \"per_thread\": [\n");
+    lock_guard<mutex> guard(stats_lock);
+    for(size_t k = 0; k < stats_threads.size(); k++){
+        fprintf(ofp, "    ");
+        write_counters(*stats_threads[k]);
+        fprintf(ofp, "%s\n", k + 1 < stats_threads.size() ? "," : "");
+    }
+    fprintf(ofp, "  ]\n}\n");
+    return fclose(ofp) == 0;
+}
+
+#ifdef K_L_INSTRUMENT
+static void write_at_exit(void){
+    const char* path = getenv("K_L_STATS_FILE");
+    string file = path != NULL ? path : "KL-stats.json";
+    if(k_l_stats_write(file)) fprintf(stderr, "  Instrumentation counters are written to %s\n", file.c_str());
+}
+#endif
+
+/* Makes the program write the report when it exits, nothing happens if the counters are compiled out */
+void k_l_stats_report_at_exit(void){
+#ifdef K_L_INSTRUMENT
+    atexit(write_at_exit);
+#endif
+}
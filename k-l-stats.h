@@ -0,0 +1,137 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef K_L_STATS
+#define K_L_STATS
+/*--------------------------------*/
+#include <cstdint>
+#include <chrono>
+#include <string>
+#endif // !K_L_STATS
+
+/*
+ Counters of the hot paths, compiled in only when K_L_INSTRUMENT is defined, for example with
+         make CC="g++ -std=c++20 -DK_L_INSTRUMENT"
+ Otherwise every K_L_STATS_* macro below is empty and nothing is counted, so there is no cost at all.
+
+ Each thread counts into its own KLStatsCounters without any locking, they are merged when the report is
+ written. The driver writes the report when it exits, to the file named by the environment variable
+ K_L_STATS_FILE or to 'KL-stats.json'. Times are in nanoseconds, the group initiation includes the matrix
+ load, and the recursion is only timed for the outermost frame of each thread.
+*/
+
+// type definitions
+
+enum KLStatsCounter
+{
+    K_L_STATS_FRAMES,           // polynom_k_l calls that were not answered without recursion
+    K_L_STATS_PARALLEL_FRAMES,  // pairs computed by 'k_l_parallel_compute'
+    K_L_STATS_MAX_DEPTH,        // deepest nesting of polynom_k_l frames on one thread
+    K_L_STATS_HIT_DATABASE,     // k_l_database_check answered by k_l_database
+    K_L_STATS_HIT_TEMP,         // by temp_database
+    K_L_STATS_HIT_STORE,        // by the binary database or its shards
+    K_L_STATS_HIT_SHM,          // by the shared memory segment
+    K_L_STATS_MISS,             // not found anywhere
+    K_L_STATS_MU_CALLS,         // polynom_greek_mu calls
+    K_L_STATS_MU_TABLE_HITS,    // ... answered by 'greek_mu_rows'
+    K_L_STATS_INTERVALS,        // bruhat_matrix_interval calls
+    K_L_STATS_INTERVAL_SIZES,   // sum of their sizes
+    K_L_STATS_INTERVAL_MAX,     // the largest one
+    K_L_STATS_Z_ITERATIONS,     // z with the descent compared with u and v by the loop of polynom_k_l
+    K_L_STATS_Z_DESCENTS,       // ... of which were inside the interval, so μ was needed
+    K_L_STATS_POLY_ADD,
+    K_L_STATS_POLY_SUBTRACT,
+    K_L_STATS_POLY_MULTIPLY,
+    K_L_STATS_NS_GROUP_INIT,
+    K_L_STATS_NS_MATRIX_LOAD,
+    K_L_STATS_NS_RECURSION,
+    K_L_STATS_NS_PERSISTENCE,
+    K_L_STATS_COUNTER_AMOUNT
+};
+
+struct KLStatsCounters
+{
+    uint64_t values[K_L_STATS_COUNTER_AMOUNT] = {};
+    int depth = 0;
+    std::chrono::steady_clock::time_point frame_start;
+};
+
+/*--------------------------Global variables, just their declerations-----------------------*/
+
+/* Counters of the calling thread, NULL until it counts something for the first time */
+extern thread_local KLStatsCounters* k_l_stats_thread;
+
+/*------------------------------------------------------------------------------------------*/
+
+// function declarations
+
+KLStatsCounters* k_l_stats_register(void);
+
+inline KLStatsCounters* k_l_stats_local(void){
+    return k_l_stats_thread != NULL ? k_l_stats_thread : k_l_stats_register();
+}
+
+const char* k_l_stats_counter_name(int counter);
+
+KLStatsCounters k_l_stats_merge(int& thread_amount);
+
+bool k_l_stats_write(std::string path);
+
+void k_l_stats_report_at_exit(void);
+
+/* Adds the time spent inside its scope to one of the K_L_STATS_NS_* counters */
+struct KLStatsPhase
+{
+    int counter;
+    std::chrono::steady_clock::time_point start;
+    KLStatsPhase(int c) : counter(c), start(std::chrono::steady_clock::now()) {}
+    ~KLStatsPhase(){
+        k_l_stats_local()->values[counter] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+/* One frame of the recursion, counts it and keeps the depth, the outermost frame is timed */
+struct KLStatsFrame
+{
+    KLStatsCounters* counters;
+    KLStatsFrame() : counters(k_l_stats_local()) {
+        counters->values[K_L_STATS_FRAMES]++;
+        if(++counters->depth > (int)counters->values[K_L_STATS_MAX_DEPTH]) counters->values[K_L_STATS_MAX_DEPTH] = counters->depth;
+        if(counters->depth == 1) counters->frame_start = std::chrono::steady_clock::now();
+    }
+    ~KLStatsFrame(){
+        if(counters->depth-- == 1){
+            counters->values[K_L_STATS_NS_RECURSION] +=
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - counters->frame_start).count();
+        }
+    }
+};
+
+#ifdef K_L_INSTRUMENT
+#define K_L_STATS_ADD(counter, amount) (k_l_stats_local()->values[counter] += (amount))
+#define K_L_STATS_MAX(counter, value) { KLStatsCounters* k_l_stats_c = k_l_stats_local(); \
+                                        if((uint64_t)(value) > k_l_stats_c->values[counter]) k_l_stats_c->values[counter] = (value); }
+#define K_L_STATS_PHASE(counter) KLStatsPhase k_l_stats_phase(counter)
+#define K_L_STATS_FRAME() KLStatsFrame k_l_stats_frame
+#else
+#define K_L_STATS_ADD(counter, amount) ((void)0)
+#define K_L_STATS_MAX(counter, value) ((void)0)
+#define K_L_STATS_PHASE(counter) ((void)0)
+#define K_L_STATS_FRAME() ((void)0)
+#endif
@@ -0,0 +1,501 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "k-l-store.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sys/file.h>
+
+using namespace std;
+
+/* GLOBAL VARIABLES --------------- */
+
+KLStore k_l_store;
+std::vector<KLStore> k_l_store_segments;
+KLShardManifest k_l_shard_manifest;
+std::vector<std::vector<KLStore>> k_l_shard_stores;
+int k_l_shard_run = -1;
+
+static int run_lock_fd = -1;   // the lock of 'k_l_shard_run', held as long as the process uses that run
+static int run_lock_group = 0; // the group that the run lock belongs to
+
+/*--------------------------------- */
+
+// "KL-database" becomes "KL-database<number>.bin", the number comes from 'current_sn_group'
+string k_l_store_file_name(string file_name){
+    ostringstream s; s << file_name << current_sn_group << ".bin";
+    return s.str();
+}
+
+// size of the ID array inside the file, padded so that the next part stays aligned to 8 bytes
+static size_t ids_size(uint64_t entry_amount){
+    return (entry_amount * sizeof(uint32_t) + 7) / 8 * 8;
+}
+
+// decodes the polynomial with the given ID inside the file
+static Polynomial store_polynomial(const KLStore& store, uint64_t file_id){
+    const int32_t* record = (const int32_t*)(store.blob + store.polynomial_offsets[file_id]);
+    Polynomial result;
+    for(int k = 0; k < record[0]; k++) result.coefficients[record[1 + 2*k]] = record[2 + 2*k];
+    return result;
+}
+
+/*
+ Checks that every section named by 'header' lies inside a file of 'file_size' bytes, and that every polynomial
+ record lies inside the blob. The counts are checked against the bytes left before they are multiplied, so a
+ damaged header can not overflow the sizes. IDs of the pairs are checked by the lookups, see 'k_l_store_find_id',
+ reading all of them here would read every page of the file.
+*/
+static bool store_sections_valid(const KLStoreHeader* header, size_t file_size){
+    size_t left = file_size - sizeof(KLStoreHeader);
+    if(header->entry_amount > left / (sizeof(uint64_t) + sizeof(uint32_t))) return false;
+    left -= header->entry_amount * sizeof(uint64_t) + ids_size(header->entry_amount);
+    if(header->polynomial_amount > left / sizeof(uint64_t)) return false;
+    left -= header->polynomial_amount * sizeof(uint64_t);
+    if(header->blob_size > left) return false;
+
+    const uint64_t* polynomial_offsets = (const uint64_t*)((const char*)(header + 1) + header->entry_amount * sizeof(uint64_t)
+                                                           + ids_size(header->entry_amount));
+    const char* blob = (const char*)(polynomial_offsets + header->polynomial_amount);
+    for(uint64_t k = 0; k < header->polynomial_amount; k++){
+        uint64_t offset = polynomial_offsets[k];
+        if(offset % sizeof(int32_t) != 0 || header->blob_size < sizeof(int32_t) || offset > header->blob_size - sizeof(int32_t)) return false;
+        int32_t term_amount = *(const int32_t*)(blob + offset);
+        if(term_amount < 0 || (uint64_t)term_amount > (header->blob_size - offset - sizeof(int32_t)) / (2 * sizeof(int32_t))) return false;
+    }
+    return true;
+}
+
+/*
+ Maps the binary database at 'path' into 'store', returns false if there is no such file or the file does not
+ belong to S_n, the current group by default. Only the distinct polynomials are read, and added to 'polynom_pool', pages
+ holding the pairs are read from the disk when a lookup touches them.
+*/
+bool k_l_store_map(KLStore& store, string path, int n){
+    k_l_store_unmap(store);
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd == -1) return false;
+
+    struct stat file_info;
+    if(fstat(fd, &file_info) == -1 || file_info.st_size < sizeof(KLStoreHeader)){ close(fd); return false; }
+    void* map = mmap(NULL, file_info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if(map == MAP_FAILED){ close(fd); return false; }
+
+    const KLStoreHeader* header = (const KLStoreHeader*)map;
+    if(memcmp(header->magic, K_L_STORE_MAGIC, 8) != 0 || header->n != n || !store_sections_valid(header, file_info.st_size)){
+        printf("  %s is not a valid K-L database for S_%d, ignoring it\n", path.c_str(), n);
+        munmap(map, file_info.st_size); close(fd);
+        return false;
+    }
+
+    store.fd = fd; store.map = map; store.map_size = file_info.st_size;
+    store.header = header;
+    store.keys = (const uint64_t*)((const char*)map + sizeof(KLStoreHeader));
+    store.ids = (const uint32_t*)(store.keys + header->entry_amount);
+    store.polynomial_offsets = (const uint64_t*)((const char*)store.ids + ids_size(header->entry_amount));
+    store.blob = (const char*)(store.polynomial_offsets + header->polynomial_amount);
+
+    store.pool_ids.resize(header->polynomial_amount);
+    for(uint64_t k = 0; k < header->polynomial_amount; k++) store.pool_ids[k] = polynom_pool_intern(store_polynomial(store, k));
+    return true;
+}
+
+void k_l_store_unmap(KLStore& store){
+    if(store.header == NULL) return;
+    munmap(store.map, store.map_size); close(store.fd);
+    store = KLStore();
+}
+
+/* Looks for P(u, v) inside 'store' with a binary search over the keys, returns its ID inside 'polynom_pool'
+ * or 0 if the pair is not inside the store. Nothing is allocated. */
+uint32_t k_l_store_find_id(const KLStore& store, int u_index, int v_index){
+    if(store.header == NULL) return 0;
+    uint64_t key = ((uint64_t)u_index << 32) | (uint32_t)v_index;
+    const uint64_t* keys_end = store.keys + store.header->entry_amount;
+    const uint64_t* fitr = lower_bound(store.keys, keys_end, key);
+    if(fitr == keys_end || *fitr != key) return 0;
+    uint32_t file_id = store.ids[fitr - store.keys];
+    return file_id < store.pool_ids.size() ? store.pool_ids[file_id] : 0;
+}
+
+/* Every entry of 'store', with IDs inside 'polynom_pool' */
+vector<pair<uint64_t, uint32_t>> k_l_store_all_entries(const KLStore& store){
+    vector<pair<uint64_t, uint32_t>> result;
+    if(store.header == NULL) return result;
+    result.reserve(store.header->entry_amount);
+    for(uint64_t k = 0; k < store.header->entry_amount; k++){
+        if(store.ids[k] < store.pool_ids.size()) result.push_back({store.keys[k], store.pool_ids[store.ids[k]]});
+    }
+    return result;
+}
+
+// "KL-database7.bin" and 2 become "KL-database7.bin.2", segment 0 is the file itself
+string k_l_store_segment_name(string path, int segment){
+    return segment == 0 ? path : path + "." + to_string(segment);
+}
+
+/* Names of the segments of the database at 'path' that are on the disk, oldest first. See 'k_l_store_add_segment'. */
+vector<string> k_l_store_segment_names(string path){
+    vector<string> result;
+    while(access(k_l_store_segment_name(path, result.size()).c_str(), F_OK) == 0) result.push_back(k_l_store_segment_name(path, result.size()));
+    return result;
+}
+
+/*
+ Maps every segment of the database at 'path' after the first one into 'segments', the first one is mapped with
+ 'k_l_store_map'. The newest is mapped first: a segment that another process merges away meanwhile has its pairs
+ inside an older one by the time it is removed, so they are found there.
+*/
+void k_l_store_map_segments(vector<KLStore>& segments, string path, int n){
+    for(auto itr = segments.begin(); itr != segments.end(); itr++) k_l_store_unmap(*itr);
+    segments.clear();
+    vector<string> names = k_l_store_segment_names(path);
+    for(int k = (int)names.size() - 1; k >= 1; k--){
+        KLStore store;
+        if(k_l_store_map(store, names[k], n)) segments.push_back(store);
+    }
+}
+
+/* Maps the binary database of the current group into 'k_l_store' and its other segments into 'k_l_store_segments',
+ * and the shards listed in its manifest if there is one, see 'k_l_shards_open'. Returns false if there is no
+ * unsharded database file. */
+bool k_l_store_open(string file_name){
+    k_l_shards_open(file_name);
+    k_l_store_map_segments(k_l_store_segments, k_l_store_file_name(file_name));
+    return k_l_store_map(k_l_store, k_l_store_file_name(file_name));
+}
+
+void k_l_store_close(void){
+    k_l_store_unmap(k_l_store);
+    for(auto itr = k_l_store_segments.begin(); itr != k_l_store_segments.end(); itr++) k_l_store_unmap(*itr);
+    k_l_store_segments.clear();
+    k_l_shards_close();
+}
+
+/* Looks for P(u, v) inside 'k_l_store', its segments and then inside the shards that 'v_index' belongs to.
+ * Returns its ID inside 'polynom_pool' or 0 if the pair is not stored anywhere. */
+uint32_t k_l_store_lookup_id(int u_index, int v_index){
+    uint32_t id = k_l_store_find_id(k_l_store, u_index, v_index);
+    for(auto itr = k_l_store_segments.begin(); itr != k_l_store_segments.end() && id == 0; itr++) id = k_l_store_find_id(*itr, u_index, v_index);
+    if(id != 0 || k_l_shard_stores.empty()) return id;
+    const vector<KLStore>& stores = k_l_shard_stores[k_l_shard_of(v_index)];
+    for(auto itr = stores.begin(); itr != stores.end() && id == 0; itr++) id = k_l_store_find_id(*itr, u_index, v_index);
+    return id;
+}
+
+// The same with 'k_l_store_lookup_id', but returns the polynomial itself. Returns false if the pair is not inside the store.
+bool k_l_store_lookup(int u_index, int v_index, Polynomial& result){
+    uint32_t id = k_l_store_lookup_id(u_index, v_index);
+    if(id == 0) return false;
+    result = polynom_pool_get(id);
+    return true;
+}
+
+/*
+ Writes the given (key, ID inside 'polynom_pool') pairs as a binary database to 'path'. The data is written to
+ a temporary file first which is then renamed, so a crash never leaves a half written database behind.
+ If the same key appears more than once, the last one is kept.
+*/
+bool k_l_store_write(string path, vector<pair<uint64_t, uint32_t>> entries){
+    stable_sort(entries.begin(), entries.end(), [](const pair<uint64_t, uint32_t>& a, const pair<uint64_t, uint32_t>& b){
+        return a.first < b.first;
+    });
+    vector<uint64_t> keys; vector<uint32_t> ids;
+    for(auto itr = entries.begin(); itr != entries.end(); itr++){
+        if(!keys.empty() && keys.back() == itr->first) ids.back() = itr->second;
+        else{ keys.push_back(itr->first); ids.push_back(itr->second); }
+    }
+    while(ids.size() * sizeof(uint32_t) < ids_size(keys.size())) ids.push_back(0);
+
+    // every polynomial that is used gets an ID inside the file, in the order of their first use
+    unordered_map<uint32_t, uint32_t> file_ids;
+    vector<uint64_t> polynomial_offsets; vector<int32_t> blob;
+    for(uint64_t k = 0; k < keys.size(); k++){
+        auto result = file_ids.insert({ids[k], (uint32_t)file_ids.size()});
+        if(result.second){
+            Polynomial temp_poly = polynom_pool_get(ids[k]);
+            polynomial_offsets.push_back(blob.size() * sizeof(int32_t));
+            blob.push_back(temp_poly.coefficients.size());
+            for(auto citr = temp_poly.coefficients.begin(); citr != temp_poly.coefficients.end(); citr++){
+                blob.push_back(citr->first); blob.push_back(citr->second);
+            }
+        }
+        ids[k] = result.first->second;
+    }
+    if(blob.size() % 2 == 1) blob.push_back(0); /* keeps the file size a multiple of 8 */
+
+    KLStoreHeader header;
+    memcpy(header.magic, K_L_STORE_MAGIC, 8);
+    header.n = current_sn_group; header.reserved = 0;
+    header.entry_amount = keys.size(); header.polynomial_amount = polynomial_offsets.size();
+    header.blob_size = blob.size() * sizeof(int32_t);
+
+    string temp_path = path + ".tmp" + to_string(getpid()); // other processes may be writing the same file
+    FILE* ifp = fopen(temp_path.c_str(), "wb");
+    if(ifp == NULL) return false;
+    fwrite(&header, sizeof(header), 1, ifp);
+    fwrite(keys.data(), sizeof(uint64_t), keys.size(), ifp);
+    fwrite(ids.data(), sizeof(uint32_t), ids.size(), ifp);
+    fwrite(polynomial_offsets.data(), sizeof(uint64_t), polynomial_offsets.size(), ifp);
+    fwrite(blob.data(), sizeof(int32_t), blob.size(), ifp);
+    fflush(ifp); fsync(fileno(ifp));
+    bool failed = ferror(ifp);
+    fclose(ifp);
+    if(failed || rename(temp_path.c_str(), path.c_str()) != 0){ remove(temp_path.c_str()); return false; }
+    return true;
+}
+
+/* Every entry of 'k_l_store' and its segments, with IDs inside 'polynom_pool' */
+vector<pair<uint64_t, uint32_t>> k_l_store_entries(void){
+    vector<pair<uint64_t, uint32_t>> result = k_l_store_all_entries(k_l_store);
+    for(auto itr = k_l_store_segments.begin(); itr != k_l_store_segments.end(); itr++){
+        vector<pair<uint64_t, uint32_t>> temp = k_l_store_all_entries(*itr);
+        result.insert(result.end(), temp.begin(), temp.end());
+    }
+    return result;
+}
+
+// The amount of pairs inside the database file at 'path' by its header, 0 if there is no such file
+static uint64_t store_file_entries(string path){
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd == -1) return 0;
+    KLStoreHeader header;
+    bool readable = pread(fd, &header, sizeof(header), 0) == sizeof(header) && memcmp(header.magic, K_L_STORE_MAGIC, 8) == 0;
+    close(fd);
+    return readable ? header.entry_amount : 0;
+}
+
+/*
+ Adds the new entries to the database at 'path' without rewriting all of it. Such a database is made of segments,
+ 'path' itself and then 'path.1', 'path.2', ..., all of them in the format above, and every segment holds pairs
+ added later than the ones before it. The new entries become the newest segment, which is then merged into the
+ one before it as long as it holds at least half as many pairs. So the segments shrink geometrically, there are
+ only logarithmically many of them, and a pair is rewritten that many times in total instead of on every call.
+ A merged segment is removed only after the merge is written, a crash in between leaves duplicates that the next
+ merge drops. 'files' is set to the segments on the disk afterwards, oldest first, even if this fails.
+ Nothing is mapped here. Processes writing the same database should take turns, see 'log_merge_file'.
+*/
+bool k_l_store_add_segment(string path, vector<pair<uint64_t, uint32_t>> new_entries, vector<string>* files){
+    vector<string> segments = k_l_store_segment_names(path);
+    auto finish = [&segments, files](bool result){ if(files != NULL) *files = segments; return result; };
+    if(new_entries.empty()) return finish(true);
+
+    string newest = k_l_store_segment_name(path, segments.size());
+    if(!k_l_store_write(newest, new_entries)) return finish(false);
+    segments.push_back(newest);
+    while(segments.size() > 1 && 2 * store_file_entries(segments.back()) >= store_file_entries(segments[segments.size() - 2])){
+        string older = segments[segments.size() - 2];
+        vector<pair<uint64_t, uint32_t>> entries;
+        KLStore store;
+        if(k_l_store_map(store, older)){ entries = k_l_store_all_entries(store); k_l_store_unmap(store); }
+        if(k_l_store_map(store, segments.back())){
+            vector<pair<uint64_t, uint32_t>> temp = k_l_store_all_entries(store);
+            entries.insert(entries.end(), temp.begin(), temp.end());
+            k_l_store_unmap(store);
+        }
+        if(!k_l_store_write(older, entries)) return finish(false);
+        remove(segments.back().c_str());
+        segments.pop_back();
+    }
+    return finish(true);
+}
+
+/*
+ Converts the legacy text database 'KL-database<number>.txt' to the binary one, the text file is left as it is.
+ Returns false if there is no text database. 'k_l_database' is used while reading and is empty afterwards.
+*/
+bool k_l_store_convert_text(string file_name){
+    if(!k_l_database_read_text()) return false;
+    vector<pair<uint64_t, uint32_t>> entries;
+    for(int i = 0; i < k_l_database.size(); i++){
+        for(int j = 0; j < k_l_database[i].size(); j++){
+            if(k_l_database[i][j] == 0) continue;
+            entries.push_back({((uint64_t)i << 32) | (uint32_t)j, k_l_database[i][j]});
+        }
+    }
+    k_l_database.clear();
+    return k_l_store_write(k_l_store_file_name(file_name), entries);
+}
+
+/* SHARDS --------------------------------------------------------------------------------------- */
+
+// "KL-database" becomes "KL-database<number>.manifest"
+string k_l_shards_manifest_name(string file_name){
+    ostringstream s; s << file_name << current_sn_group << ".manifest";
+    return s.str();
+}
+
+// "KL-database" becomes "KL-database<number>.shard<shard>.bin", this is where 'k-l-merge' puts the merged shards
+string k_l_shard_file_name(int shard, string file_name){
+    ostringstream s; s << file_name << current_sn_group << ".shard" << shard << ".bin";
+    return s.str();
+}
+
+// "KL-database" becomes "KL-database<number>.run<run>.shard<shard>.bin", written by the run 'k_l_shard_run' only
+string k_l_shard_run_file_name(int shard, string file_name){
+    ostringstream s; s << file_name << current_sn_group << ".run" << k_l_shard_run << ".shard" << shard << ".bin";
+    return s.str();
+}
+
+/* The shard of the pairs (u, v) with the given 'v_index'. 'range' cuts S_n into equal intervals of indexes,
+ * 'hash' takes the remainder, which spreads permutations of every length evenly between the shards. */
+int k_l_shard_of(int v_index, const KLShardManifest& manifest){
+    if(manifest.scheme == K_L_SHARDS_RANGE){
+        long long f_n = factorial(current_sn_group);
+        return min<long long>(manifest.shard_amount - 1, (long long)v_index * manifest.shard_amount / f_n);
+    }
+    return v_index % manifest.shard_amount;
+}
+
+/* Reads the manifest at 'path', returns false if there is no such file or it is not a manifest of the
+ * current group. The format is described in "k-l-store.h". */
+bool k_l_shards_read_manifest(KLShardManifest& manifest, string path){
+    manifest = KLShardManifest();
+    ifstream input(path);
+    if(!input.is_open()) return false;
+    string word; int version = 0, n = 0;
+    input >> word >> version;
+    if(word != K_L_SHARDS_MAGIC || version != 1) return false;
+    while(input >> word){
+        if(word == "n") input >> n;
+        else if(word == "scheme"){ input >> word; manifest.scheme = (word == "range") ? K_L_SHARDS_RANGE : K_L_SHARDS_HASH; }
+        else if(word == "shards") input >> manifest.shard_amount;
+        else if(word == "file"){
+            int shard; string file; input >> shard >> file;
+            manifest.files.push_back({shard, file});
+        }
+        else getline(input, word); /* unknown lines are skipped */
+    }
+    if(n != current_sn_group || manifest.shard_amount <= 0){ manifest = KLShardManifest(); return false; }
+    return true;
+}
+
+/* Writes the manifest to 'path' through a temporary file, so readers never see half of it */
+bool k_l_shards_write_manifest(const KLShardManifest& manifest, string path){
+    string temp_path = path + ".tmp";
+    FILE* ifp = fopen(temp_path.c_str(), "w");
+    if(ifp == NULL) return false;
+    fprintf(ifp, "%s 1\nn %d\nscheme %s\nshards %d\n", K_L_SHARDS_MAGIC, current_sn_group,
+            manifest.scheme == K_L_SHARDS_RANGE ? "range" : "hash", manifest.shard_amount);
+    for(auto itr = manifest.files.begin(); itr != manifest.files.end(); itr++) fprintf(ifp, "file %d %s\n", itr->first, itr->second.c_str());
+    fflush(ifp); fsync(fileno(ifp));
+    bool failed = ferror(ifp);
+    fclose(ifp);
+    if(failed || rename(temp_path.c_str(), path.c_str()) != 0){ remove(temp_path.c_str()); return false; }
+    return true;
+}
+
+// Runs 'change' on the manifest while holding 'KL-database<number>.manifest.lock', so processes sharing a directory do not overwrite each other
+static bool manifest_update(string file_name, function<bool(KLShardManifest&)> change){
+    string path = k_l_shards_manifest_name(file_name);
+    int lock_fd = open((path + ".lock").c_str(), O_RDWR | O_CREAT, 0644);
+    if(lock_fd == -1) return false;
+    flock(lock_fd, LOCK_EX);
+    KLShardManifest manifest;
+    k_l_shards_read_manifest(manifest, path);
+    bool result = change(manifest) && k_l_shards_write_manifest(manifest, path);
+    flock(lock_fd, LOCK_UN); close(lock_fd);
+    return result;
+}
+
+/* Turns the database of the current group into a sharded one by writing its manifest. Nothing happens if
+ * there is a manifest already, returns false if it could not be written. */
+bool k_l_shards_create(int shard_amount, int scheme, string file_name){
+    return manifest_update(file_name, [shard_amount, scheme](KLShardManifest& manifest){
+        if(manifest.shard_amount > 0) return true;
+        manifest.shard_amount = shard_amount; manifest.scheme = scheme;
+        return true;
+    });
+}
+
+/*
+ If the current group has a manifest, reads it into 'k_l_shard_manifest' and maps every shard file it lists.
+ The first time, the process also picks its run: the smallest number r for which 'KL-database<number>.run<r>.lock'
+ can be locked. Every process sharing the directory gets its own run, so each one writes only to its own files,
+ and a restarted process takes over the run (and the log) of one that crashed. Returns false if there is no manifest.
+*/
+bool k_l_shards_open(string file_name){
+    k_l_shards_close();
+    bool sharded = k_l_shards_read_manifest(k_l_shard_manifest, k_l_shards_manifest_name(file_name));
+
+    // the run belongs to one group and one directory, it is given up when either of them is left
+    if(run_lock_fd != -1 && (!sharded || run_lock_group != current_sn_group)){ close(run_lock_fd); run_lock_fd = -1; k_l_shard_run = -1; }
+    if(!sharded) return false;
+    for(int run = 0; run_lock_fd == -1; run++){
+        ostringstream s; s << file_name << current_sn_group << ".run" << run << ".lock";
+        int fd = open(s.str().c_str(), O_RDWR | O_CREAT, 0644);
+        if(fd == -1) break;
+        if(flock(fd, LOCK_EX | LOCK_NB) == 0){ run_lock_fd = fd; run_lock_group = current_sn_group; k_l_shard_run = run; }
+        else close(fd);
+    }
+
+    // newest files first, for the reason given at 'k_l_store_map_segments'
+    k_l_shard_stores.assign(k_l_shard_manifest.shard_amount, vector<KLStore>());
+    for(auto itr = k_l_shard_manifest.files.rbegin(); itr != k_l_shard_manifest.files.rend(); itr++){
+        if(itr->first < 0 || itr->first >= k_l_shard_manifest.shard_amount) continue;
+        KLStore store;
+        if(k_l_store_map(store, itr->second)) k_l_shard_stores[itr->first].push_back(store);
+    }
+    return true;
+}
+
+/* Unmaps every shard, the run is kept */
+void k_l_shards_close(void){
+    for(auto sitr = k_l_shard_stores.begin(); sitr != k_l_shard_stores.end(); sitr++){
+        for(auto itr = sitr->begin(); itr != sitr->end(); itr++) k_l_store_unmap(*itr);
+    }
+    k_l_shard_stores.clear();
+    k_l_shard_manifest = KLShardManifest();
+}
+
+/*
+ Adds the new entries to the shard files of this run, each entry goes to the shard of its v_index. Each shard of
+ the run is a database of segments, see 'k_l_store_add_segment', and the manifest lists every segment of it.
+ Nothing is mapped here, 'k_l_store_open' maps the result.
+*/
+bool k_l_shards_write_run(vector<pair<uint64_t, uint32_t>> new_entries, string file_name){
+    if(k_l_shard_manifest.shard_amount <= 0 || k_l_shard_run < 0) return false;
+    vector<vector<pair<uint64_t, uint32_t>>> per_shard(k_l_shard_manifest.shard_amount);
+    for(auto itr = new_entries.begin(); itr != new_entries.end(); itr++){
+        per_shard[k_l_shard_of(itr->first & 0xFFFFFFFF)].push_back(*itr);
+    }
+
+    bool result = true;
+    for(int shard = 0; shard < per_shard.size(); shard++){
+        if(per_shard[shard].empty()) continue;
+        string path = k_l_shard_run_file_name(shard, file_name);
+        vector<string> files;
+        result = k_l_store_add_segment(path, per_shard[shard], &files) && result;
+        // the segments of this run and shard are replaced by the ones on the disk now, oldest first
+        result = manifest_update(file_name, [shard, path, &files](KLShardManifest& manifest){
+            if(manifest.shard_amount <= 0) return false;
+            erase_if(manifest.files, [&path](const pair<int, string>& file){
+                return file.second == path || file.second.rfind(path + ".", 0) == 0;
+            });
+            for(auto itr = files.begin(); itr != files.end(); itr++) manifest.files.push_back({shard, *itr});
+            return true;
+        }) && result;
+    }
+    return result;
+}
@@ -0,0 +1,165 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef K_L_STORE
+#define K_L_STORE
+/*--------------------------------*/
+#ifndef POLYNOMIALS
+#include "polynomials.h"
+#endif // !POLYNOMIALS
+/*--------------------------------*/
+#include <cstdint>
+#include <string>
+#endif // !K_L_STORE
+
+#define K_L_STORE_MAGIC "KLSTORE2"
+
+/* How pairs (u, v) are spread to the shards, by the remainder of v_index or by intervals of v_index */
+#define K_L_SHARDS_MAGIC "KL-manifest"
+#define K_L_SHARDS_HASH  0
+#define K_L_SHARDS_RANGE 1
+
+// type definitions
+
+/*
+ Layout of 'KL-database<number>.bin', every part is aligned to 8 bytes:
+   KLStoreHeader
+   uint64_t keys[entry_amount]                    sorted, the key of (u_index, v_index) is (u_index << 32) | v_index
+   uint32_t ids[entry_amount]                     the polynomial of keys[k], padded to 8 bytes
+   uint64_t polynomial_offsets[polynomial_amount] position of each distinct polynomial inside the blob
+   blob                                           for each polynomial: int32_t term_amount, then term_amount pairs
+                                                  of int32_t power and int32_t coefficient, in increasing order of power
+ Every distinct polynomial is written once, pairs only refer to it by its ID. IDs inside the file are not the same
+ with the ones in 'polynom_pool', the file ones are translated by 'pool_ids' when the store is opened.
+ Nothing else is parsed, 'k_l_store_lookup_id' does a binary search directly on the mapped file.
+
+ Compactions of the log do not rewrite the whole file, they add a segment 'KL-database<number>.bin.<k>' in the
+ same format, and small segments are merged into larger ones, see 'k_l_store_add_segment'.
+*/
+struct KLStoreHeader
+{
+    char magic[8];
+    uint32_t n;
+    uint32_t reserved;
+    uint64_t entry_amount;
+    uint64_t polynomial_amount;
+    uint64_t blob_size;
+};
+
+/* An opened store, 'header' is NULL if there is none */
+struct KLStore
+{
+    int fd = -1;
+    void* map = NULL;
+    size_t map_size = 0;
+    const KLStoreHeader* header = NULL;
+    const uint64_t* keys = NULL;
+    const uint32_t* ids = NULL;
+    const uint64_t* polynomial_offsets = NULL;
+    const char* blob = NULL;
+    std::vector<uint32_t> pool_ids; // ID inside the file -> ID inside 'polynom_pool'
+};
+
+/*
+ A sharded database has a manifest 'KL-database<number>.manifest' instead of a single binary database. Pairs
+ (u, v) are split into 'shard_amount' shards by v_index, see 'k_l_shard_of', and each shard is made of one or
+ more files in the same format with 'KL-database<number>.bin'. The manifest is a text file:
+         KL-manifest 1
+         n <number>
+         scheme hash|range
+         shards <shard_amount>
+         file <shard> <file name>       one line for every file
+ Every process sharing the directory writes its own files 'KL-database<number>.run<run>.shard<shard>.bin', with their segments, and its
+ own log, 'k-l-merge' combines all of them (and those of other directories) into one file per shard.
+*/
+struct KLShardManifest
+{
+    int shard_amount = 0; // 0 if the database is not sharded
+    int scheme = K_L_SHARDS_HASH;
+    std::vector<std::pair<int, std::string>> files; // shard, file name
+};
+
+/*--------------------------Global variables, just their declerations-----------------------*/
+
+/* The binary database of the group in 'current_sn_group', opened by 'k_l_database_initiate', and its newer segments */
+extern KLStore k_l_store;
+extern std::vector<KLStore> k_l_store_segments;
+
+/* The manifest of the current group and the mapped files of every shard, both empty if the database is not sharded */
+extern KLShardManifest k_l_shard_manifest;
+extern std::vector<std::vector<KLStore>> k_l_shard_stores;
+
+/* The run of this process inside a sharded database, -1 if there is none. Look at 'k_l_shards_open' */
+extern int k_l_shard_run;
+
+/*------------------------------------------------------------------------------------------*/
+
+// function declarations
+
+std::string k_l_store_file_name(std::string file_name = database_name);
+
+bool k_l_store_map(KLStore& store, std::string path, int n = current_sn_group);
+
+void k_l_store_unmap(KLStore& store);
+
+uint32_t k_l_store_find_id(const KLStore& store, int u_index, int v_index);
+
+std::vector<std::pair<uint64_t, uint32_t>> k_l_store_all_entries(const KLStore& store);
+
+std::string k_l_store_segment_name(std::string path, int segment);
+
+std::vector<std::string> k_l_store_segment_names(std::string path);
+
+void k_l_store_map_segments(std::vector<KLStore>& segments, std::string path, int n = current_sn_group);
+
+bool k_l_store_open(std::string file_name = database_name);
+
+void k_l_store_close(void);
+
+uint32_t k_l_store_lookup_id(int u_index, int v_index);
+
+bool k_l_store_lookup(int u_index, int v_index, Polynomial& result);
+
+bool k_l_store_write(std::string path, std::vector<std::pair<uint64_t, uint32_t>> entries);
+
+std::vector<std::pair<uint64_t, uint32_t>> k_l_store_entries(void);
+
+bool k_l_store_add_segment(std::string path, std::vector<std::pair<uint64_t, uint32_t>> new_entries, std::vector<std::string>* files = NULL);
+
+bool k_l_store_convert_text(std::string file_name = database_name);
+
+std::string k_l_shards_manifest_name(std::string file_name = database_name);
+
+std::string k_l_shard_file_name(int shard, std::string file_name = database_name);
+
+std::string k_l_shard_run_file_name(int shard, std::string file_name = database_name);
+
+int k_l_shard_of(int v_index, const KLShardManifest& manifest = k_l_shard_manifest);
+
+bool k_l_shards_read_manifest(KLShardManifest& manifest, std::string path);
+
+bool k_l_shards_write_manifest(const KLShardManifest& manifest, std::string path);
+
+bool k_l_shards_create(int shard_amount, int scheme = K_L_SHARDS_HASH, std::string file_name = database_name);
+
+bool k_l_shards_open(std::string file_name = database_name);
+
+void k_l_shards_close(void);
+
+bool k_l_shards_write_run(std::vector<std::pair<uint64_t, uint32_t>> new_entries, std::string file_name = database_name);
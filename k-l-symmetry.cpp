@@ -0,0 +1,75 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "k-l-symmetry.h"
+
+using namespace std;
+
+/* Canonical pairs can only be found once 'permt_index_tables_initiate' is called for the current group,
+ * until then every function using this module simply works on the pairs it is given. */
+bool k_l_symmetry_ready(void){
+    return all_p_inverse.size() == all_p.size() && all_p_right_descents.size() == all_p.size() && !all_p.empty();
+}
+
+/*
+ For u <= v, if s is a right descent of v but not of u then P(u, v) = P(u*s, v), and u*s <= v still holds.
+ The same is true on the left with s*u. This function keeps replacing u like this until every descent of
+ v (on both sides) is also a descent of u, the returned pair has the same K-L polynomial as the given one.
+ Every step makes u longer by one, so it stops after at most l(v) - l(u) steps.
+*/
+pair<int, int> k_l_symmetry_raise(int u_index, int v_index){
+    while(true){
+        unsigned int missing = all_p_right_descents[v_index] & ~all_p_right_descents[u_index];
+        if(missing != 0){
+            u_index = all_p_right_multp[__builtin_ctz(missing)][u_index]; continue;
+        }
+        missing = all_p_left_descents[v_index] & ~all_p_left_descents[u_index];
+        if(missing != 0){
+            u_index = all_p_left_multp[__builtin_ctz(missing)][u_index]; continue;
+        }
+        return {u_index, v_index};
+    }
+}
+
+/*
+ Returns the representative of the pair (u, v), u <= v with respect to bruhat order is assumed. Together
+ with the descent moves of 'k_l_symmetry_raise' the following identities are used:
+         P(u, v) = P(u^-1, v^-1) = P(w0*u*w0, w0*v*w0)
+ The pair is raised first, then out of the (at most) four images under inversion and conjugation by w0,
+ the one with the smallest (v_index, u_index) is returned. These maps preserve lengths, bruhat order and
+ the containment of descent sets, so every image is still raised.
+ Only representatives are computed and stored, the K-L database and the memo use this for their keys.
+*/
+pair<int, int> k_l_symmetry_canonical(int u_index, int v_index){
+    pair<int, int> raised = k_l_symmetry_raise(u_index, v_index);
+    int u_inverse = all_p_inverse[raised.first], v_inverse = all_p_inverse[raised.second];
+    pair<int, int> images[4] = {
+        raised,
+        {u_inverse, v_inverse},
+        {all_p_w0_conjugate[raised.first], all_p_w0_conjugate[raised.second]},
+        {all_p_w0_conjugate[u_inverse], all_p_w0_conjugate[v_inverse]}
+    };
+
+    pair<int, int> result = raised;
+    for(int k = 1; k < 4; k++){
+        if(images[k].second < result.second || (images[k].second == result.second && images[k].first < result.first))
+            result = images[k];
+    }
+    return result;
+}
@@ -0,0 +1,36 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef K_L_SYMMETRY
+#define K_L_SYMMETRY
+/*--------------------------------*/
+#ifndef PERMUTATION_BASICS
+#include "permutation-basics.h"
+#endif // !PERMUTATION_BASICS
+/*--------------------------------*/
+#include <utility>
+#endif // !K_L_SYMMETRY
+
+// function declarations
+
+bool k_l_symmetry_ready(void);
+
+std::pair<int, int> k_l_symmetry_raise(int u_index, int v_index);
+
+std::pair<int, int> k_l_symmetry_canonical(int u_index, int v_index);
@@ -0,0 +1,149 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "k-l-table.h"
+#include <chrono>
+#include <fstream>
+#include <unistd.h>
+
+using namespace std;
+
+// "KL-table<number>.progress", next to the database of the group
+string k_l_table_progress_name(void){
+    ostringstream s; s << "KL-table" << current_sn_group << ".progress";
+    return s.str();
+}
+
+/* Returns the last finished level of the group in 'current_sn_group', 0 if there is no usable progress file */
+int k_l_table_read_progress(uint64_t& pairs){
+    ifstream file(k_l_table_progress_name());
+    string magic, key; int version = 0, n = 0, level = 0;
+    pairs = 0;
+    if(!(file >> magic >> version) || magic != "KL-table" || version != 1) return 0;
+    if(!(file >> key >> n) || key != "n" || n != current_sn_group) return 0;
+    if(!(file >> key >> level) || key != "level") return 0;
+    if(!(file >> key >> pairs) || key != "pairs"){ pairs = 0; return 0; }
+    return level;
+}
+
+/* The progress file is replaced at once, an interrupted write leaves the previous one */
+bool k_l_table_write_progress(int level, uint64_t pairs){
+    string path = k_l_table_progress_name();
+    string temp_path = path + ".tmp" + to_string(getpid());
+    FILE* file = fopen(temp_path.c_str(), "w");
+    if(file == NULL) return false;
+    fprintf(file, "KL-table 1\nn %d\nlevel %d\npairs %llu\n", current_sn_group, level, (unsigned long long)pairs);
+    bool written = fflush(file) == 0 && fsync(fileno(file)) == 0;
+    written = (fclose(file) == 0) && written;
+    if(!written || rename(temp_path.c_str(), path.c_str()) != 0){ remove(temp_path.c_str()); return false; }
+    return true;
+}
+
+/*
+ Amount of representatives u < v with l(v) inside (done_level, max_len), the total of the progress reports.
+ Rows of 'b_matrix' are read in order and the descent sets are compared before 'k_l_symmetry_canonical' is
+ called, so this takes a few seconds even for S_8, next to hours for the table itself.
+*/
+static uint64_t count_remaining_pairs(int done_level, int max_len){
+    int f_n = all_p.size();
+    atomic<uint64_t> total(0);
+    k_l_parallel_for(f_n, [&](size_t u_index){
+        uint64_t row_pairs = 0;
+        for(int v_index = 0; v_index < f_n; v_index++){
+            if(all_p_len[v_index] <= done_level || all_p_len[v_index] >= max_len) continue;
+            if(v_index == (int)u_index || b_matrix[u_index][v_index] == 0) continue;
+            // a representative is already raised, every descent of v is a descent of u
+            if((all_p_right_descents[v_index] & ~all_p_right_descents[u_index]) != 0) continue;
+            if((all_p_left_descents[v_index] & ~all_p_left_descents[u_index]) != 0) continue;
+            if(k_l_symmetry_canonical(u_index, v_index) == make_pair((int)u_index, v_index)) row_pairs++;
+        }
+        total.fetch_add(row_pairs, memory_order_relaxed);
+    });
+    return total.load();
+}
+
+/*
+ Fills the database with the whole table of the group, as described in "k-l-table.h". The group tables and the
+ database have to be initiated before. Prints the time spent on each level and returns the amount of representatives.
+*/
+uint64_t k_l_table_run(int thread_amount){
+    k_l_parallel_initiate(thread_amount);
+    int f_n = all_p.size();
+    int max_len = (current_sn_group * (current_sn_group - 1)) / 2;
+
+    // columns of every level, the longest permutation is left out since P(u, w0) = 1 for all u
+    vector<vector<int>> levels(max_len);
+    for(int v_index = 0; v_index < f_n; v_index++){
+        if(all_p_len[v_index] > 0 && all_p_len[v_index] < max_len) levels[all_p_len[v_index]].push_back(v_index);
+    }
+
+    uint64_t total_pairs = 0;
+    int done_level = k_l_table_read_progress(total_pairs);
+    if(done_level > 0) printf("  Continuing after level %d, %llu pairs were written before\n", done_level, (unsigned long long)total_pairs);
+
+    k_l_progress_begin("table S_" + to_string(current_sn_group), "pairs", count_remaining_pairs(done_level, max_len));
+    double compute_seconds = 0, persist_seconds = 0;
+    for(int level = done_level + 1; level < max_len; level++){
+        auto start = chrono::steady_clock::now();
+        atomic<uint64_t> level_pairs(0);
+        uint64_t evicted_before = k_l_memory_evicted_entries.load();
+        // with a memory budget the columns are done in parts, the budget is enforced between them
+        size_t part = levels[level].size();
+        if(k_l_memory_budget > 0) part = (size_t)(k_l_scheduler_thread_amount + 1) * K_L_MEMORY_CHECK_COLUMNS;
+        for(size_t first = 0; first < levels[level].size(); first += part){
+            {
+                K_L_STATS_PHASE(K_L_STATS_NS_RECURSION);
+                k_l_parallel_for(min(part, levels[level].size() - first), [&](size_t k){
+                    int v_index = levels[level][first + k];
+                    uint64_t column_pairs = 0;
+                    for(int u_index = 0; u_index < f_n; u_index++){
+                        if(u_index == v_index || b_matrix[u_index][v_index] == 0) continue;
+                        if(k_l_symmetry_canonical(u_index, v_index) != make_pair(u_index, v_index)) continue;
+                        k_l_parallel_evaluate(u_index, v_index);
+                        k_l_progress_add(1);
+                        column_pairs++;
+                    }
+                    level_pairs.fetch_add(column_pairs, memory_order_relaxed);
+                });
+            }
+            k_l_memory_checkpoint();
+        }
+        // leftover tasks may still read the binary database, which is mapped again by the compaction
+        k_l_scheduler_drain();
+        auto computed = chrono::steady_clock::now();
+
+        size_t new_pairs = k_l_memo_size() + (k_l_memory_evicted_entries.load() - evicted_before);
+        k_l_database_append();
+        k_l_memo_clear();
+        total_pairs += level_pairs.load();
+        if(!k_l_table_write_progress(level, total_pairs)) printf("  Could not write %s\n", k_l_table_progress_name().c_str());
+        auto persisted = chrono::steady_clock::now();
+
+        double level_compute = chrono::duration<double>(computed - start).count();
+        double level_persist = chrono::duration<double>(persisted - computed).count();
+        compute_seconds += level_compute; persist_seconds += level_persist;
+        printf("  level %2d: %6zu columns %10llu pairs (%zu new), compute %.3f s, persist %.3f s\n", level, levels[level].size(),
+               (unsigned long long)level_pairs.load(), new_pairs, level_compute, level_persist);
+        fflush(stdout);
+    }
+    k_l_progress_end();
+    printf("  Table of S_%d: %llu pairs, compute %.3f s, persist %.3f s\n", current_sn_group, (unsigned long long)total_pairs,
+           compute_seconds, persist_seconds);
+    return total_pairs;
+}
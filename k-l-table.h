@@ -0,0 +1,56 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef K_L_TABLE
+#define K_L_TABLE
+/*--------------------------------*/
+#ifndef K_L_PARALLEL
+#include "k-l-parallel.h"
+#endif // !K_L_PARALLEL
+/*--------------------------------*/
+#include <string>
+#endif // !K_L_TABLE
+
+/*
+ Computes P(u, v) of every pair of the group in 'current_sn_group' and leaves them inside the database,
+ 'KL-database<number>.bin' (or its shards). Columns are walked in levels, by the length of v: the recursion of
+ a pair only needs pairs whose v is shorter, so every column of one level is computed at the same time, one
+ column for each thread. Only representatives of pairs are computed, see "k-l-symmetry.h", trivial pairs
+ (u = v, v the longest permutation, u and v not comparable) are not written.
+
+ Polynomials go to the log as soon as they are computed, at the end of each level the log is compacted into
+ the database and the memo is cleared, so the memory used does not grow with the amount of levels done. With a
+ memory budget, see "k-l-memory.h", the memo is also evicted inside a level whenever it gets over the budget.
+ The last finished level is written to 'KL-table<number>.progress' afterwards:
+         KL-table 1
+         n <number>
+         level <length of v>
+         pairs <representatives written so far>
+ A run started again continues with the next level, pairs of an unfinished level are read back from the log.
+*/
+
+// function declarations
+
+std::string k_l_table_progress_name(void);
+
+int k_l_table_read_progress(uint64_t& pairs);
+
+bool k_l_table_write_progress(int level, uint64_t pairs);
+
+uint64_t k_l_table_run(int thread_amount = 0);
@@ -25,9 +25,26 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "permutation-basics.h"
 #include "bruhat-order.h"
 #include "polynomials.h"
+#include "k-l-parallel.h"
+#include "w-graph.h"
+#include "k-l-cells.h"
+#include "k-l-query.h"
+#include "k-l-table.h"
+#include "k-l-stack.h"
+#include <csignal>
 
 using namespace std;
 
+/* Rows of 'b_matrix' when it is allocated by 'group_tables_initiate' itself, 0 if it is not */
+static int b_matrix_rows = 0;
+
+/* Set by SIGINT and SIGTERM during '--stack', the computation is checkpointed and the driver exits */
+static volatile sig_atomic_t stack_interrupted = 0;
+
+static void stack_interrupt(int signal_number){
+  stack_interrupted = 1;
+}
+
 template<typename T>
 void print_permt_data(FILE* ifp, T m){
     for(auto itr = m.begin(); itr != m.end(); itr++){
@@ -107,26 +124,162 @@ int input_prompt(void){
   return result;
 }
 
-int main(void){
+/* Initializes every global table for the group in 'current_sn_group': permutations, lengths, b_matrix
+ * (shared with other processes, read from the file or generated on multiple threads) and the K-L database */
+void group_tables_initiate(void){
+  K_L_STATS_PHASE(K_L_STATS_NS_GROUP_INIT);
+  // b_matrix of the previous group is released first, it may be inside the shared segment
+  if(k_l_shm != NULL) k_l_shm_detach();
+  else if(b_matrix != NULL){
+      for(int i = 0; i < b_matrix_rows; i++) delete[] b_matrix[i];
+      delete[] b_matrix; b_matrix = NULL; b_matrix_rows = 0;
+  }
+
+  all_p = permt_all_sn(current_sn_group);
+  all_p_len = permt_lengths(all_p);
+  all_p_data = permt_with_extra_data(all_p, all_p_len);
+  permt_index_tables_initiate();
+  greek_mu_table_initiate();
+
+  printf("  Initiating K-L polynomial database ...\n");
+  k_l_database_initiate();
+  printf("  Initiating Bruhat matrix ...\n");
+
+  // other driver processes of this machine share b_matrix and their results, see "k-l-shm.h"
+  if(k_l_shm_attach()) return;
+  int f_n = factorial(current_sn_group);
+  /*  Allocating space inside b_matrix */
+  b_matrix = new int*[f_n];
+  for(int i = 0; i < f_n; i++){
+      b_matrix[i] = new int[f_n];
+  }
+  b_matrix_rows = f_n;
+  bruhat_matrix_initiate();
+}
+
+/* Command line modes, the interactive menu is used when there are no arguments */
+int command_line(int argc, char** argv){
+  string mode = argv[1];
+  if(mode == "--server" && argc >= 3){
+      current_sn_group = atoi(argv[2]);
+      if(current_sn_group < 2){ printf("  The group should be S_2 or larger\n"); return 1; }
+      group_tables_initiate();
+      return k_l_server_run(argc >= 4 ? argv[3] : "", argc >= 5 ? atoi(argv[4]) : 0);
+  }
+  if(mode == "--batch"){
+      // the answers go to stdout, messages printed while loading the tables are moved to stderr
+      fflush(stdout);
+      FILE* output = fdopen(dup(fileno(stdout)), "w");
+      dup2(fileno(stderr), fileno(stdout));
+      setvbuf(stdout, NULL, _IOLBF, 0);
+      FILE* input = (argc >= 3 && string(argv[2]) != "-") ? fopen(argv[2], "r") : stdin;
+      if(input == NULL){ fprintf(stderr, "  Could not open %s\n", argv[2]); return 1; }
+      int thread_amount = argc >= 4 ? atoi(argv[3]) : 0;
+      vector<KLQueryPair> pairs;
+      k_l_query_read_pairs(input, pairs);
+      if(input != stdin) fclose(input);
+
+      // every group is loaded once, with all of its pairs
+      map<int, vector<KLQueryPair>> groups;
+      for(auto itr = pairs.begin(); itr != pairs.end(); itr++) groups[k_l_query_group_of(itr->u_text)].push_back(*itr);
+      auto start = chrono::steady_clock::now();
+      size_t answered = 0;
+      for(auto gitr = groups.begin(); gitr != groups.end(); gitr++){
+          if(gitr->first < 2 || gitr->first > 9){
+              for(auto itr = gitr->second.begin(); itr != gitr->second.end(); itr++) fprintf(output, "%ld ERR not a permutation\n", itr->line);
+              continue;
+          }
+          current_sn_group = gitr->first;
+          group_tables_initiate();
+          answered += k_l_query_batch(gitr->second, output, thread_amount);
+          k_l_scheduler_stop();
+          k_l_database_append();
+      }
+      double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      fprintf(stderr, "  %zu pairs answered in %.3f seconds, %.0f pairs per second\n", answered, seconds, answered / max(seconds, 1e-9));
+      if(k_l_memory_budget > 0) k_l_memory_report(stderr);
+      fclose(output);
+      return 0;
+  }
+  if(mode == "--table" && argc >= 3){
+      current_sn_group = atoi(argv[2]);
+      if(current_sn_group < 2){ printf("  The group should be S_2 or larger\n"); return 1; }
+      auto start = chrono::steady_clock::now();
+      group_tables_initiate();
+      printf("  Tables ready in %.3f seconds\n", chrono::duration<double>(chrono::steady_clock::now() - start).count());
+      k_l_table_run(argc >= 4 ? atoi(argv[3]) : 0);
+      k_l_scheduler_stop();
+      printf("  Done in %.3f seconds\n", chrono::duration<double>(chrono::steady_clock::now() - start).count());
+      if(k_l_memory_budget > 0) k_l_memory_report(stdout);
+      return 0;
+  }
+  if(mode == "--stack" && argc >= 4){
+      // P(u, v) on the explicit stack, see "k-l-stack.h". It is suspended by SIGINT or SIGTERM, the checkpoint
+      // file is written every K_L_STACK_CHECKPOINT_STEPS steps and then, the same command resumes from it
+      current_sn_group = k_l_query_group_of(argv[2]);
+      vector<int> u, v;
+      if(!k_l_query_parse_permutation(argv[2], u) || !k_l_query_parse_permutation(argv[3], v)){
+          printf("  Expected two permutations of the same group\n"); return 1;
+      }
+      string checkpoint = argc >= 5 ? argv[4] : "";
+      group_tables_initiate();
+      KLStackState state = k_l_stack_begin(permt_rank(u), permt_rank(v)), saved;
+      if(!checkpoint.empty() && k_l_stack_load(saved, checkpoint) && saved.u_index == state.u_index && saved.v_index == state.v_index){
+          state = std::move(saved);
+          printf("  Resuming after %llu steps, %zu frames on the stack\n", (unsigned long long)state.steps, state.frames.size());
+      }
+      signal(SIGINT, stack_interrupt); signal(SIGTERM, stack_interrupt);
+      k_l_progress_begin("P(u, v)", "pairs", 0, true);
+      while(!k_l_stack_done(state) && !stack_interrupted){
+          k_l_stack_step(state);
+          if(!checkpoint.empty() && state.steps % K_L_STACK_CHECKPOINT_STEPS == 0) k_l_stack_save(state, checkpoint);
+      }
+      k_l_progress_end();
+      bool done = k_l_stack_done(state);
+      if(!done && !checkpoint.empty() && !k_l_stack_save(state, checkpoint)) printf("  Could not write %s\n", checkpoint.c_str());
+      // what is finished so far is kept either way
+      k_l_database_append();
+      if(!done){
+          printf("  Suspended after %llu steps, %zu frames on the stack\n", (unsigned long long)state.steps, state.frames.size());
+          return 2;
+      }
+      if(!checkpoint.empty()) remove(checkpoint.c_str());
+      printf("\n K-L polynomial: ");
+      polynom_display(stdout, state.returned); printf("\n");
+      return 0;
+  }
+  printf("usage: %s --server <n> [socket] [max_queries]\n"
+         "       %s --batch [file|-] [threads]\n"
+         "       %s --table <n> [threads]\n"
+         "       %s --stack <u> <v> [checkpoint]\n", argv[0], argv[0], argv[0], argv[0]);
+  return 1;
+}
+
+int main(int argc, char** argv){
+  k_l_stats_report_at_exit();
+  k_l_memory_budget_initiate();
+  if(argc > 1) return command_line(argc, argv);
 
   bool continue_program = true;
 
   while(continue_program){
     char user_choice = -1; char helper_char = -1;
-    printf("\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n\n%s",
+    printf("\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n\n%s",
            "  Please choose one of the options below:",
            "  1-) All permutations in S_n with their lengths, ordered lexiographically",
            "  2-) Entire bruhat order graph for S_n",
            "  3-) Bruhat order graph between two permutations in S_n",
            "  4-) Kazhdan-Lustzig polynomial for two permutations (using bruhat_matrix)",
-           "  5-) Same as the option (4), but multi threaded (uses 7 cores) [BETA, CAN BE BUGGY]",
+           "  5-) Same as the option (4), but multi threaded (uses every core)",
            "  6-) Kazhdan-Lustzig polynomial for two permutations (using graphs) [DEPRECATED, DO NOT USE]",
-           "  Enter a number[1-6] : ");
+           "  7-) W-graph for S_n (mu values of every pair, multi threaded)",
+           "  8-) Left, right and two sided Kazhdan-Lustzig cells of S_n",
+           "  Enter a number[1-8] : ");
 
     user_choice = getc(stdin);
     helper_char = getc(stdin);
-    if(user_choice - 48 < 1 || user_choice - 48 > 6 || helper_char != '\n'){
-        cout << "  The input should contain only numbers! [1-5]\n";
+    if(user_choice - 48 < 1 || user_choice - 48 > 8 || helper_char != '\n'){
+        cout << "  The input should contain only numbers! [1-8]\n";
         exit(0);
     }
 
@@ -214,7 +367,7 @@ int main(void){
         printf("%s\n%s\n%s\n%s\n%s\n",
                 "  In order to be more efficient with resource usage, the program creates a database,",
                 "  containing previously calculated Kazhdan-Lustzig polynomials. By default it is named",
-                "  'KL-database.txt' , it should reside in the same directory that you are running this program.",
+                "  'KL-database<n>.bin' , it should reside in the same directory that you are running this program.",
                 "  If you wish to change that name, you should edit the source code directly.",
                 "  Corresponding variable is defined on 'polynomials.cpp' file, check that out for more info.");
         vector<int> permt1 = permt_prompt(), permt2 = permt_prompt();
@@ -226,25 +379,15 @@ int main(void){
 
         // Reading the database file, for that particular S_n group that permutations belong to
         current_sn_group = permt1.size();
-        all_p = permt_all_sn(current_sn_group);
-        all_p_len = permt_lengths(all_p);
-        all_p_data = permt_with_extra_data(all_p, all_p_len);
-
-        int f_n = factorial(current_sn_group);
-        /*  Allocating space inside b_matrix */
-        b_matrix = new int*[f_n];
-        for(int i = 0; i < f_n; i++){
-            b_matrix[i] = new int[f_n];
-        }
-
-        printf("  Initiating K-L polynomial database ...\n");
-        k_l_database_initiate();
-        printf("  Initiating Bruhat matrix ...\n");
-        bruhat_matrix_initiate();
+        group_tables_initiate();
 
         Polynomial result; auto dummy = k_l_database_check({permt1, permt2});
         if(dummy.first) result = dummy.second;
-        else result = polynom_k_l(permt1, permt2);
+        else{
+            k_l_progress_begin("P(u, v)", "pairs", 0, true);
+            result = polynom_k_l(permt1, permt2);
+            k_l_progress_end();
+        }
 
         // in case new information is obtained
         k_l_database_append();
@@ -257,7 +400,7 @@ int main(void){
         printf("%s\n%s\n%s\n%s\n%s\n",
                 "  In order to be more efficient with resource usage, the program creates a database,",
                 "  containing previously calculated Kazhdan-Lustzig polynomials. By default it is named",
-                "  'KL-database.txt' , it should reside in the same directory that you are running this program.",
+                "  'KL-database<n>.bin' , it should reside in the same directory that you are running this program.",
                 "  If you wish to change that name, you should edit the source code directly.",
                 "  Corresponding variable is defined on 'polynomials.cpp' file, check that out for more info.");
         vector<int> permt1 = permt_prompt(), permt2 = permt_prompt();
@@ -269,37 +412,21 @@ int main(void){
 
         // Reading the database file, for that particular S_n group that permutations belong to
         current_sn_group = permt1.size();
-        all_p = permt_all_sn(current_sn_group);
-        all_p_len = permt_lengths(all_p);
-        all_p_data = permt_with_extra_data(all_p, all_p_len);
-
-        int f_n = factorial(current_sn_group);
-        /*  Allocating space inside b_matrix */
-        b_matrix = new int*[f_n];
-        for(int i = 0; i < f_n; i++){
-            b_matrix[i] = new int[f_n];
-        }
-
-        printf("  Initiating K-L polynomial database ...\n");
-        k_l_database_initiate();
-        printf("  Initiating Bruhat matrix ...\n");
-        
-        ostringstream s; s << "bruhat-matrix" << current_sn_group << ".txt";
-        FILE* ifp = fopen(s.str().c_str(), "r");
-        if(ifp == NULL){
-            printf("%s%s",
-                    "  No previous bruhat matrix data is found, generating for the entire group...\n",
-                    "  This might take some time, stand still...\n");
-            bruhat_matrix_all_sn_multi_threaded(current_sn_group);
-            bruhat_matrix_write();
-        }
+        group_tables_initiate();
 
         Polynomial result; auto dummy = k_l_database_check({permt1, permt2});
         if(dummy.first) result = dummy.second;
-        else result = polynom_k_l(permt1, permt2);
+        else{
+            k_l_progress_begin("P(u, v)", "pairs", 0, true);
+            result = polynom_k_l_parallel(permt1, permt2);
+            k_l_progress_end();
+        }
+        k_l_scheduler_stop();
 
         // in case new information is obtained
         k_l_database_append();
+        // the memo is kept for the next query of the same group
+        k_l_memory_checkpoint();
 
         printf("\n K-L polynomial: ");
         polynom_display(stdout, result); printf("\n");
@@ -309,7 +436,7 @@ int main(void){
         printf("%s\n%s\n%s\n%s\n%s\n",
                 "  In order to be more efficient with resource usage, the program creates a database,",
                 "  containing previously calculated Kazhdan-Lustzig polynomials. By default it is named",
-                "  'KL-database.txt' , it should reside in the same directory that you are running this program.",
+                "  'KL-database<n>.bin' , it should reside in the same directory that you are running this program.",
                 "  If you wish to change that name, you should edit the source code directly.",
                 "  Corresponding variable is defined on 'polynomials.cpp' file, check that out for more info.");
         vector<int> permt1 = permt_prompt(), permt2 = permt_prompt();
@@ -345,6 +472,53 @@ int main(void){
         polynom_display(stdout, result); printf("\n");
     }
 
+    else if(user_choice == '7'){
+        current_sn_group = input_prompt();
+        pair<char*, bool> x = t_f_prompt();
+        group_tables_initiate();
+
+        printf("  Computing mu values for every pair ...\n");
+        WGraph g = w_graph_all_sn(current_sn_group);
+        k_l_scheduler_stop();
+
+        if(x.second) w_graph_display(stdout, g);
+        else{
+            FILE* ofp = fopen(x.first, "w");
+            w_graph_display(ofp, g);
+            printf("\n%s%s\n", "  The result has been successfully written to the file: ", x.first);
+            delete[] x.first;
+            fclose(ofp);
+        }
+    }
+
+    else if(user_choice == '8'){
+        current_sn_group = input_prompt();
+        pair<char*, bool> x = t_f_prompt();
+        group_tables_initiate();
+
+        // a W-graph that was saved before with option (7) is used, if there is one
+        WGraph g = w_graph_read(current_sn_group);
+        if(g.offsets.empty()){
+            printf("  No previous W-graph data is found, computing mu values for every pair ...\n");
+            g = w_graph_all_sn(current_sn_group);
+            k_l_scheduler_stop();
+            w_graph_write(g);
+        }
+        printf("  Finding cells ...\n");
+        KLCells cells = k_l_cells_all_sn(g);
+        printf("  %d left cells, %d right cells, %d two sided cells\n",
+               cells.left_amount, cells.right_amount, cells.two_sided_amount);
+
+        if(x.second) k_l_cells_display(stdout, cells);
+        else{
+            FILE* ofp = fopen(x.first, "w");
+            k_l_cells_display(ofp, cells);
+            printf("\n%s%s\n", "  The result has been successfully written to the file: ", x.first);
+            delete[] x.first;
+            fclose(ofp);
+        }
+    }
+
     printf("\n  Do you wish to go back to the main [m]enu or [q]uit ? [m-q] : ");
     user_choice = getc(stdin); helper_char = getc(stdin);
     if(user_choice != 'm' && user_choice != 'M') continue_program = false;
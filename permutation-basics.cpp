@@ -18,6 +18,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "permutation-basics.h"
+#ifndef PERMUTATION_KERNELS
+#include "permutation-kernels.h"
+#endif // !PERMUTATION_KERNELS
 
 using namespace std;
 
@@ -31,8 +34,35 @@ vector<int> all_p_len;
 
 map<vector<int>, PermtData> all_p_data;
 
+vector<unsigned int> all_p_right_descents;
+
+vector<unsigned int> all_p_left_descents;
+
+vector<vector<uint64_t>> all_p_descent_bits;
+
+vector<int> all_p_inverse;
+
+vector<int> all_p_w0_conjugate;
+
+vector<vector<int>> all_p_right_multp;
+
+vector<vector<int>> all_p_left_multp;
+
 /*--------------------------------- */
 
+/* Kernels of every group between PERMT_KERNEL_MIN_N and PERMT_KERNEL_MAX_N, see "permutation-kernels.h" */
+static const PermtKernels permt_kernel_table[] = {
+    permt_kernels_of<2>(), permt_kernels_of<3>(), permt_kernels_of<4>(), permt_kernels_of<5>(),
+    permt_kernels_of<6>(), permt_kernels_of<7>(), permt_kernels_of<8>(), permt_kernels_of<9>(),
+    permt_kernels_of<10>()
+};
+
+/* Returns the kernels of S_n, NULL if there are none for that n */
+const PermtKernels* permt_kernels_get(int n){
+    if(n < PERMT_KERNEL_MIN_N || n > PERMT_KERNEL_MAX_N) return NULL;
+    return &permt_kernel_table[n - PERMT_KERNEL_MIN_N];
+}
+
 
 int take_power10(int n){
     int result = 1;
@@ -99,7 +129,9 @@ vector<pair<int, int>> transp_all_sn(int n){
 }
 
 //for a given permutation, this function will return the amount of inversions
-int permt_inversion_amount(vector<int> permt){
+int permt_inversion_amount(const vector<int>& permt){
+    const PermtKernels* kernels = permt_kernels_get(permt.size());
+    if(kernels != NULL) return kernels->inversions(permt.data());
     // the set of inversions for a permutation w = w1 w2 w3 is {(wi,wj) | i < j, wi > wj}
     int temp_permt[permt.size()];
     return divide_permt(permt, temp_permt, 0, permt.size() - 1).second;
@@ -287,6 +319,119 @@ int permt_first_right_descent(vector<int> permt){
     return -1;
 }
 
+/* Returns the index of the permutation inside 'all_p', without touching 'all_p_data'.
+ * 'permt_all_sn' lists the group in lexiographic order, so the index is the lehmer code of the
+ * permutation read as a factorial base number. Unlike all_p_data[permt] this never inserts anything,
+ * so it is safe to call from multiple threads at the same time. */
+int permt_rank(const vector<int>& permt){
+    const PermtKernels* kernels = permt_kernels_get(permt.size());
+    if(kernels != NULL) return kernels->rank(permt.data());
+    int result = 0;
+    for(int i = 0; i < permt.size(); i++){
+        int smaller_after = 0;
+        for(int j = i + 1; j < permt.size(); j++){
+            if(permt[j] < permt[i]) smaller_after++;
+        }
+        result = result * (permt.size() - i) + smaller_after;
+    }
+    return result;
+}
+
+/* Length and index of the permutation, like all_p_data[permt] but without inserting into the map, so it
+ * is thread safe. The length is taken from 'all_p_len' once it is filled for the group of the permutation,
+ * otherwise it is computed. */
+PermtData permt_data(const vector<int>& permt){
+    int index = permt_rank(permt);
+    if(!all_p.empty() && permt.size() == all_p[0].size() && index < all_p_len.size()) return {all_p_len[index], index};
+    return {permt_inversion_amount(permt), index};
+}
+
+// Right descents of the permutation as a bitmask, bit (i - 1) is set iff w(i) > w(i + 1)
+unsigned int permt_right_descent_mask(const vector<int>& permt){
+    const PermtKernels* kernels = permt_kernels_get(permt.size());
+    if(kernels != NULL) return kernels->right_descents(permt.data());
+    unsigned int result = 0;
+    for(int i = 0; i + 1 < permt.size(); i++){
+        if(permt[i] > permt[i + 1]) result |= 1u << i;
+    }
+    return result;
+}
+
+// Left descents of the permutation as a bitmask, bit (i - 1) is set iff i + 1 comes before i in line notation
+unsigned int permt_left_descent_mask(const vector<int>& permt){
+    const PermtKernels* kernels = permt_kernels_get(permt.size());
+    if(kernels != NULL) return kernels->left_descents(permt.data());
+    vector<int> position(permt.size() + 1);
+    for(int i = 0; i < permt.size(); i++) position[permt[i]] = i;
+    unsigned int result = 0;
+    for(int i = 1; i < permt.size(); i++){
+        if(position[i] > position[i + 1]) result |= 1u << (i - 1);
+    }
+    return result;
+}
+
+// One bitset for each s_i of S_n, made of the right descent masks of every permutation, see 'all_p_descent_bits'
+vector<vector<uint64_t>> permt_descent_bits(const vector<unsigned int>& right_descents, int n){
+    vector<vector<uint64_t>> result(max(n - 1, 0), vector<uint64_t>((right_descents.size() + 63) / 64, 0));
+    for(int k = 0; k < right_descents.size(); k++){
+        for(unsigned int mask = right_descents[k]; mask != 0; mask &= mask - 1){
+            result[__builtin_ctz(mask)][k >> 6] |= 1ull << (k & 63);
+        }
+    }
+    return result;
+}
+
+// Fills all_p_right_descents, all_p_left_descents and all_p_descent_bits, 'all_p' should be initialized beforehand
+void permt_descent_masks_initiate(void){
+    all_p_right_descents.resize(all_p.size()); all_p_left_descents.resize(all_p.size());
+    for(int i = 0; i < all_p.size(); i++){
+        all_p_right_descents[i] = permt_right_descent_mask(all_p[i]);
+        all_p_left_descents[i] = permt_left_descent_mask(all_p[i]);
+    }
+    all_p_descent_bits = permt_descent_bits(all_p_right_descents, all_p.empty() ? 0 : all_p[0].size());
+}
+
+/* Index of permt * s_i, read from 'all_p_right_multp' when the index tables are there, otherwise the kernel of
+ * the group computes it on the stack. Nothing is allocated unless n is bigger than PERMT_KERNEL_MAX_N. */
+int permt_right_multp_index(const vector<int>& permt, int permt_index, int i){
+    if(i - 1 < all_p_right_multp.size() && permt_index < all_p_right_multp[i - 1].size()) return all_p_right_multp[i - 1][permt_index];
+    const PermtKernels* kernels = permt_kernels_get(permt.size());
+    if(kernels == NULL) return permt_rank(permt_multp_right(permt, {i, i + 1}));
+    int product[PERMT_KERNEL_MAX_N];
+    kernels->multiply_right(permt.data(), i, product);
+    return kernels->rank(product);
+}
+
+// Fills all_p_inverse, all_p_w0_conjugate, all_p_right_multp and all_p_left_multp together with the
+// descent masks, 'all_p' should be initialized beforehand
+void permt_index_tables_initiate(void){
+    int f_n = all_p.size(), n = current_sn_group;
+    permt_descent_masks_initiate();
+    all_p_inverse.resize(f_n); all_p_w0_conjugate.resize(f_n);
+    all_p_right_multp.assign(n - 1, vector<int>(f_n)); all_p_left_multp.assign(n - 1, vector<int>(f_n));
+    const PermtKernels* kernels = permt_kernels_get(n);
+    vector<int> product(n);
+
+    for(int k = 0; k < f_n; k++){
+        all_p_inverse[k] = permt_rank(permt_inverse(all_p[k]));
+        // (w0 * w * w0)(j) = n + 1 - w(n + 1 - j)
+        vector<int> conjugate(n);
+        for(int j = 0; j < n; j++) conjugate[j] = n + 1 - all_p[k][n - 1 - j];
+        all_p_w0_conjugate[k] = permt_rank(conjugate);
+        for(int i = 1; i < n; i++){
+            if(kernels != NULL){
+                kernels->multiply_right(all_p[k].data(), i, product.data());
+                all_p_right_multp[i - 1][k] = kernels->rank(product.data());
+                kernels->multiply_left(all_p[k].data(), i, product.data());
+                all_p_left_multp[i - 1][k] = kernels->rank(product.data());
+                continue;
+            }
+            all_p_right_multp[i - 1][k] = permt_rank(permt_multp_right(all_p[k], {i, i + 1}));
+            all_p_left_multp[i - 1][k] = permt_rank(permt_multp_left(all_p[k], {i, i + 1}));
+        }
+    }
+}
+
 vector<int> permt_prompt(void){
   char temp_char = -1;
   string unit_element = "";
@@ -26,6 +26,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <map>     // dictionary like objects for cpp
 #include <utility> // for pairs
 #include <string>
+#include <cstdint>
 #endif // !PERMUTATION_BASICS
 
 // type definitions
@@ -58,6 +59,31 @@ extern std::vector<int> all_p_len;
  * permutation at hand is not known. all_p_data stores (key,value) pairs. */
 extern std::map<std::vector<int>, PermtData> all_p_data;
 
+/* Descent sets of permutations as bitmasks, layed out in the same order with all_p. Bit (i - 1) is set
+ * in all_p_right_descents[k] iff w(i) > w(i + 1), and in all_p_left_descents[k] iff i + 1 appears before i
+ * in the line notation of w, that is iff w^-1(i) > w^-1(i + 1). Initialize them with 'permt_descent_masks_initiate' */
+extern std::vector<unsigned int> all_p_right_descents;
+
+extern std::vector<unsigned int> all_p_left_descents;
+
+/* The same right descents as one bitset over all_p for each s_i: bit (k % 64) of all_p_descent_bits[i - 1][k / 64]
+ * is set iff all_p[k] * s_i < all_p[k]. Loops over z with a given descent walk the set bits with 'permt_bits_next'
+ * instead of reading every permutation, also initialized by 'permt_descent_masks_initiate' */
+extern std::vector<std::vector<uint64_t>> all_p_descent_bits;
+
+/* Index tables, so that common operations on permutations become a single array access, again layed out
+ * in the same order with all_p. all_p_inverse[k] is the index of the inverse of all_p[k], all_p_w0_conjugate[k]
+ * is the index of w0 * all_p[k] * w0 where w0 is the reverse identity. all_p_right_multp[i - 1][k] is the
+ * index of all_p[k] * s_i and all_p_left_multp[i - 1][k] the index of s_i * all_p[k], for s_i = (i, i + 1).
+ * Initialize them with 'permt_index_tables_initiate' */
+extern std::vector<int> all_p_inverse;
+
+extern std::vector<int> all_p_w0_conjugate;
+
+extern std::vector<std::vector<int>> all_p_right_multp;
+
+extern std::vector<std::vector<int>> all_p_left_multp;
+
 // function declaration
 
 int take_power10(int n);
@@ -72,7 +98,7 @@ std::vector<std::vector<int>> permt_all_sn(int n);
 
 std::vector<std::pair<int, int>> transp_all_sn(int n);
 
-int permt_inversion_amount(std::vector<int> permt);
+int permt_inversion_amount(const std::vector<int>& permt);
 
 std::pair<std::vector<int>, int> merge_permt(std::vector<int> permt, int temp_permt[], int left, int mid, int right);
 
@@ -98,6 +124,36 @@ std::vector<int> permt_right_descent(std::vector<int> permt);
 
 int permt_first_right_descent(std::vector<int> permt);
 
+int permt_rank(const std::vector<int>& permt);
+
+PermtData permt_data(const std::vector<int>& permt);
+
+unsigned int permt_right_descent_mask(const std::vector<int>& permt);
+
+unsigned int permt_left_descent_mask(const std::vector<int>& permt);
+
+std::vector<std::vector<uint64_t>> permt_descent_bits(const std::vector<unsigned int>& right_descents, int n);
+
+void permt_descent_masks_initiate(void);
+
+/* The first k with from <= k <= last whose bit is set, -1 if there is none. Words without a set bit are skipped
+ * at once, so about half of a descent class is never looked at. */
+inline int permt_bits_next(const std::vector<uint64_t>& bits, int from, int last){
+    if(from > last) return -1;
+    int word = from >> 6;
+    uint64_t current = bits[word] & (~0ull << (from & 63));
+    while(current == 0){
+        if(++word > (last >> 6)) return -1;
+        current = bits[word];
+    }
+    int k = (word << 6) + __builtin_ctzll(current);
+    return k <= last ? k : -1;
+}
+
+void permt_index_tables_initiate(void);
+
+int permt_right_multp_index(const std::vector<int>& permt, int permt_index, int i);
+
 std::vector<int> permt_prompt(void);
 
 std::string f_name_prompt(void);
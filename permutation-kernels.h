@@ -0,0 +1,188 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PERMUTATION_KERNELS
+#define PERMUTATION_KERNELS
+/*--------------------------------*/
+#ifndef PERMUTATION_BASICS
+#include "permutation-basics.h"
+#endif // !PERMUTATION_BASICS
+/*--------------------------------*/
+#include <array>
+#endif // !PERMUTATION_KERNELS
+
+/* Groups S_n with kernels, permutations of other sizes go to the generic functions of "permutation-basics.h" */
+#define PERMT_KERNEL_MIN_N 2
+#define PERMT_KERNEL_MAX_N 10
+
+/*
+ The innermost operations on permutations, written once for every n between PERMT_KERNEL_MIN_N and
+ PERMT_KERNEL_MAX_N. n is a template argument, so every loop has a bound known while compiling, and the lookup
+ tables below are built while compiling too. The Makefile compiles without optimizations, so the loops are kept
+ as they are there, most of the gain over the generic functions comes from working on bitmasks without any
+ allocation. The loops are only unrolled when CC is given an optimization flag, e.g. 'make CC="g++ -std=c++20 -O2"'.
+ A permutation is given as a pointer to its n values in line notation, 'vector::data()' of the usual vectors.
+
+ 'permt_kernels_get' picks the kernels of a group at run time. The functions of "permutation-basics.h" and
+ 'bruhat_compare' already go through it, code that calls a kernel for every pair of a group should get the
+ kernels once and call them through the table, like 'bruhat_matrix_worker_function'. Those calls go through
+ function pointers, so they are never inlined into the caller, whatever the optimization level is. Code that
+ knows n while compiling may call 'permt_kernel_inversions<N>' and the others directly, those can be inlined.
+
+ Sets of values are kept as bitmasks, bit v is set iff v is inside the set, so values up to 31 would fit.
+*/
+
+// type definitions
+
+struct PermtKernels
+{
+    int n;
+    int (*inversions)(const int* permt);                            // the length
+    unsigned int (*right_descents)(const int* permt);               // like 'permt_right_descent_mask'
+    unsigned int (*left_descents)(const int* permt);                // like 'permt_left_descent_mask'
+    int (*rank)(const int* permt);                                  // like 'permt_rank'
+    void (*unrank)(int rank, int* result);                          // 'all_p[rank]' without 'all_p'
+    void (*multiply_right)(const int* permt, int i, int* result);   // w * s_i
+    void (*multiply_left)(const int* permt, int i, int* result);    // s_i * w
+    bool (*bruhat_below)(const int* permt1, const int* permt2);     // like 'bruhat_compare', permt1 < permt2
+};
+
+/* Lookup tables of the kernels, they are built while compiling */
+template <int N>
+struct PermtKernelTables
+{
+    // factorials[k] = k!
+    static constexpr std::array<int, N + 1> factorials = []{
+        std::array<int, N + 1> result{};
+        result[0] = 1;
+        for(int k = 1; k <= N; k++) result[k] = result[k - 1] * k;
+        return result;
+    }();
+    // above[j] is the set of values bigger than j
+    static constexpr std::array<unsigned int, N + 1> above = []{
+        std::array<unsigned int, N + 1> result{};
+        for(int j = 0; j <= N; j++) result[j] = ((1u << (N + 1)) - 1) & ~((1u << (j + 1)) - 1);
+        return result;
+    }();
+    // below[v] is the set of values smaller than v
+    static constexpr std::array<unsigned int, N + 2> below = []{
+        std::array<unsigned int, N + 2> result{};
+        for(int v = 0; v <= N + 1; v++) result[v] = ((1u << v) - 1) & ~1u;
+        return result;
+    }();
+};
+
+// function declarations
+
+template <int N>
+int permt_kernel_inversions(const int* permt){
+    int result = 0;
+    for(int i = 0; i < N; i++){
+        for(int j = i + 1; j < N; j++) result += permt[i] > permt[j];
+    }
+    return result;
+}
+
+template <int N>
+unsigned int permt_kernel_right_descents(const int* permt){
+    unsigned int result = 0;
+    for(int i = 0; i + 1 < N; i++) result |= (unsigned int)(permt[i] > permt[i + 1]) << i;
+    return result;
+}
+
+template <int N>
+unsigned int permt_kernel_left_descents(const int* permt){
+    int position[N + 1];
+    for(int i = 0; i < N; i++) position[permt[i]] = i;
+    unsigned int result = 0;
+    for(int i = 1; i < N; i++) result |= (unsigned int)(position[i] > position[i + 1]) << (i - 1);
+    return result;
+}
+
+/* The lehmer code read as a factorial base number, an entry of the code is the amount of smaller values that are not used yet */
+template <int N>
+int permt_kernel_rank(const int* permt){
+    unsigned int used = 0;
+    int result = 0;
+    for(int i = 0; i < N; i++){
+        int smaller_after = permt[i] - 1 - __builtin_popcount(used & PermtKernelTables<N>::below[permt[i]]);
+        result += smaller_after * PermtKernelTables<N>::factorials[N - 1 - i];
+        used |= 1u << permt[i];
+    }
+    return result;
+}
+
+template <int N>
+void permt_kernel_unrank(int rank, int* result){
+    unsigned int unused = PermtKernelTables<N>::above[0];
+    for(int i = 0; i < N; i++){
+        int smaller_after = rank / PermtKernelTables<N>::factorials[N - 1 - i];
+        rank %= PermtKernelTables<N>::factorials[N - 1 - i];
+        // the unused value with 'smaller_after' unused values below it
+        unsigned int candidates = unused;
+        for(int k = 0; k < smaller_after; k++) candidates &= candidates - 1;
+        result[i] = __builtin_ctz(candidates);
+        unused &= ~(1u << result[i]);
+    }
+}
+
+/* s_i = (i, i + 1), from right it swaps the positions i and i + 1 */
+template <int N>
+void permt_kernel_multiply_right(const int* permt, int i, int* result){
+    for(int k = 0; k < N; k++) result[k] = permt[k];
+    result[i - 1] = permt[i]; result[i] = permt[i - 1];
+}
+
+/* From left it swaps the values i and i + 1 */
+template <int N>
+void permt_kernel_multiply_left(const int* permt, int i, int* result){
+    for(int k = 0; k < N; k++) result[k] = permt[k] == i ? i + 1 : (permt[k] == i + 1 ? i : permt[k]);
+}
+
+/*
+ The criterion of 'bruhat_compare': permt1 <= permt2 iff for every i and j the amount of values bigger than j
+ among the first i values of permt1 is at most the same amount for permt2. The first i values are kept as a set,
+ the last position does not need to be checked since both sets are every value there.
+*/
+template <int N>
+bool permt_kernel_bruhat_below(const int* permt1, const int* permt2){
+    unsigned int first1 = 0, first2 = 0;
+    bool equal = true;
+    for(int i = 0; i + 1 < N; i++){
+        first1 |= 1u << permt1[i]; first2 |= 1u << permt2[i];
+        equal = equal && permt1[i] == permt2[i];
+        if(first1 == first2) continue;
+        for(int j = 1; j < N; j++){
+            if(__builtin_popcount(first1 & PermtKernelTables<N>::above[j]) > __builtin_popcount(first2 & PermtKernelTables<N>::above[j]))
+                return false;
+        }
+    }
+    // an element is not bruhat comparable to itself, the first n - 1 values decide the last one
+    return !equal;
+}
+
+template <int N>
+constexpr PermtKernels permt_kernels_of(void){
+    return {N, permt_kernel_inversions<N>, permt_kernel_right_descents<N>, permt_kernel_left_descents<N>,
+            permt_kernel_rank<N>, permt_kernel_unrank<N>, permt_kernel_multiply_right<N>,
+            permt_kernel_multiply_left<N>, permt_kernel_bruhat_below<N>};
+}
+
+const PermtKernels* permt_kernels_get(int n = current_sn_group);
@@ -1,20 +1,38 @@
 #include "polynomials.h"
+#include "k-l-log.h"
+#include "k-l-shm.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <charconv>
+#include <cstring>
+#include <array>
+#include <string_view>
+#include <thread>
 using namespace std;
 
 /* ---------------------------- GLOBAL VARIABLES ------------------------------------------------------ */
 
+// Every distinct polynomial inside the databases, ID 0 is the placeholder polynomial without coefficients
+std::deque<Polynomial> polynom_pool(1);
+
+// IDs of the polynomials inside 'polynom_pool', they are hashed by their coefficients
+static unordered_map<PolynomialCoefficients, uint32_t, PolynomialHash> polynom_pool_ids;
+static shared_mutex polynom_pool_lock;
+
 // The database that is used to calculate K-L polynomials more efficiently
-// The dummy polynomial that is just used as a placeholder is -q^-1 , which is theoratically not a polynomial
-std::vector<std::vector<Polynomial>> k_l_database(100, vector<Polynomial>(100));
+// The dummy polynomial that is just used as a placeholder is ID 0 inside 'polynom_pool'
+std::vector<std::vector<uint32_t>> k_l_database(100, vector<uint32_t>(100));
 
 // The temporary database used to store elements that are not in k_l_database, when the program ends
-// this should be appended to the specified database_name file, by default "KL-database.txt"
-// The dummy polynomial that is just used as a placeholder is -q^-1 , which is theoratically not a polynomial
-std::vector<std::vector<Polynomial>> temp_database(100, vector<Polynomial>(100));
+// this should be appended to the specified database_name file, by default "KL-database<number>.bin"
+// The dummy polynomial that is just used as a placeholder is ID 0 inside 'polynom_pool'
+std::vector<std::vector<uint32_t>> temp_database(100, vector<uint32_t>(100));
 
 // The name of the file containing the database, change this value as required.
-// The program will add the number 'n' and the file extension '.txt' at the end of this, each S_n group will
-// have its own database file. For example 'KL-database4.txt' for S_4 etc.
+// The program will add the number 'n' and the file extension '.bin' at the end of this, each S_n group will
+// have its own database file. For example 'KL-database4.bin' for S_4 etc.
 // The number 'n' comes from the global variable 'current_sn_group' defined in "permutation-basics.h"
 string database_name = "KL-database";
 
@@ -26,36 +44,37 @@ pair<bruhat_graph, map<std::vector<int>, PermtData>> bruhat_data = {};
 /* -----------------------------------------------------------------------------------------------------*/
 
 // Returns poly1 + poly2
-Polynomial polynom_add(Polynomial poly1, Polynomial poly2){
+Polynomial polynom_add(Polynomial poly1, const Polynomial& poly2){
+    K_L_STATS_ADD(K_L_STATS_POLY_ADD, 1);
     for(auto itr = poly2.coefficients.begin(); itr != poly2.coefficients.end(); itr++){
-        auto fitr = poly1.coefficients.find(itr->first);
-
-        if(fitr != poly1.coefficients.end()) fitr->second += itr->second;
-        else poly1.coefficients[itr->first] = itr->second;
+        auto fitr = poly1.coefficients.try_emplace(itr->first, itr->second);
+        if(!fitr.second) fitr.first->second += itr->second;
     }
     return poly1; // changes are made on poly1, so this becomes the result
 }
 
 // Returns poly1 - poly2
-Polynomial polynom_subtract(Polynomial poly1, Polynomial poly2){
-    // multiplying poly2 with -1
+Polynomial polynom_subtract(Polynomial poly1, const Polynomial& poly2){
+    K_L_STATS_ADD(K_L_STATS_POLY_SUBTRACT, 1);
+    // adding poly2 multiplied with -1
     for(auto itr = poly2.coefficients.begin(); itr != poly2.coefficients.end(); itr++){
-        itr->second *= -1;
+        auto fitr = poly1.coefficients.try_emplace(itr->first, -itr->second);
+        if(!fitr.second) fitr.first->second += -itr->second;
     }
-    return polynom_add(poly1, poly2);
+    return poly1;
 }
 
 // Returns poly1 * poly2
-Polynomial polynom_multiply(Polynomial poly1, Polynomial poly2){
+Polynomial polynom_multiply(const Polynomial& poly1, const Polynomial& poly2){
+    K_L_STATS_ADD(K_L_STATS_POLY_MULTIPLY, 1);
     Polynomial result;
     for(auto itr = poly1.coefficients.begin(); itr != poly1.coefficients.end(); itr++){
         pair<int, int> cur_element = {itr->first, itr->second};
-        Polynomial poly_temp2;
         for(auto itr2 = poly2.coefficients.begin(); itr2 != poly2.coefficients.end(); itr2++){
-            poly_temp2.coefficients.clear();
             // The power adds up , the coefficient is multiplied
-            poly_temp2.coefficients[cur_element.first + itr2->first] = cur_element.second * itr2->second;
-            result = polynom_add(result, poly_temp2);
+            float coefficient = cur_element.second * itr2->second;
+            auto fitr = result.coefficients.try_emplace(cur_element.first + itr2->first, coefficient);
+            if(!fitr.second) fitr.first->second += coefficient;
         }
     }
     return result;
@@ -70,72 +89,181 @@ void polynom_display(FILE* ifp, Polynomial poly){
     }
 }
 
-// This function takes a valid file_name input, and stores the data inside the file
-// using the k_l_database global variable
+size_t PolynomialHash::operator()(const PolynomialCoefficients& coefficients) const{
+    size_t result = coefficients.size();
+    for(auto itr = coefficients.begin(); itr != coefficients.end(); itr++){
+        result = result * 1000003 ^ hash<float>()(itr->first);
+        result = result * 1000003 ^ hash<float>()(itr->second);
+    }
+    return result;
+}
+
+/* Returns the ID of the polynomial inside 'polynom_pool', the polynomial is added to the pool if it is not
+ * there yet. Two polynomials have the same ID iff they have the same coefficients. */
+uint32_t polynom_pool_intern(const Polynomial& poly){
+    if(poly.coefficients.empty()) return 0;
+    {
+        shared_lock<shared_mutex> guard(polynom_pool_lock);
+        auto fitr = polynom_pool_ids.find(poly.coefficients);
+        if(fitr != polynom_pool_ids.end()) return fitr->second;
+    }
+    unique_lock<shared_mutex> guard(polynom_pool_lock);
+    auto result = polynom_pool_ids.insert({poly.coefficients, (uint32_t)polynom_pool.size()});
+    if(result.second) polynom_pool.push_back(poly);
+    return result.first->second;
+}
+
+Polynomial polynom_pool_get(uint32_t id){
+    shared_lock<shared_mutex> guard(polynom_pool_lock);
+    return polynom_pool[id];
+}
+
+/* The same with 'polynom_pool_get' without the copy. Polynomials are never moved or changed once they are inside
+ * the pool, so the reference stays valid after the lock is released. */
+const Polynomial& polynom_pool_at(uint32_t id){
+    shared_lock<shared_mutex> guard(polynom_pool_lock);
+    return polynom_pool[id];
+}
+
+uint32_t polynom_pool_size(void){
+    shared_lock<shared_mutex> guard(polynom_pool_lock);
+    return polynom_pool.size();
+}
+
+/*
+ Loads the database of the group in 'current_sn_group'. The binary database 'KL-database<number>.bin' is
+ memory mapped, see "k-l-store.h", so nothing is parsed no matter how large it is. If there is only the
+ older text database 'KL-database<number>.txt', it is converted to the binary one first, this happens once.
+ Polynomials that were logged but not merged into the database yet are put into 'temp_database', and new
+ ones are logged from now on, see "k-l-log.h".
+*/
 void k_l_database_initiate(void){
-    ostringstream s; s << database_name << current_sn_group << ".txt";
+    k_l_log_close();
     k_l_database.clear();
-    FILE* ifp = fopen(s.str().c_str(), "r"); char c = 0;
+    if(!k_l_store_open()){
+        if(k_l_store_convert_text()){
+            printf("  Converted the text K-L database to %s\n", k_l_store_file_name().c_str());
+            k_l_store_open();
+        }
+        /* The conversion may fail if the directory is not writable, the text database is still usable then */
+        else if(!k_l_database_read_text()) printf("  K-L polynomial database file does not exits, creating a new one...\n");
+    }
+    k_l_log_open();
+}
 
-    /* If the file does not exist yet, just quit */
-    if(ifp == NULL){printf("  K-L polynomial database file does not exits, creating a new one...\n"); return;}
-
-    c = getc(ifp);
-    string unit_element;
-    vector<float> temp_vec_float;
-    pair<int, int> temp_pair; Polynomial temp_poly;
-    while(c != EOF){
-        if(c == '\n'){
-            c = getc(ifp); continue;
+/* Parses the lines of the text database between 'begin' and 'end' into (u_index, v_index, ID) triples.
+ * Lines that do not follow the format, or have an index that is not below 'group_size', are skipped. This does
+ * not have a meaning on its own, it is a part of 'k_l_database_read_text', several of them may run at once on
+ * different parts of the file. */
+static void read_text_chunk(const char* begin, const char* end, uint32_t group_size, vector<array<uint32_t, 3>>* entries){
+    const char* position = begin;
+    Polynomial temp_poly;
+    // the same few polynomials appear on almost every line, so their text is mapped to their ID directly
+    unordered_map<string_view, uint32_t> known_ids;
+    while(position < end){
+        const char* line_end = (const char*)memchr(position, '\n', end - position);
+        if(line_end == NULL) line_end = end;
+
+        uint32_t u_index, v_index;
+        auto result = from_chars(position, line_end, u_index);
+        bool valid = result.ec == errc() && result.ptr < line_end && *result.ptr == ':';
+        if(valid){
+            result = from_chars(result.ptr + 1, line_end, v_index);
+            valid = result.ec == errc() && result.ptr + 1 < line_end && result.ptr[0] == '=' && result.ptr[1] == '{';
         }
-        else if(c == '='){
-            temp_pair.second = stoi(unit_element);
-            unit_element.clear();
+        // the indexes size the rows of 'k_l_database', a damaged line must not make them huge
+        valid = valid && u_index < group_size && v_index < group_size;
+        if(!valid){ position = line_end + 1; continue; }
+
+        // k-l polynomial is put between curly brackets, as pairs of power and coefficient
+        const char* cursor = result.ptr + 2;
+        const char* closing = (const char*)memchr(cursor, '}', line_end - cursor);
+        if(closing == NULL){ position = line_end + 1; continue; }
+        auto fitr = known_ids.find(string_view(cursor, closing - cursor));
+        if(fitr != known_ids.end()){
+            entries->push_back({u_index, v_index, fitr->second});
+            position = line_end + 1; continue;
         }
-        else if(c == ':'){
-            temp_pair.first = stoi(unit_element);
-            unit_element.clear();
+
+        temp_poly.coefficients.clear();
+        while(valid){
+            while(cursor < line_end && *cursor == ' ') cursor++;
+            if(cursor < line_end && *cursor == '}') break;
+            float power, coefficient;
+            auto power_result = from_chars(cursor, line_end, power);
+            if(power_result.ec != errc() || power_result.ptr >= line_end || *power_result.ptr != ' '){ valid = false; break; }
+            auto coefficient_result = from_chars(power_result.ptr + 1, line_end, coefficient);
+            if(coefficient_result.ec != errc()){ valid = false; break; }
+            temp_poly.coefficients[power] = coefficient;
+            cursor = coefficient_result.ptr;
         }
-        // k-l polynomial is put between curly brackets, it is handled here in a separate while loop
-        else if(c == '{'){
-            c = getc(ifp);
-            while(c != '}'){
-                if(c == ' '){
-                    temp_vec_float.push_back(stof(unit_element));
-                    unit_element.clear();
-                }
-                else unit_element.push_back(c); c = getc(ifp);
-            }
-            // the last element is added here
-            temp_vec_float.push_back(stof(unit_element));
-            unit_element.clear();
-
-            // Now using the data in temp_vec_float we can construct our polynomial
-            /* Example template -> 1 2 3 4:4 3 2 1={0 1} */
-            for(int i = 0; i < temp_vec_float.size() - 1; i +=2){
-                temp_poly.coefficients[temp_vec_float[i]] = temp_vec_float[i+1];
-            }
-            // We map the pair of permutations to their corresponding k-l polynomial
-            try {
-                k_l_database.at(temp_pair.first).at(temp_pair.second) = temp_poly;
-            } catch (const out_of_range& error) {
-                /* If out of range is returned, make sure vector allocates enough space*/
-                if(k_l_database.size() < temp_pair.first + 1) k_l_database.resize(temp_pair.first+1); /* +1 for index*/
-                if(k_l_database[temp_pair.first].size() < temp_pair.second + 1){
-                    k_l_database[temp_pair.first].resize(temp_pair.second+1); /* +1 for index*/
-                }
-                k_l_database.at(temp_pair.first).at(temp_pair.second) = temp_poly;
-            }
-            // Resetting necessary variables
-            temp_poly.coefficients.clear(); temp_vec_float.clear(); /* temp_pair = {};  Already overwritten*/
+        if(valid && !temp_poly.coefficients.empty()){
+            uint32_t temp_id = polynom_pool_intern(temp_poly);
+            known_ids[string_view(result.ptr + 2, closing - result.ptr - 2)] = temp_id;
+            entries->push_back({u_index, v_index, temp_id});
         }
-        else{
-            unit_element.push_back(c);
+        position = line_end + 1;
+    }
+}
+
+/*
+ Reads the text database 'KL-database<number>.txt' into 'k_l_database', returns false if there is no such file.
+ Each line looks like the following:    u_index:v_index={power coefficient power coefficient ...}
+ The file is memory mapped and cut into 'thread_amount' parts at line ends (one per core if it is 0), each part
+ is parsed on its own thread. Rows of 'k_l_database' are then sized once, before the IDs are put in.
+*/
+bool k_l_database_read_text(int thread_amount){
+    ostringstream s; s << database_name << current_sn_group << ".txt";
+    k_l_database.clear();
+    int fd = open(s.str().c_str(), O_RDONLY);
+
+    /* If the file does not exist yet, just quit */
+    if(fd == -1) return false;
+    struct stat file_info;
+    if(fstat(fd, &file_info) == -1 || file_info.st_size == 0){ close(fd); return true; }
+    size_t size = file_info.st_size;
+    void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) return false;
+    madvise(map, size, MADV_SEQUENTIAL);
+    const char* data = (const char*)map;
+
+    if(thread_amount <= 0) thread_amount = max(1u, thread::hardware_concurrency());
+    // small files are not worth the threads, 1MB for each of them at least
+    thread_amount = max(1, min<int>(thread_amount, size / (1 << 20)));
+
+    vector<const char*> bounds = {data};
+    for(int k = 1; k < thread_amount; k++){
+        const char* cut = max(bounds.back(), data + size * k / thread_amount);
+        const char* line_end = (const char*)memchr(cut, '\n', data + size - cut);
+        bounds.push_back(line_end == NULL ? data + size : line_end + 1);
+    }
+    bounds.push_back(data + size);
+
+    vector<vector<array<uint32_t, 3>>> entries(thread_amount);
+    vector<thread> workers;
+    uint32_t group_size = factorial(current_sn_group);
+    for(int k = 1; k < thread_amount; k++) workers.emplace_back(read_text_chunk, bounds[k], bounds[k + 1], group_size, &entries[k]);
+    read_text_chunk(bounds[0], bounds[1], group_size, &entries[0]);
+    for(auto witr = workers.begin(); witr != workers.end(); witr++) witr->join();
+    munmap(map, size);
+
+    // sizing every row once, then filling it
+    vector<uint32_t> row_sizes;
+    for(auto eitr = entries.begin(); eitr != entries.end(); eitr++){
+        for(auto itr = eitr->begin(); itr != eitr->end(); itr++){
+            if(row_sizes.size() <= (*itr)[0]) row_sizes.resize((*itr)[0] + 1, 0);
+            row_sizes[(*itr)[0]] = max(row_sizes[(*itr)[0]], (*itr)[1] + 1);
         }
-        c = getc(ifp);
     }
-    fclose(ifp);
+    k_l_database.resize(row_sizes.size());
+    for(int i = 0; i < row_sizes.size(); i++) k_l_database[i].assign(row_sizes[i], 0);
+    for(auto eitr = entries.begin(); eitr != entries.end(); eitr++){
+        for(auto itr = eitr->begin(); itr != eitr->end(); itr++) k_l_database[(*itr)[0]][(*itr)[1]] = (*itr)[2];
+    }
+    return true;
 }
+
 /*
  This function accepts a pair of permutations, and checks whether or not k-l polynomial
  for those permutations is inside the database
@@ -145,81 +273,106 @@ void k_l_database_initiate(void){
  Providing v1_index or v2_index as an argument is not necessary, but in case it is provided, it will be used
 */
 pair<bool, Polynomial> k_l_database_check(pair<vector<int>, vector<int>> p, int v1_index, int v2_index){
-    if(v1_index == -1) v1_index = all_p_data[p.first].index;
-    if(v2_index == -1) v2_index = all_p_data[p.second].index;
-    Polynomial p_wanted, p_dummy;
+    if(v1_index == -1) v1_index = permt_rank(p.first);
+    if(v2_index == -1) v2_index = permt_rank(p.second);
+    return k_l_database_check(v1_index, v2_index);
+}
 
-    try {
-        p_wanted = k_l_database.at(v1_index).at(v2_index);
-    } catch (const out_of_range& error) {
-        p_wanted = p_dummy;
+/* The same with the function above when both indexes are known, the permutations are not copied */
+pair<bool, Polynomial> k_l_database_check(int v1_index, int v2_index){
+    uint32_t id = k_l_database_check_id(v1_index, v2_index);
+    if(id == 0) return {false, Polynomial()};
+    return {true, polynom_pool_get(id)};
+}
+
+/* The same with the function above, but returns the ID of the polynomial inside 'polynom_pool', or 0 if it is not
+ * inside any database. Nothing is copied, the recursions use 'polynom_pool_at' once they need the coefficients. */
+uint32_t k_l_database_check_id(int v1_index, int v2_index){
+    uint32_t id = k_l_database_check_index(v1_index, v2_index);
+    // Polynomials are stored under the representative of their pair, see "k-l-symmetry.h". Database files
+    // written before that may contain the pair itself, which is why it is checked first.
+    if(id == 0 && b_matrix != NULL && k_l_symmetry_ready() && b_matrix[v1_index][v2_index] == 1){
+        auto canonical = k_l_symmetry_canonical(v1_index, v2_index);
+        if(canonical.first == canonical.second){
+            static const uint32_t one_id = polynom_pool_intern({{{0,1}}});
+            return one_id;
+        }
+        if(canonical != make_pair(v1_index, v2_index)) id = k_l_database_check_index(canonical.first, canonical.second);
     }
+    return id;
+}
+
+/* The part of 'k_l_database_check_id' that looks at the databases, for the exact pair of indexes that is given */
+uint32_t k_l_database_check_index(int v1_index, int v2_index){
+    uint32_t id = 0; /* the placeholder */
 
+    if(v1_index < k_l_database.size() && v2_index < k_l_database[v1_index].size()) id = k_l_database[v1_index][v2_index];
+    if(id != 0) K_L_STATS_ADD(K_L_STATS_HIT_DATABASE, 1);
     // if not found in k_l_database
-    if(p_wanted.coefficients == p_dummy.coefficients){
-        try {
-            p_wanted = temp_database.at(v1_index).at(v2_index);
-        } catch (const out_of_range& error) {
-            p_wanted = p_dummy;
+    if(id == 0 && v1_index < temp_database.size() && v2_index < temp_database[v1_index].size()){
+        id = temp_database[v1_index][v2_index];
+        if(id != 0) K_L_STATS_ADD(K_L_STATS_HIT_TEMP, 1);
+    }
+    // then the binary database
+    if(id == 0){
+        id = k_l_store_lookup_id(v1_index, v2_index);
+        if(id != 0) K_L_STATS_ADD(K_L_STATS_HIT_STORE, 1);
+    }
+
+    // the last place to look at is what other processes on this machine computed, see "k-l-shm.h"
+    // they are interned, so the next lookup of the same polynomial finds it inside the pool
+    if(id == 0){
+        Polynomial shared_poly;
+        if(k_l_shm_lookup(v1_index, v2_index, shared_poly)){
+            K_L_STATS_ADD(K_L_STATS_HIT_SHM, 1);
+            return polynom_pool_intern(shared_poly);
         }
-        // if found in the temp_database
-        if(p_wanted.coefficients != p_dummy.coefficients) return {true, p_wanted};
-        else return {false, p_wanted};
+        K_L_STATS_ADD(K_L_STATS_MISS, 1);
     }
-    // if found in k_l_database
-    else return {true, p_wanted};
+    return id;
 }
 
 /*
  This function does what you think it does
- Given a pair of permutations (order is important!) and their k-l polynomial
- this function will append it to the database for later use
- -- The filename for the database is taken from the global variable 'database_name' --
- An example database entry looks like the following:
-         1 2 3 4 5:5 4 3 2 1={0 1}
- Format: permt1_with_whitespaces:permt2_with_whitespace={k_l_poly_coefficients}
- For more info consider looking at the definition for 'Polynomial' in polynomails.h
- The function appends the data in 'temp_database' variable at the end of the file.
+ Every polynomial in 'temp_database' is already inside the log 'KL-database<number>.log', this merges the log
+ into the binary database 'KL-database<number>.bin' and opens the result. Pairs that are already inside the
+ database are never logged, so the file does not grow with duplicates. The filename for the database is taken
+ from the global variable 'database_name'. For the layout of the files look at "k-l-store.h" and "k-l-log.h".
 */
 void k_l_database_append(){
-    ostringstream s; s << database_name << current_sn_group << ".txt";
-    FILE* ifp = fopen(s.str().c_str(), "a");
-    /*If the file does not exist*/
-    if(ifp == NULL) ifp = fopen(s.str().c_str(), "w");
-
-    Polynomial p_dummy; /*The impossible polynomial, just a placeholder*/
-    if(!temp_database.empty())
-        for(int i = 0; i < temp_database.size(); i++){
-            for(int j = 0; j < temp_database[i].size(); j++){
-                /* Do not write the placeholder data to the file*/
-                if(temp_database[i][j].coefficients == p_dummy.coefficients) continue;
-                else{
-                    fprintf(ifp, "%d", i); fprintf(ifp, ":"); fprintf(ifp, "%d={", j);
-                    int k = 0; auto itr = temp_database[i][j].coefficients.begin();
-                    for( ; k < temp_database[i][j].coefficients.size() - 1; k++){
-                        fprintf(ifp, "%.0f %.0f ", itr->first, itr->second); itr++;
-                    }
-                    fprintf(ifp, "%.0f %.0f}\n", itr->first, itr->second);
-                }
-            }
-        }
-    fclose(ifp); temp_database.clear();
+    K_L_STATS_PHASE(K_L_STATS_NS_PERSISTENCE);
+    k_l_log_compact();
+    temp_database.clear();
 }
 
-/* A convenient way to deal with temp_database variable while program is executing.*/
-void temp_database_append(pair<int, int> vec_indexes, Polynomial temp_poly){
+/* A convenient way to deal with temp_database variable while program is executing.
+ * The polynomial is also appended to the log and shared with other processes unless 'write_log' is false. */
+void temp_database_append(pair<int, int> vec_indexes, Polynomial temp_poly, bool write_log){
+    if(write_log){
+        k_l_log_append(vec_indexes.first, vec_indexes.second, temp_poly);
+        k_l_shm_publish(vec_indexes.first, vec_indexes.second, temp_poly);
+    }
+    uint32_t temp_id = polynom_pool_intern(temp_poly);
     try {
-        temp_database.at(vec_indexes.first).at(vec_indexes.second) = temp_poly;
+        temp_database.at(vec_indexes.first).at(vec_indexes.second) = temp_id;
     } catch (const out_of_range& error) {
         /* If out of range is returned, make sure vector allocates enough space*/
         if(temp_database.size() < vec_indexes.first + 1) temp_database.resize(vec_indexes.first+1); /* +1 for index*/
         if(temp_database[vec_indexes.first].size() < vec_indexes.second + 1){
             temp_database[vec_indexes.first].resize(vec_indexes.second+1); /* +1 for index*/
         }
-        temp_database.at(vec_indexes.first).at(vec_indexes.second) = temp_poly;
+        temp_database.at(vec_indexes.first).at(vec_indexes.second) = temp_id;
     }
 }
 
+/* True iff every coefficient is 0, the same with polynom_add(poly, poly) == poly without building the sum */
+static bool polynom_is_zero(const Polynomial& poly){
+    for(auto itr = poly.coefficients.begin(); itr != poly.coefficients.end(); itr++){
+        if(itr->second != 0) return false;
+    }
+    return true;
+}
+
 /*
  This stands for the Kazhdan-Lustzig polynomial
  Before using this please initiate the database with k_l_database_initiate function defined above
@@ -232,12 +385,12 @@ void temp_database_append(pair<int, int> vec_indexes, Polynomial temp_poly){
  manually by the programmer, BEFOREHAND
  ** 'all_p_data', for more info please look at "permutation-basics.h"
 */                                                                                      /* True by default ~~ */
-Polynomial polynom_k_l(vector<int> u, vector<int> v, PermtData u_data, PermtData v_data, bool check_database){
+Polynomial polynom_k_l(const vector<int>& u, const vector<int>& v, PermtData u_data, PermtData v_data, bool check_database){
     // By definition, if u = v then P(u, v) = 1
     if(u == v) return {{{0,1}}}; // this is 1*q^0 = 1
 
-    if(u_data.length == -1 ) u_data = all_p_data[u];
-    if(v_data.length == -1 ) v_data = all_p_data[v];
+    if(u_data.length == -1 ) u_data = permt_data(u);
+    if(v_data.length == -1 ) v_data = permt_data(v);
 
     int u_index = u_data.index;
     int v_index = v_data.index, v_len = v_data.length;
@@ -248,15 +401,28 @@ Polynomial polynom_k_l(vector<int> u, vector<int> v, PermtData u_data, PermtData
     int max_len = ((v.size() * (v.size() - 1)) / 2);
     if(v_len == max_len) return {{{0, 1}}}; // if this is the case then v is reverse identity, which means P(u,v)=1
 
-    // dummy variable to be used on database checking operations
-    pair<bool, Polynomial> dummy;
+    // Only the representative of the pair is computed and stored, it has the same polynomial
+    // look at "k-l-symmetry.h" for more info, this is skipped if the index tables are not initialized
+    if(k_l_symmetry_ready()){
+        auto canonical = k_l_symmetry_canonical(u_index, v_index);
+        if(canonical != make_pair(u_index, v_index)){
+            return polynom_k_l(all_p[canonical.first], all_p[canonical.second],
+                               {all_p_len[canonical.first], canonical.first},
+                               {all_p_len[canonical.second], canonical.second}, check_database);
+        }
+    }
+
+    // ID of the polynomial inside 'polynom_pool' on database checking operations, 0 if it is not found
+    // the polynomial itself is only looked at once its coefficients are needed, see 'polynom_pool_at'
+    uint32_t found_id;
 
     if(check_database){
-        // as the name suggests, this is a dummy variable, it is not used in the definition of the polynomial
-        dummy = k_l_database_check({u,v}, u_index, v_index);
+        found_id = k_l_database_check_id(u_index, v_index);
         // if we have the answer already in the database, we may return here
-        if(dummy.first) return dummy.second;
+        if(found_id != 0) return polynom_pool_at(found_id);
     }
+    K_L_STATS_FRAME();
+    k_l_progress_pair();
     // finding the first 'i' where v(i) > v(i + 1)
     int i = permt_first_right_descent(v) - 1, c; /* -1 is for index*/
 
@@ -266,27 +432,30 @@ Polynomial polynom_k_l(vector<int> u, vector<int> v, PermtData u_data, PermtData
 
     /* The elements that are between u and v with respect to bruhat order will be important later on
      * we will handle it here, we say u <= z <= v , variable z_map will contain indexes of permutations
-     * that stay between u and v with respect to bruhat order. */
-    vector<int> z_map = bruhat_matrix_interval(u, v, u_index, v_index);
-
-    pair<int, int> s_i = {i+1, i+2}; // +1 is added, because -1 was subtracted from i above
-    Polynomial result, poly_temp, poly_temp2; vector<int> temp_vec, temp_vec2;
-    temp_vec = permt_multp_right(u, s_i); temp_vec2 = permt_multp_right(v, s_i);
-
-    PermtData temp_vec_data = all_p_data[temp_vec], temp_vec2_data = all_p_data[temp_vec2];
-    int temp_vec_index = temp_vec_data.index;
-    int temp_vec2_index = temp_vec2_data.index;
-
-    // as the name suggest, this is a dummy variable, it is not used in the definition of the polynomial
-    dummy = k_l_database_check({temp_vec, temp_vec2}, temp_vec_index, temp_vec2_index);
-
-    if(dummy.first){ // if we already have the k-l polynomial in the database, we directly use it here
-        poly_temp = polynom_multiply({{{1-c, 1}}}, dummy.second);
+     * that stay between u and v with respect to bruhat order and have the descent z(i) > z(i+1), the others
+     * are never looked at, see 'all_p_descent_bits'. It is scratch memory of this frame, taken from the
+     * arena of the thread, see "k-l-arena.h". */
+    KLArenaFrame frame;
+    int* z_map = frame.allocate<int>(all_p.size());
+    int z_amount = bruhat_matrix_interval_descents(u_index, v_index, i+1, z_map);
+    frame.shrink<int>(all_p.size(), z_amount);
+
+    // u*s_i and v*s_i are taken from 'all_p', so nothing is copied
+    Polynomial result, poly_temp, poly_temp2;
+    int temp_vec_index = permt_right_multp_index(u, u_index, i+1);
+    int temp_vec2_index = permt_right_multp_index(v, v_index, i+1);
+    PermtData temp_vec_data = {all_p_len[temp_vec_index], temp_vec_index};
+    PermtData temp_vec2_data = {all_p_len[temp_vec2_index], temp_vec2_index};
+
+    found_id = k_l_database_check_id(temp_vec_index, temp_vec2_index);
+
+    if(found_id != 0){ // if we already have the k-l polynomial in the database, we directly use it here
+        poly_temp = polynom_multiply({{{1-c, 1}}}, polynom_pool_at(found_id));
         result = polynom_add(result, poly_temp);
     }
     else{ // otherwise more calculation is needed
         /* Calling the function again with checkted_database = false */
-        poly_temp = polynom_k_l(temp_vec, temp_vec2, temp_vec_data, temp_vec2_data, false);
+        poly_temp = polynom_k_l(all_p[temp_vec_index], all_p[temp_vec2_index], temp_vec_data, temp_vec2_data, false);
 
         /* Obtained polynomial will not be inside the database, so we shall add it to temp_database for later use
          * When we call 'polynom_k_l' above, it will already try to add it for us, on its own stack
@@ -298,15 +467,16 @@ Polynomial polynom_k_l(vector<int> u, vector<int> v, PermtData u_data, PermtData
         result = polynom_add(result, poly_temp);
     }
 
-    temp_vec = permt_multp_right(v, s_i);
-    temp_vec_data = all_p_data[temp_vec];
-    temp_vec_index = temp_vec_data.index;
+    // from now on temp_vec is v*s_i
+    temp_vec_index = temp_vec2_index;
+    temp_vec_data = temp_vec2_data;
+    const vector<int>& temp_vec = all_p[temp_vec_index];
 
-    dummy = k_l_database_check({u, temp_vec}, u_index, temp_vec_index);
+    found_id = k_l_database_check_id(u_index, temp_vec_index);
 
     // Here, we apply a very similar procedure to the one above
-    if(dummy.first){
-        poly_temp = polynom_multiply({{{c, 1}}}, dummy.second);
+    if(found_id != 0){
+        poly_temp = polynom_multiply({{{c, 1}}}, polynom_pool_at(found_id));
         result = polynom_add(result, poly_temp);
     }
     else{
@@ -326,92 +496,109 @@ Polynomial polynom_k_l(vector<int> u, vector<int> v, PermtData u_data, PermtData
     // This is where it gets really spicy, for any u < z < v with respect to bruhat order, if z(i) > z(i+1)
     // according to the definition, one needs to subtract μ(z, v*s_i) * q^[(l_v - l_z)/2] * P(u,z)
     // this operation should be done for any permutation z, satisfying the conditions above
+    // temp_vec still holds v*s_i here, its data is passed along so μ can be found in 'greek_mu_rows' directly
+
+    K_L_STATS_ADD(K_L_STATS_Z_DESCENTS, z_amount);
+    for(int k = 0; k < z_amount; k++){
+        int z_index = z_map[k];
+        const vector<int>& z = all_p[z_index];
+        int z_len = all_p_len[z_index];
+        poly_temp = polynom_greek_mu(z, temp_vec, {z_len, z_index}, temp_vec_data);
+        // This checks if poly_temp is zero polynomial, in that case further calculation
+        // is unnecessary, at the end we would just subtract 0, so we may omit it
+        if(polynom_is_zero(poly_temp)) continue;
+        poly_temp = polynom_multiply(poly_temp, {{{(v_len - z_len)/2, 1}}});
+
+        // 'found_id' is also used above, it does the same thing here
+        found_id = k_l_database_check_id(u_index, z_index);
+
+        if(found_id != 0){
+            poly_temp = polynom_multiply(poly_temp, polynom_pool_at(found_id));
+            result = polynom_subtract(result, poly_temp);
+        }
+        else{
+            PermtData z_data = {z_len, z_index};
 
-    for(auto zitr = z_map.begin() ; zitr != z_map.end(); zitr++){
-        vector<int> z = all_p[*zitr]; poly_temp.coefficients.clear();
-        if(z[i] > z[i+1]){
-            int z_len = all_p_len[*zitr];
-            poly_temp = polynom_greek_mu(z, permt_multp_right(v, s_i));
-            poly_temp = polynom_multiply(poly_temp, {{{(v_len - z_len)/2, 1}}});
-            // This checks if poly_temp is zero polynomial, in that case further calculation
-            // is unnecessary, at the end we would just subtract 0, so we may omit it
-            if(polynom_add(poly_temp, poly_temp).coefficients == poly_temp.coefficients) continue;
-
-            // 'dummy' variable is also used above, it does the same thing here
-            dummy = k_l_database_check({u,z}, u_index, *zitr);
-
-            if(dummy.first){
-                poly_temp = polynom_multiply(poly_temp, dummy.second);
-                result = polynom_subtract(result, poly_temp);
-            }
-            else{
-                PermtData z_data = {all_p_len[*zitr], *zitr};
-
-                /* Calling the function again with checkted_database = false */
-                poly_temp2 = polynom_k_l(u, z, u_data, z_data, false);
+            /* Calling the function again with checkted_database = false */
+            poly_temp2 = polynom_k_l(u, z, u_data, z_data, false);
 
-               /* Obtained polynomial will not be inside the database, so we shall add it to temp_database for later use
-                * When we call 'polynom_k_l' above, it will already try to add it for us, on its own stack
-                * For that reason, this part is commente out for now, might change later. */
-                //temp_database_append({u_index, *zitr}, poly_temp2);
+           /* Obtained polynomial will not be inside the database, so we shall add it to temp_database for later use
+            * When we call 'polynom_k_l' above, it will already try to add it for us, on its own stack
+            * For that reason, this part is commente out for now, might change later. */
+            //temp_database_append({u_index, z_index}, poly_temp2);
 
-                poly_temp = polynom_multiply(poly_temp, poly_temp2);
-                result = polynom_subtract(result, poly_temp);
-            }
+            poly_temp = polynom_multiply(poly_temp, poly_temp2);
+            result = polynom_subtract(result, poly_temp);
         }
     }
     // addding the result to the database for later use
     temp_database_append({u_index, v_index}, result);
+    greek_mu_table_record(u_index, v_index, u_data.length, v_len, result.coefficients);
     return result;
 }
 
 // This corresponds to the μ(u,v) function in the definition
-Polynomial polynom_greek_mu(vector<int> u, vector<int> v, PermtData u_data, PermtData v_data){
-    if(u_data.length == -1) u_data = all_p_data[u];
-    if(v_data.length == -1) v_data = all_p_data[v];
+Polynomial polynom_greek_mu(const vector<int>& u, const vector<int>& v, PermtData u_data, PermtData v_data){
+    if(u_data.length == -1) u_data = permt_data(u);
+    if(v_data.length == -1) v_data = permt_data(v);
     int u_index = u_data.index, v_index = v_data.index;
+    K_L_STATS_ADD(K_L_STATS_MU_CALLS, 1);
 
     if(b_matrix[u_index][v_index] == 0) return {{{0,0}}}; // this corresponds to just zero
 
     int len_u = u_data.length, len_v = v_data.length;
-    // if the difference between their length is odd, we may directly return 0, check theory later
-    if(len_v - len_u % 2 == 0) return {{{0,0}}};
+    // if the difference between their length is even, we may directly return 0, check theory later
+    if((len_v - len_u) % 2 == 0) return {{{0,0}}};
+
+    // μ values that were obtained before are kept in 'greek_mu_rows', check "greek-mu.h"
+    int mu;
+    if(greek_mu_table_lookup(u_index, v_index, mu)){
+        K_L_STATS_ADD(K_L_STATS_MU_TABLE_HITS, 1);
+        return {{{0, (float)mu}}};
+    }
 
-    Polynomial k_l_poly;
-    auto dummy = k_l_database_check({u, v}, u_index, v_index);
-    // if the wanted polynomial is already in the database, no need to calculate it
-    if(dummy.first) k_l_poly = dummy.second;
+    Polynomial computed_poly;
+    const Polynomial* k_l_poly = &computed_poly;
+    uint32_t found_id = k_l_database_check_id(u_index, v_index);
+    // if the wanted polynomial is already in the database, no need to calculate it, nor to copy it
+    if(found_id != 0){
+        k_l_poly = &polynom_pool_at(found_id);
+        greek_mu_table_record(u_index, v_index, len_u, len_v, k_l_poly->coefficients);
+    }
     // otherwise we calculate it
     else{
-        k_l_poly = polynom_k_l(u, v, u_data, v_data);
+        computed_poly = polynom_k_l(u, v, u_data, v_data);
         /* Obtained polynomial will not be inside the database, so we shall add it to temp_database for later use
          * When we call 'polynom_k_l' above, it will already try to add it for us, on its own stack
          * For that reason, this part is commente out for now, might change later. */
-        //temp_database_append({u_index, v_index}, k_l_poly);
+        //temp_database_append({u_index, v_index}, computed_poly);
+
+        // 'polynom_k_l' records μ for the representative of the pair, which can be a different pair
+        greek_mu_table_record(u_index, v_index, len_u, len_v, computed_poly.coefficients);
     }
     // This corresponds to q^[(len_v - len_u - 1) / 2] * P(u, v)
-    auto wanted_coefficient = k_l_poly.coefficients.find((len_v - len_u- 1) / 2.0);
+    auto wanted_coefficient = k_l_poly->coefficients.find((len_v - len_u- 1) / 2.0);
 
-    if(wanted_coefficient != k_l_poly.coefficients.end()) return {{{0, wanted_coefficient->second}}};
+    if(wanted_coefficient != k_l_poly->coefficients.end()) return {{{0, wanted_coefficient->second}}};
     else return {{{0,0}}};
 }
 
 // The same function as greek_mu, but this is designed to be used with 'polynom_k_l_standlaone'
 // No prior length data is assumed
 Polynomial polynom_greek_mu_standalone(vector<int> u, vector<int> v, PermtData u_data, PermtData v_data){
-    if(u_data.length == -1) u_data = all_p_data[u];
-    if(v_data.length == -1) v_data = all_p_data[v];
+    if(u_data.length == -1) u_data = permt_data(u);
+    if(v_data.length == -1) v_data = permt_data(v);
     int u_index = u_data.index, v_index = v_data.index;
 
     int len_u = permt_inversion_amount(u), len_v = permt_inversion_amount(v);
 
     if(!bruhat_compare(u, v, len_u, len_v)) return {{{0,0}}}; // this corresponds to just zero
 
-    // if the difference between their length is odd, we may directly return 0, check theory later
-    if(len_v - len_u % 2 == 0) return {{{0,0}}};
+    // if the difference between their length is even, we may directly return 0, check theory later
+    if((len_v - len_u) % 2 == 0) return {{{0,0}}};
 
     Polynomial k_l_poly;
-    auto dummy = k_l_database_check({u, v}, u_index, v_index);
+    auto dummy = k_l_database_check(u_index, v_index);
     // if the wanted polynomial is already in the database, no need to calculate it
     if(dummy.first) k_l_poly = dummy.second;
     // otherwise we calculate it
@@ -435,8 +622,8 @@ Polynomial polynom_k_l_standalone(vector<int> u, vector<int> v, PermtData u_data
     // By definition, if u = v then P(u, v) = 1
     if(u == v) return {{{0,1}}}; // this is 1*q^0 = 1
 
-    if(u_data.length == -1 ) u_data = {permt_inversion_amount(u), all_p_data[u].index};
-    if(v_data.length == -1 ) v_data = {permt_inversion_amount(v), all_p_data[v].index};
+    if(u_data.length == -1 ) u_data = {permt_inversion_amount(u), permt_rank(u)};
+    if(v_data.length == -1 ) v_data = {permt_inversion_amount(v), permt_rank(v)};
 
     int u_index = u_data.index, u_len = u_data.length;
     int v_index = v_data.index, v_len = v_data.length;
@@ -464,31 +651,22 @@ Polynomial polynom_k_l_standalone(vector<int> u, vector<int> v, PermtData u_data
     else              c = 0;
 
     vector<int> z_map;
-    int num_vertices = boost::num_vertices(bruhat_data.first);
     /* The elements that are between u and v with respect to bruhat order will be important later on
      * we will handle it here, we say u <= z <= v , variable z_map will contain indexes of permutations
-     * that stay between u and v with respect to bruhat order. */
-    if(num_vertices == 0){
-        bruhat_data = bruhat_graph_between_permt(u, v, u_data, v_data, false);
-        for(auto itr = bruhat_data.second.begin(); itr != bruhat_data.second.end(); itr++){
-            z_map.push_back(all_p_data[itr->first].index);
-        }
-    }
-
-    else{
-        auto temp_data = bruhat_subgraph_between_permt(u, v, bruhat_data.first, bruhat_data.second[u].index,
-                                                       bruhat_data.second[v].index);
-        for(auto itr = temp_data.begin(); itr != temp_data.end(); itr++){
-            z_map.push_back(all_p_data[itr->first].index);
-        }
+     * that stay between u and v with respect to bruhat order. They are compared one by one, a graph of the
+     * first pair kept in 'bruhat_data' does not hold the pairs of the recursion, like (u*s_i, v*s_i). */
+    for(int k = 0; k < all_p.size(); k++){
+        if(k != u_index && !bruhat_compare(u, all_p[k], u_len)) continue;
+        if(k != v_index && !bruhat_compare(all_p[k], v, -1, v_len)) continue;
+        z_map.push_back(k);
     }
 
     pair<int, int> s_i = {i+1, i+2}; // +1 is added, because -1 was subtracted from i above
     Polynomial result, poly_temp, poly_temp2; vector<int> temp_vec, temp_vec2;
     temp_vec = permt_multp_right(u, s_i); temp_vec2 = permt_multp_right(v, s_i);
 
-    PermtData temp_vec_data = {permt_inversion_amount(temp_vec), all_p_data[temp_vec].index},
-              temp_vec2_data = {permt_inversion_amount(temp_vec2), all_p_data[temp_vec2].index};
+    PermtData temp_vec_data = {permt_inversion_amount(temp_vec), permt_rank(temp_vec)},
+              temp_vec2_data = {permt_inversion_amount(temp_vec2), permt_rank(temp_vec2)};
     int temp_vec_index = temp_vec_data.index;
     int temp_vec2_index = temp_vec2_data.index;
 
@@ -514,7 +692,7 @@ Polynomial polynom_k_l_standalone(vector<int> u, vector<int> v, PermtData u_data
     }
 
     temp_vec = permt_multp_right(v, s_i);
-    temp_vec_data = {permt_inversion_amount(temp_vec), all_p_data[temp_vec].index};
+    temp_vec_data = {permt_inversion_amount(temp_vec), permt_rank(temp_vec)};
     temp_vec_index = temp_vec_data.index;
 
     dummy = k_l_database_check({u, temp_vec}, u_index, temp_vec_index);
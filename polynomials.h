@@ -13,14 +13,36 @@
 #include "bruhat-matrix.h"
 #endif // !BRUHAT_MATRIX
 /*--------------------------------*/
+#ifndef GREEK_MU
+#include "greek-mu.h"
+#endif // !GREEK_MU
+/*--------------------------------*/
+#ifndef K_L_SYMMETRY
+#include "k-l-symmetry.h"
+#endif // !K_L_SYMMETRY
+/*--------------------------------*/
+#ifndef K_L_ARENA
+#include "k-l-arena.h"
+#endif // !K_L_ARENA
+/*--------------------------------*/
 #include <stdexcept> // std::out_of_range
+#include <cstdint>
+#include <unordered_map>
+#include <shared_mutex>
+#include <deque>
 #endif // !POLYNOMIALS
 
 // Type definitions
 
 struct Polynomial
 {
-    std::map<float /*power*/, float /*coefficient*/> coefficients;
+    PolynomialCoefficients coefficients;
+};
+
+/* Hash of the coefficients of a polynomial, used by 'polynom_pool' to find a polynomial that is already stored */
+struct PolynomialHash
+{
+    size_t operator()(const PolynomialCoefficients& coefficients) const;
 };
 
 /* This is used in the K-L graph, provided some long list of conditions are satisfied.*/
@@ -35,15 +57,24 @@ typedef boost::adjacency_list<boost::vecS, boost::vecS, boost::bidirectionalS,
 
 /*--------------------------Global variables, just their declerations-----------------------*/
 
-// The database that is used to calculate K-L polynomials more efficiently
-extern std::vector<std::vector<Polynomial>> k_l_database;
+/*
+ Across a whole group there are only a few distinct K-L polynomials compared to the amount of pairs, so every
+ polynomial that is stored in a database is kept once inside this pool, and databases keep 32 bit IDs which
+ are positions inside the pool. ID 0 is the placeholder polynomial with no coefficients, it means "not found".
+ Use 'polynom_pool_intern', 'polynom_pool_get' and 'polynom_pool_at' instead of accessing this directly, they are
+ thread safe. It is a deque so that a polynomial never moves once it is inside the pool.
+*/
+extern std::deque<Polynomial> polynom_pool;
+
+// The database that is used to calculate K-L polynomials more efficiently, holds IDs from 'polynom_pool'
+extern std::vector<std::vector<uint32_t>> k_l_database;
 
 // The temporary database used to store elements that are not in k_l_database, when the program ends
-// this should be appended to the specificied database_name file, by default "KL-database.txt"
-extern std::vector<std::vector<Polynomial>> temp_database;
+// this should be appended to the specificied database_name file, by default "KL-database<number>.bin"
+extern std::vector<std::vector<uint32_t>> temp_database;
 
 // The name of the file containing the database, change this value as required.
-extern std::string database_name; /*  = "KL-database<number>.txt" , by default                      */
+extern std::string database_name; /*  = "KL-database<number>.bin" , by default                      */
 
 /*
  This variable is a pair consisting of a bruhat_graph and a map, which includes necessary data to
@@ -57,25 +88,41 @@ extern std::pair<bruhat_graph, std::map<std::vector<int>, PermtData>> bruhat_dat
 
 // function definitions
 
-Polynomial polynom_add(Polynomial poly1, Polynomial poly2);
+Polynomial polynom_add(Polynomial poly1, const Polynomial& poly2);
 
-Polynomial polynom_subtract(Polynomial poly1, Polynomial poly2);
+Polynomial polynom_subtract(Polynomial poly1, const Polynomial& poly2);
 
-Polynomial polynom_multiply(Polynomial poly1, Polynomial poly2);
+Polynomial polynom_multiply(const Polynomial& poly1, const Polynomial& poly2);
 
 void polynom_display(FILE* ifp, Polynomial poly);
 
+uint32_t polynom_pool_intern(const Polynomial& poly);
+
+Polynomial polynom_pool_get(uint32_t id);
+
+const Polynomial& polynom_pool_at(uint32_t id);
+
+uint32_t polynom_pool_size(void);
+
 void k_l_database_initiate(void);
 
+bool k_l_database_read_text(int thread_amount = 0);
+
 /*  Default -1 values are just placeholders, negative indexes can't be achieved normally, in this program */
 std::pair<bool, Polynomial> k_l_database_check(std::pair<std::vector<int>, std::vector<int>> p, int v1_index = -1, int v2_index = -1);
 
+std::pair<bool, Polynomial> k_l_database_check(int v1_index, int v2_index);
+
+uint32_t k_l_database_check_id(int v1_index, int v2_index);
+
+uint32_t k_l_database_check_index(int v1_index, int v2_index);
+
 void k_l_database_append(void);
 
 /* This functions utilizes a global variable 'bruhat_data', look at the source code file for more info */
-Polynomial polynom_k_l(std::vector<int> u, std::vector<int> v, PermtData u_data = {-1,-1}, PermtData v_data = {-1,-1}, bool check_database = true);
+Polynomial polynom_k_l(const std::vector<int>& u, const std::vector<int>& v, PermtData u_data = {-1,-1}, PermtData v_data = {-1,-1}, bool check_database = true);
 
-Polynomial polynom_greek_mu(std::vector<int> u, std::vector<int> v, PermtData u_data = {-1,-1}, PermtData v_data = {-1,-1});
+Polynomial polynom_greek_mu(const std::vector<int>& u, const std::vector<int>& v, PermtData u_data = {-1,-1}, PermtData v_data = {-1,-1});
 
 Polynomial polynom_greek_mu_standalone(std::vector<int> u, std::vector<int> v, PermtData u_data = {-1,-1}, PermtData v_data = {-1,-1});
 
@@ -85,4 +132,4 @@ Polynomial polynom_greek_mu_bar(std::vector<int> u, std::vector<int> v);
 
 k_l_graph k_l_graph_all_sn(int n, std::pair<bruhat_graph, std::map<std::vector<int>, PermtData>> bruhat_data);
 
-void temp_database_append(std::pair<int, int> vec_indexes, Polynomial temp_poly);
+void temp_database_append(std::pair<int, int> vec_indexes, Polynomial temp_poly, bool write_log = true);
@@ -0,0 +1,199 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "w-graph.h"
+
+using namespace std;
+
+/*
+ Returns the W-graph of S_n, computing μ(u, v) for every pair u < v on multiple threads.
+ The following global variables should be initialized for S_n beforehand:
+ 'current_sn_group', 'all_p', 'all_p_len' and 'b_matrix'. The K-L database is used if it is loaded.
+
+ Every column v is a task for the scheduler, columns are submitted in the order of increasing length so
+ that the polynomials of shorter columns are mostly inside the memo by the time longer ones need them.
+ Most pairs are never computed, see 'w_graph_pair_needed' for the reason.
+*/
+WGraph w_graph_all_sn(int n, int thread_amount){
+    int f_n = factorial(n);
+    if(all_p_right_descents.size() != f_n) permt_descent_masks_initiate();
+    k_l_parallel_initiate(thread_amount);
+
+    vector<int> v_order(f_n);
+    for(int i = 0; i < f_n; i++) v_order[i] = i;
+    stable_sort(v_order.begin(), v_order.end(), [](int a, int b){ return all_p_len[a] < all_p_len[b]; });
+
+    vector<vector<pair<int, int>>> lower_edges(f_n);
+    atomic<int> columns_done(0);
+    for(auto vitr = v_order.begin(); vitr != v_order.end(); vitr++){
+        int v_index = *vitr;
+        vector<pair<int, int>>* column = &lower_edges[v_index];
+        k_l_scheduler_submit([v_index, column, &columns_done]{
+            w_graph_column_worker(v_index, column);
+            columns_done.fetch_add(1);
+        }, all_p_len[v_index]);
+    }
+    k_l_scheduler_help_until([&columns_done, f_n]{ return columns_done.load() == f_n; });
+
+    vector<GreekMuEdge> edges;
+    for(int v_index = 0; v_index < f_n; v_index++){
+        for(auto eitr = lower_edges[v_index].begin(); eitr != lower_edges[v_index].end(); eitr++){
+            edges.push_back({eitr->first, v_index, eitr->second});
+        }
+    }
+    return w_graph_from_edges(n, edges);
+}
+
+/*
+ Decides whether or not μ(u, v) has to be computed from P(u, v), for u < v. Two facts from the theory
+ make most of the work unnecessary:
+ ** if l(v) - l(u) is even then μ(u, v) = 0, and if it is 1 then P(u, v) = 1 so μ(u, v) = 1
+ ** if some s is a left (or right) descent of v but not of u, then μ(u, v) != 0 only when v = s*u
+    (or v = u*s), but then l(v) - l(u) = 1, which is already covered above
+ 'all_p_right_descents' and 'all_p_left_descents' should be initialized beforehand.
+*/
+bool w_graph_pair_needed(int u_index, int v_index){
+    if(b_matrix[u_index][v_index] == 0) return false;
+    int len_diff = all_p_len[v_index] - all_p_len[u_index];
+    if(len_diff < 3 || len_diff % 2 == 0) return false;
+    if((all_p_right_descents[v_index] & ~all_p_right_descents[u_index]) != 0) return false;
+    if((all_p_left_descents[v_index] & ~all_p_left_descents[u_index]) != 0) return false;
+    return true;
+}
+
+/* This function does not have a meaning on its own, it finds every u < v with μ(u, v) != 0 for a single
+ * column v, and stores them together with μ(u, v) inside 'lower_edges' */
+void w_graph_column_worker(int v_index, vector<pair<int, int>>* lower_edges){
+    int v_len = all_p_len[v_index];
+    for(int u_index = 0; u_index < all_p.size(); u_index++){
+        if(b_matrix[u_index][v_index] == 0) continue;
+        int u_len = all_p_len[u_index];
+        if(v_len - u_len == 1){ lower_edges->push_back({u_index, 1}); continue; }
+        if(!w_graph_pair_needed(u_index, v_index)) continue;
+
+        int mu;
+        if(!greek_mu_table_lookup(u_index, v_index, mu)){
+            Polynomial k_l_poly = k_l_parallel_evaluate(u_index, v_index);
+            greek_mu_table_record(u_index, v_index, u_len, v_len, k_l_poly.coefficients);
+            auto wanted_coefficient = k_l_poly.coefficients.find((v_len - u_len - 1) / 2.0);
+            mu = (wanted_coefficient != k_l_poly.coefficients.end()) ? wanted_coefficient->second : 0;
+        }
+        if(mu != 0) lower_edges->push_back({u_index, mu});
+    }
+}
+
+/* Builds the compressed form of the W-graph out of a list of edges u < v, every edge is stored from both ends */
+WGraph w_graph_from_edges(int n, vector<GreekMuEdge> edges){
+    int f_n = factorial(n);
+    WGraph g; g.n = n;
+    g.offsets.assign(f_n + 1, 0);
+    for(auto eitr = edges.begin(); eitr != edges.end(); eitr++){
+        g.offsets[eitr->u_index + 1]++; g.offsets[eitr->v_index + 1]++;
+    }
+    for(int i = 0; i < f_n; i++) g.offsets[i + 1] += g.offsets[i];
+
+    g.neighbours.resize(g.offsets[f_n]); g.mu.resize(g.offsets[f_n]);
+    vector<int> fill_position(g.offsets.begin(), g.offsets.end() - 1);
+    for(auto eitr = edges.begin(); eitr != edges.end(); eitr++){
+        int k = fill_position[eitr->u_index]++;
+        g.neighbours[k] = eitr->v_index; g.mu[k] = eitr->mu;
+        k = fill_position[eitr->v_index]++;
+        g.neighbours[k] = eitr->u_index; g.mu[k] = eitr->mu;
+    }
+
+    // sorting the neighbours of every vertex by index, together with their μ values
+    for(int x = 0; x < f_n; x++){
+        vector<pair<int, int>> temp;
+        for(int k = g.offsets[x]; k < g.offsets[x + 1]; k++) temp.push_back({g.neighbours[k], g.mu[k]});
+        sort(temp.begin(), temp.end());
+        for(int k = g.offsets[x]; k < g.offsets[x + 1]; k++){
+            g.neighbours[k] = temp[k - g.offsets[x]].first; g.mu[k] = temp[k - g.offsets[x]].second;
+        }
+    }
+    return g;
+}
+
+/* The list of edges u < v of the given W-graph, every edge appears once */
+vector<GreekMuEdge> w_graph_edges(const WGraph& g){
+    vector<GreekMuEdge> result;
+    for(int x = 0; x + 1 < g.offsets.size(); x++){
+        for(int k = g.offsets[x]; k < g.offsets[x + 1]; k++){
+            int y = g.neighbours[k];
+            if(all_p_len[x] < all_p_len[y]) result.push_back({x, y, g.mu[k]});
+        }
+    }
+    return result;
+}
+
+/* Converts the W-graph to the boost type 'k_l_graph' declared in "polynomials.h". Edges are directed
+ * from the smaller element to the bigger one, with respect to bruhat order. */
+k_l_graph w_graph_to_boost(const WGraph& g){
+    k_l_graph result;
+    for(int x = 0; x + 1 < g.offsets.size(); x++){
+        boost::add_vertex({all_p[x], all_p_len[x], x}, result);
+    }
+    vector<GreekMuEdge> edges = w_graph_edges(g);
+    for(auto eitr = edges.begin(); eitr != edges.end(); eitr++){
+        k_l_edge temp_edge = {{{{0, (float)eitr->mu}}}};
+        boost::add_edge(boost::vertex(eitr->u_index, result), boost::vertex(eitr->v_index, result), temp_edge, result);
+    }
+    return result;
+}
+
+/*
+ Writes the W-graph to 'w-graph<number>.txt' by default, any file with the same name is overwritten.
+ Every line is an edge u < v together with its μ value, in the same spirit with the K-L database:
+         u_index:v_index=mu
+ Indexes are positions inside 'all_p', that is the lexiographic order of S_n.
+*/
+void w_graph_write(const WGraph& g, string file_name){
+    ostringstream s; s << file_name << g.n << ".txt";
+    FILE* ifp = fopen(s.str().c_str(), "w");
+    w_graph_display(ifp, g);
+    fclose(ifp);
+}
+
+// prints the edges of the W-graph to the file stream, in the format described above 'w_graph_write'
+void w_graph_display(FILE* ifp, const WGraph& g){
+    vector<GreekMuEdge> edges = w_graph_edges(g);
+    for(auto eitr = edges.begin(); eitr != edges.end(); eitr++){
+        fprintf(ifp, "%d:%d=%d\n", eitr->u_index, eitr->v_index, eitr->mu);
+    }
+}
+
+/* Reads a W-graph written by 'w_graph_write', the returned graph has no vertices if there is no such file */
+WGraph w_graph_read(int n, string file_name){
+    ostringstream s; s << file_name << n << ".txt";
+    FILE* ifp = fopen(s.str().c_str(), "r");
+    if(ifp == NULL){ WGraph g; g.n = n; return g; }
+
+    vector<GreekMuEdge> edges; GreekMuEdge temp_edge;
+    while(fscanf(ifp, "%d:%d=%d", &temp_edge.u_index, &temp_edge.v_index, &temp_edge.mu) == 3) edges.push_back(temp_edge);
+    fclose(ifp);
+    return w_graph_from_edges(n, edges);
+}
+
+/*
+ Returns the W-graph of S_n as the boost type 'k_l_graph'. 'bruhat_data' is not needed anymore, bruhat order
+ is read from 'b_matrix' instead, the parameter stays so that older code still compiles. For the requirements
+ look at 'w_graph_all_sn' above.
+*/
+k_l_graph k_l_graph_all_sn(int n, pair<bruhat_graph, map<vector<int>, PermtData>> bruhat_data){
+    return w_graph_to_boost(w_graph_all_sn(n));
+}
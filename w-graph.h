@@ -0,0 +1,69 @@
+/*
+The GPLv3 License (GPLv3)
+
+Copyright (c) 2023 cutiness
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef W_GRAPH
+#define W_GRAPH
+/*--------------------------------*/
+#ifndef POLYNOMIALS
+#include "polynomials.h"
+#endif // !POLYNOMIALS
+/*--------------------------------*/
+#ifndef K_L_PARALLEL
+#include "k-l-parallel.h"
+#endif // !K_L_PARALLEL
+/*--------------------------------*/
+#include <string>
+#endif // !W_GRAPH
+
+// type definitions
+
+/*
+ The W-graph of S_n in compressed sparse row form. Vertices are the indexes of permutations inside 'all_p',
+ x and y are joined iff μ(x, y) != 0 or μ(y, x) != 0. The neighbours of x are
+         neighbours[offsets[x]] ... neighbours[offsets[x + 1] - 1]
+ sorted by index, with the corresponding μ value at the same position inside 'mu'. Every edge is stored
+ from both ends, the direction with respect to bruhat order can be read from 'all_p_len'.
+*/
+struct WGraph
+{
+    int n;
+    std::vector<int> offsets;
+    std::vector<int> neighbours;
+    std::vector<int> mu;
+};
+
+// function declarations
+
+WGraph w_graph_all_sn(int n, int thread_amount = 0);
+
+bool w_graph_pair_needed(int u_index, int v_index);
+
+void w_graph_column_worker(int v_index, std::vector<std::pair<int, int>>* lower_edges);
+
+WGraph w_graph_from_edges(int n, std::vector<GreekMuEdge> edges);
+
+std::vector<GreekMuEdge> w_graph_edges(const WGraph& g);
+
+k_l_graph w_graph_to_boost(const WGraph& g);
+
+void w_graph_write(const WGraph& g, std::string file_name = "w-graph");
+
+void w_graph_display(FILE* ifp, const WGraph& g);
+
+WGraph w_graph_read(int n, std::string file_name = "w-graph");